@@ -55,6 +55,11 @@ public:
 		}
 	}
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		auto& pipelineState = GetPipelineState(deviceState, bindPoint);
@@ -110,6 +115,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		deviceState->graphicsPipelineState.indexBinding = buffer;
@@ -162,6 +172,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (auto i = 0u; i < buffers.size(); i++)
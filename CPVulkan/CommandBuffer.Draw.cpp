@@ -12,6 +12,7 @@
 #include "ImageView.h"
 #include "Pipeline.h"
 #include "RenderPass.h"
+#include "ThreadPool.h"
 #include "Util.h"
 
 #include <CompiledModule.h>
@@ -24,7 +25,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/vec_swizzle.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <unordered_map>
 
 class PipelineLayout;
 
@@ -51,6 +55,8 @@ struct AssemblerOutput
 {
 	PrimitiveType primitiveType;
 	std::vector<VertexInput> vertices{};
+	// For indexed draws, maps every index to the unique vertex that shades it
+	std::vector<uint32_t> indices{};
 	std::vector<Primitive> primitives{};
 };
 
@@ -70,18 +76,6 @@ struct FragmentBuiltinOutput
 	uint32_t stencilReference;
 };
 
-struct ComputeBuiltinInput
-{
-	glm::uvec3 globalInvocationId;
-	uint32_t unused0;
-	
-	glm::uvec3 localInvocationId;
-	uint32_t unused1;
-	
-	glm::uvec3 workgroupInvocationId;
-	uint32_t unused2;
-};
-
 struct VertexOutput
 {
 	uint64_t builtinStride;
@@ -89,274 +83,381 @@ struct VertexOutput
 	uint32_t vertexCount;
 };
 
-enum class InterpolationType
+// Layout must match _FragmentBatch in PipelineCompiler.cpp
+struct FragmentBatch
 {
-	Perspective,
-	Linear,
-	Flat,
+	uint32_t mask;
+	uint32_t front;
+	uint32_t x[FRAGMENT_BATCH_SIZE];
+	uint32_t y[FRAGMENT_BATCH_SIZE];
+	float depth[FRAGMENT_BATCH_SIZE];
+	glm::vec4 fragCoord[FRAGMENT_BATCH_SIZE];
+	uint8_t inputs[MAX_FRAGMENT_INPUT_COMPONENTS * 4 * FRAGMENT_BATCH_SIZE];
 };
 
-struct VariableInOutData
+struct FragmentWorker
 {
-	void* pointer;
-	uint32_t location;
-	VkFormat format;
-	SPIRV::SPIRVType* type;
-	InterpolationType interpolation;
-	uint32_t size;
-	uint32_t offset;
+	EntryPoint entryPoint;
+	EntryPoint batchEntryPoint;
+	std::unique_ptr<uint8_t[]> context;
+	FragmentBuiltinInput* builtinInput;
+	FragmentBuiltinOutput* builtinOutput;
+	const ShaderBindingPlan* bindingPlan;
+	std::unique_ptr<FragmentBatch> batch;
+	uint32_t batchSize;
+	bool quadShading;
+	// Closest depth and triangle for every pixel of the tile being shaded, only used when visibility is resolved before shading
+	std::unique_ptr<float[]> visibilityDepth;
+	std::unique_ptr<uint32_t[]> visibilityTriangle;
 };
 
-struct VariableUniformData
+struct TriangleSetup
 {
-	void* pointer;
-	uint32_t binding;
-	uint32_t set;
+	uint32_t provokingVertex;
+	uint32_t p0Index;
+	uint32_t p1Index;
+	uint32_t p2Index;
+	glm::vec4 p0;
+	glm::vec4 p1;
+	glm::vec4 p2;
+	glm::vec3 edgeOrigin;
+	glm::vec3 edgeStepX;
+	glm::vec3 edgeStepY;
+	float inverseArea;
+	bool front;
+	int32_t startX;
+	int32_t startY;
+	int32_t endX;
+	int32_t endY;
+	// Bounds of the depth of every fragment, after the viewport transform and depth bias
+	float minDepth;
+	float maxDepth;
+	// Added to the depth of every fragment after the viewport transform
+	float depthBias;
+	// Interpolated values are dot(plane, edges), perspective inputs are also divided by dot(inverseWPlane, edges)
+	glm::vec3 depthPlane;
+	glm::vec3 inverseWPlane;
+	uint32_t planeOffset;
 };
 
-static void ClearImage(DeviceState* deviceState, Image* image, uint32_t layer, uint32_t mipLevel, VkFormat format, VkClearColorValue colour)
+// Repeats a packed texel over size bytes, which must be a whole number of texels
+static void FillTexels(uint8_t* destination, uint64_t size, const uint8_t* texel, uint32_t texelSize)
 {
-	const auto& mip = gsl::at(image->getImageSize().Level, mipLevel);
-
-	// TODO: Change to SetPixels when implemented
-	for (auto z = 0u; z < mip.Depth; z++)
+	const auto isByteRepeated = std::all_of(texel + 1, texel + texelSize, [&](uint8_t value)
 	{
-		for (auto y = 0u; y < mip.Height; y++)
-		{
-			for (auto x = 0u; x < mip.Width; x++)
-			{
-				SetPixel(deviceState, format, image, x, y, z, mipLevel, layer, colour);
-			}
-		}
+		return value == texel[0];
+	});
+	if (isByteRepeated)
+	{
+		memset(destination, texel[0], size);
+		return;
 	}
-}
 
-static void ClearImage(DeviceState* deviceState, Image* image, uint32_t layer, uint32_t mipLevel, VkFormat format, VkClearDepthStencilValue colour)
-{
-	const auto& mip = gsl::at(image->getImageSize().Level, mipLevel);
+	// Copying a block of many texels lets memcpy use its widest stores
+	constexpr auto BLOCK_TEXELS = 256u;
+	uint8_t block[BLOCK_TEXELS * MAX_TEXEL_SIZE];
+	const auto blockSize = uint64_t{BLOCK_TEXELS} * texelSize;
+	for (auto i = 0u; i < BLOCK_TEXELS; i++)
+	{
+		memcpy(block + i * texelSize, texel, texelSize);
+	}
 
-	// TODO: Change to SetPixels when implemented
-	for (auto z = 0u; z < mip.Depth; z++)
+	while (size >= blockSize)
 	{
-		for (auto y = 0u; y < mip.Height; y++)
-		{
-			for (auto x = 0u; x < mip.Width; x++)
-			{
-				SetPixel(deviceState, format, image, x, y, z, mipLevel, layer, colour);
-			}
-		}
+		memcpy(destination, block, blockSize);
+		destination += blockSize;
+		size -= blockSize;
 	}
+	memcpy(destination, block, size);
 }
 
-static VkFormat GetVariableFormat(SPIRV::SPIRVType* type)
+static void FillTexelsParallel(DeviceState* deviceState, uint8_t* destination, uint64_t size, const uint8_t* texel, uint32_t texelSize)
 {
-	if (type->isTypeMatrix())
+	const auto jobSize = std::max(uint64_t{CLEAR_JOB_SIZE} / texelSize, uint64_t{1}) * texelSize;
+	const auto numberJobs = static_cast<uint32_t>((size + jobSize - 1) / jobSize);
+	if (numberJobs <= 1)
 	{
-		return VK_FORMAT_UNDEFINED;
+		FillTexels(destination, size, texel, texelSize);
+		return;
 	}
 
-	if (type->isTypeVector())
+	deviceState->threadPool->ParallelFor(numberJobs, [&](uint32_t job, uint32_t)
 	{
-		if (type->getVectorComponentType()->isTypeFloat(32))
-		{
-			switch (type->getVectorComponentCount())
-			{
-			case 2:
-				return VK_FORMAT_R32G32_SFLOAT;
-			case 3:
-				return VK_FORMAT_R32G32B32_SFLOAT;
-			case 4:
-				return VK_FORMAT_R32G32B32A32_SFLOAT;
-			}
-		}
+		const auto offset = job * jobSize;
+		FillTexels(destination + offset, std::min(jobSize, size - offset), texel, texelSize);
+	});
+}
 
-		if (type->getVectorComponentType()->isTypeFloat(64))
-		{
-			switch (type->getVectorComponentCount())
-			{
-			case 2:
-				return VK_FORMAT_R64G64_SFLOAT;
-			case 3:
-				return VK_FORMAT_R64G64B64_SFLOAT;
-			case 4:
-				return VK_FORMAT_R64G64B64A64_SFLOAT;
-			}
-		}
+// Whether texels of the format are stored linearly, one after another, so a clear is a plain fill
+static bool CanFillTexels(const FormatInformation& information)
+{
+	return (information.Type == FormatType::Normal || information.Type == FormatType::Packed || information.Type == FormatType::DepthStencil) &&
+		information.TotalSize <= MAX_TEXEL_SIZE;
+}
 
-		if (type->getVectorComponentType()->isTypeInt(32) && static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
-		{
-			switch (type->getVectorComponentCount())
-			{
-			case 2:
-				return VK_FORMAT_R32G32_SINT;
-			case 3:
-				return VK_FORMAT_R32G32B32_SINT;
-			case 4:
-				return VK_FORMAT_R32G32B32A32_SINT;
-			}
-		}
+static void ClearRect(DeviceState* deviceState, Image* image, uint32_t layer, uint32_t mipLevel, const VkRect2D& rect, const uint8_t* texel)
+{
+	const auto& imageSize = image->getImageSize();
+	const auto& mip = gsl::at(imageSize.Level, mipLevel);
+	const auto texelSize = static_cast<uint32_t>(imageSize.PixelSize);
+	const auto rowSize = uint64_t{rect.extent.width} * texelSize;
+	const auto offset = GetImagePixelOffset(imageSize, rect.offset.x, rect.offset.y, 0, mipLevel, layer);
 
-		if (type->getVectorComponentType()->isTypeInt(64) && static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
-		{
-			switch (type->getVectorComponentCount())
-			{
-			case 2:
-				return VK_FORMAT_R64G64_SINT;
-			case 3:
-				return VK_FORMAT_R64G64B64_SINT;
-			case 4:
-				return VK_FORMAT_R64G64B64A64_SINT;
-			}
-		}
+	// Rows covering the whole width are contiguous
+	if (rowSize == mip.Stride)
+	{
+		const auto size = rowSize * rect.extent.height;
+		FillTexelsParallel(deviceState, image->getDataPtr(offset, size), size, texel, texelSize);
+		return;
+	}
 
-		if (type->getVectorComponentType()->isTypeInt(32) && !static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
+	const auto rowsPerJob = static_cast<uint32_t>(std::max(uint64_t{CLEAR_JOB_SIZE} / rowSize, uint64_t{1}));
+	const auto numberJobs = (rect.extent.height + rowsPerJob - 1) / rowsPerJob;
+	deviceState->threadPool->ParallelFor(numberJobs, [&](uint32_t job, uint32_t)
+	{
+		const auto endRow = std::min((job + 1) * rowsPerJob, rect.extent.height);
+		for (auto row = job * rowsPerJob; row < endRow; row++)
 		{
-			switch (type->getVectorComponentCount())
-			{
-			case 2:
-				return VK_FORMAT_R32G32_UINT;
-			case 3:
-				return VK_FORMAT_R32G32B32_UINT;
-			case 4:
-				return VK_FORMAT_R32G32B32A32_UINT;
-			}
+			FillTexels(image->getDataPtr(offset + row * mip.Stride, rowSize), rowSize, texel, texelSize);
 		}
+	});
+}
+
+// Writes the texel to a single tile of a subresource, without splitting the work between threads
+static void ClearTile(Image* image, uint32_t mipLevel, uint32_t layer, const PendingClear& pendingClear, uint32_t tileX, uint32_t tileY)
+{
+	const auto& imageSize = image->getImageSize();
+	const auto& mip = gsl::at(imageSize.Level, mipLevel);
+	const auto startX = tileX * RASTERISER_TILE_SIZE;
+	const auto startY = tileY * RASTERISER_TILE_SIZE;
+	const auto endY = std::min(startY + RASTERISER_TILE_SIZE, mip.Height);
+	const auto rowSize = uint64_t{std::min(startX + RASTERISER_TILE_SIZE, mip.Width) - startX} * pendingClear.texelSize;
+	const auto offset = GetImagePixelOffset(imageSize, static_cast<int32_t>(startX), static_cast<int32_t>(startY), 0, mipLevel, layer);
+	for (auto y = startY; y < endY; y++)
+	{
+		FillTexels(image->getDataPtr(offset + (y - startY) * mip.Stride, rowSize), rowSize, pendingClear.texel, pendingClear.texelSize);
+	}
+}
+
+// Writes a pending clear to every tile of the subresource that does not hold it yet
+static void MaterialiseClear(DeviceState* deviceState, Image* image, uint32_t mipLevel, uint32_t layer)
+{
+	const auto pendingClear = image->getPendingClear(mipLevel, layer);
+	if (!pendingClear)
+	{
+		return;
+	}
 
-		if (type->getVectorComponentType()->isTypeInt(64) && !static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
+	const auto hasMaterialisedTiles = std::any_of(pendingClear->materialisedTiles.begin(), pendingClear->materialisedTiles.end(), [](uint8_t materialised)
+	{
+		return materialised != 0;
+	});
+	if (hasMaterialisedTiles)
+	{
+		deviceState->threadPool->ParallelFor(pendingClear->tilesX * pendingClear->tilesY, [&](uint32_t tile, uint32_t)
 		{
-			switch (type->getVectorComponentCount())
+			if (!pendingClear->materialisedTiles[tile])
 			{
-			case 2:
-				return VK_FORMAT_R64G64_UINT;
-			case 3:
-				return VK_FORMAT_R64G64B64_UINT;
-			case 4:
-				return VK_FORMAT_R64G64B64A64_UINT;
+				ClearTile(image, mipLevel, layer, *pendingClear, tile % pendingClear->tilesX, tile / pendingClear->tilesX);
 			}
-		}
+		});
 	}
-
-	if (type->isTypeFloat(16))
+	else
 	{
-		return VK_FORMAT_R16_SFLOAT;
+		const auto& mip = gsl::at(image->getImageSize().Level, mipLevel);
+		const auto offset = GetImagePixelOffset(image->getImageSize(), 0, 0, 0, mipLevel, layer);
+		FillTexelsParallel(deviceState, image->getDataPtr(offset, mip.LevelSize), mip.LevelSize, pendingClear->texel, pendingClear->texelSize);
 	}
 
-	if (type->isTypeFloat(32))
+	pendingClear->isPending = false;
+}
+
+// Writes a pending clear to a single tile, the rasteriser calls this just before shading the tile so the clear is written while the tile is in cache
+static void MaterialiseClearTile(Image* image, uint32_t mipLevel, uint32_t layer, uint32_t tileX, uint32_t tileY)
+{
+	const auto pendingClear = image->getPendingClear(mipLevel, layer);
+	if (!pendingClear || tileX >= pendingClear->tilesX || tileY >= pendingClear->tilesY)
 	{
-		return VK_FORMAT_R32_SFLOAT;
+		return;
 	}
 
-	if (type->isTypeFloat(64))
+	auto& materialised = pendingClear->materialisedTiles[tileY * pendingClear->tilesX + tileX];
+	if (!materialised)
 	{
-		return VK_FORMAT_R64_SFLOAT;
+		ClearTile(image, mipLevel, layer, *pendingClear, tileX, tileY);
+		materialised = 1;
 	}
+}
+
+static void MaterialiseClearTile(const ImageView* imageView, uint32_t tileX, uint32_t tileY)
+{
+	const auto& range = imageView->getSubresourceRange();
+	MaterialiseClearTile(imageView->getImage(), range.baseMipLevel, range.baseArrayLayer, tileX, tileY);
+}
 
-	if (type->isTypeInt(8) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+static bool HasPendingClears(Image* image)
+{
+	for (auto layer = 0u; layer < image->getArrayLayers(); layer++)
 	{
-		return VK_FORMAT_R8_SINT;
+		for (auto level = 0u; level < image->getMipLevels(); level++)
+		{
+			if (image->getPendingClear(level, layer))
+			{
+				return true;
+			}
+		}
 	}
+	return false;
+}
 
-	if (type->isTypeInt(16) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+// Writes every pending clear, except for the subresources the attachments are drawn to
+static void MaterialiseClears(DeviceState* deviceState, const std::vector<const ImageView*>& attachments)
+{
+	auto& images = deviceState->pendingClearImages;
+	for (const auto image : images)
 	{
-		return VK_FORMAT_R16_SINT;
+		for (auto layer = 0u; layer < image->getArrayLayers(); layer++)
+		{
+			for (auto level = 0u; level < image->getMipLevels(); level++)
+			{
+				const auto isAttachment = std::any_of(attachments.begin(), attachments.end(), [&](const ImageView* imageView)
+				{
+					return imageView->getImage() == image &&
+						imageView->getSubresourceRange().baseMipLevel == level &&
+						imageView->getSubresourceRange().baseArrayLayer == layer;
+				});
+				if (!isAttachment)
+				{
+					MaterialiseClear(deviceState, image, level, layer);
+				}
+			}
+		}
 	}
 
-	if (type->isTypeInt(32) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	images.erase(std::remove_if(images.begin(), images.end(), [](Image* image)
 	{
-		return VK_FORMAT_R32_SINT;
-	}
+		return !HasPendingClears(image);
+	}), images.end());
+}
 
-	if (type->isTypeInt(64) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+// Attachments of the current subpass are only ever accessed at the pixel being shaded, input attachments included, so they can be cleared a tile at a time
+static std::vector<const ImageView*> GetTileAttachments(DeviceState* deviceState)
+{
+	const auto& pipelineState = deviceState->graphicsPipelineState;
+	std::vector<const ImageView*> attachments{};
+	const auto addAttachments = [&](const std::vector<AttachmentReference>& attachmentReferences)
 	{
-		return VK_FORMAT_R64_SINT;
-	}
+		for (const auto& attachmentReference : attachmentReferences)
+		{
+			if (attachmentReference.attachment != VK_ATTACHMENT_UNUSED)
+			{
+				attachments.push_back(pipelineState.currentFramebuffer->getAttachments()[attachmentReference.attachment]);
+			}
+		}
+	};
 
-	if (type->isTypeInt(8) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	addAttachments(pipelineState.currentSubpass->colourAttachments);
+	addAttachments(pipelineState.currentSubpass->inputAttachments);
+	if (pipelineState.currentSubpass->depthStencilAttachment.layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+		pipelineState.currentSubpass->depthStencilAttachment.attachment != VK_ATTACHMENT_UNUSED)
 	{
-		return VK_FORMAT_R8_UINT;
+		attachments.push_back(pipelineState.currentFramebuffer->getAttachments()[pipelineState.currentSubpass->depthStencilAttachment.attachment]);
 	}
+	return attachments;
+}
 
-	if (type->isTypeInt(16) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+// Shaders can read any bound image, so only the attachments of the current subpass are left to be cleared a tile at a time
+static void MaterialiseNonAttachmentClears(DeviceState* deviceState)
+{
+	if (deviceState->pendingClearImages.empty())
 	{
-		return VK_FORMAT_R16_UINT;
+		return;
 	}
 
-	if (type->isTypeInt(32) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	MaterialiseClears(deviceState, GetTileAttachments(deviceState));
+}
+
+// Records a clear of a whole subresource, to be written once something next uses it
+static void RecordClear(DeviceState* deviceState, Image* image, uint32_t layer, uint32_t mipLevel, const uint8_t* texel, uint32_t texelSize)
+{
+	const auto& mip = gsl::at(image->getImageSize().Level, mipLevel);
+	auto& pendingClear = image->setPendingClear(mipLevel, layer);
+	memcpy(pendingClear.texel, texel, texelSize);
+	pendingClear.texelSize = texelSize;
+	pendingClear.tilesX = (mip.Width + RASTERISER_TILE_SIZE - 1) / RASTERISER_TILE_SIZE;
+	pendingClear.tilesY = (mip.Height + RASTERISER_TILE_SIZE - 1) / RASTERISER_TILE_SIZE;
+	pendingClear.materialisedTiles.assign(pendingClear.tilesX * pendingClear.tilesY, 0);
+
+	auto& images = deviceState->pendingClearImages;
+	if (std::find(images.begin(), images.end(), image) == images.end())
 	{
-		return VK_FORMAT_R32_UINT;
+		images.push_back(image);
 	}
+}
 
-	if (type->isTypeInt(64) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+// Clears a rectangle of a subresource, deferring the clear when the rectangle covers all of it
+static void ClearAttachmentRect(DeviceState* deviceState, Image* image, uint32_t layer, uint32_t mipLevel, const VkRect2D& rect, const uint8_t* texel)
+{
+	const auto& mip = gsl::at(image->getImageSize().Level, mipLevel);
+	if (rect.offset.x == 0 && rect.offset.y == 0 && rect.extent.width == mip.Width && rect.extent.height == mip.Height &&
+		mip.Depth == 1 && image->getSamples() == VK_SAMPLE_COUNT_1_BIT)
 	{
-		return VK_FORMAT_R64_UINT;
+		RecordClear(deviceState, image, layer, mipLevel, texel, static_cast<uint32_t>(image->getImageSize().PixelSize));
+		return;
 	}
 
-	FATAL_ERROR();
+	MaterialiseClear(deviceState, image, mipLevel, layer);
+	ClearRect(deviceState, image, layer, mipLevel, rect, texel);
 }
 
-static uint32_t GetVariableSize(SPIRV::SPIRVType* type)
+template<typename ClearValue>
+static void ClearImage(DeviceState* deviceState, Image* image, uint32_t layer, uint32_t mipLevel, VkFormat format, ClearValue colour)
 {
-	if (type->isTypeArray())
-	{
-		const auto size = GetVariableSize(type->getArrayElementType());
-		if (type->hasDecorate(DecorationArrayStride))
-		{
-			const auto stride = *type->getDecorate(DecorationArrayStride).begin();
-			if (stride != size)
-			{
-				TODO_ERROR();
-			}
-		}
+	const auto& information = GetFormatInformation(format);
+	const auto& mip = gsl::at(image->getImageSize().Level, mipLevel);
 
-		return size * type->getArrayLength();
+	// The whole level is overwritten, so an earlier clear of it never needs to be written
+	if (const auto pendingClear = image->getPendingClear(mipLevel, layer))
+	{
+		pendingClear->isPending = false;
 	}
 
-	if (type->isTypeStruct())
+	if (!CanFillTexels(information))
 	{
-		auto size = 0u;
-		for (auto i = 0u; i < type->getStructMemberCount(); i++)
+		for (auto z = 0u; z < mip.Depth; z++)
 		{
-			const auto decorate = type->getMemberDecorate(i, DecorationOffset);
-			if (decorate && decorate->getLiteral(0) != size)
+			for (auto y = 0u; y < mip.Height; y++)
 			{
-				const auto offset = decorate->getLiteral(0);
-				if (offset < size)
-				{
-					TODO_ERROR();
-				}
-				else
+				for (auto x = 0u; x < mip.Width; x++)
 				{
-					size = offset;
+					SetPixel(deviceState, format, image, x, y, z, mipLevel, layer, colour);
 				}
 			}
-			size += GetVariableSize(type->getStructMemberType(i));
 		}
-		return size;
-	}
-
-	if (type->isTypeMatrix())
-	{
-		// TODO: Matrix stride & so on
-		return GetVariableSize(type->getScalarType()) * type->getMatrixColumnCount() * type->getMatrixColumnType()->getVectorComponentCount();
+		return;
 	}
 
-	if (type->isTypeVector())
-	{
-		return GetVariableSize(type->getScalarType()) * type->getVectorComponentCount();
-	}
+	// Every texel gets the same bytes, so convert the value once and fill the whole level
+	uint8_t texel[MAX_TEXEL_SIZE]{};
+	PackTexel(deviceState, format, colour, texel);
 
-	if (type->isTypeFloat() || type->isTypeInt())
+	// Only single sampled 2D levels are deferred, as those are what the rasteriser works on a tile at a time
+	if (mip.Depth == 1 && image->getSamples() == VK_SAMPLE_COUNT_1_BIT)
 	{
-		return type->getBitWidth() / 8;
+		RecordClear(deviceState, image, layer, mipLevel, texel, information.TotalSize);
+		return;
 	}
 
-	FATAL_ERROR();
+	const auto offset = GetImagePixelOffset(image->getImageSize(), 0, 0, 0, mipLevel, layer);
+	FillTexelsParallel(deviceState, image->getDataPtr(offset, mip.LevelSize), mip.LevelSize, texel, information.TotalSize);
 }
 
-static void LoadUniforms(DeviceState* deviceState, const std::vector<VariableUniformData>& uniformData, CommonPipelineState& pipelineState)
+// Points the descriptor slots of a context at the bound descriptor sets and copies in the push constants
+static void LoadContextBindings(DeviceState* deviceState, const ShaderBindingPlan& bindingPlan, uint8_t* context, CommonPipelineState& pipelineState)
 {
-	for (const auto& data : uniformData)
+	for (const auto& data : bindingPlan.uniforms)
 	{
+		const auto pointer = context + data.contextOffset;
 		const auto descriptorSet = pipelineState.descriptorSets[data.set];
 		VkDescriptorType descriptorType;
 		const Descriptor* value;
@@ -372,7 +473,7 @@ static void LoadUniforms(DeviceState* deviceState, const std::vector<VariableUni
 		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
 			for (auto j = 0u; j < value->count; j++)
 			{
-				static_cast<const ImageDescriptor**>(data.pointer)[j] = &value->values[j].Image;
+				reinterpret_cast<const ImageDescriptor**>(pointer)[j] = &value->values[j].Image;
 			}
 			break;
 			
@@ -381,7 +482,7 @@ static void LoadUniforms(DeviceState* deviceState, const std::vector<VariableUni
 			for (auto j = 0u; j < value->count; j++)
 			{
 				const auto& bufferInfo = value->values[j].Buffer;
-				static_cast<const void**>(data.pointer)[j] = UnwrapVulkan<Buffer>(bufferInfo.buffer)->getDataPtr(bufferInfo.offset, bufferInfo.range);
+				reinterpret_cast<const void**>(pointer)[j] = UnwrapVulkan<Buffer>(bufferInfo.buffer)->getDataPtr(bufferInfo.offset, bufferInfo.range);
 			}
 			break;
 
@@ -391,7 +492,7 @@ static void LoadUniforms(DeviceState* deviceState, const std::vector<VariableUni
 			{
 				const auto dynamicOffset = pipelineState.descriptorSetDynamicOffset[data.set][data.binding][j];
 				const auto& bufferInfo = value->values[j].Buffer;
-				static_cast<const void**>(data.pointer)[j] = UnwrapVulkan<Buffer>(bufferInfo.buffer)->getDataPtr(bufferInfo.offset + dynamicOffset, bufferInfo.range);
+				reinterpret_cast<const void**>(pointer)[j] = UnwrapVulkan<Buffer>(bufferInfo.buffer)->getDataPtr(bufferInfo.offset + dynamicOffset, bufferInfo.range);
 			}
 			break;
 			
@@ -405,6 +506,11 @@ static void LoadUniforms(DeviceState* deviceState, const std::vector<VariableUni
 			FATAL_ERROR();
 		}
 	}
+
+	if (bindingPlan.pushConstantSize > 0)
+	{
+		memcpy(context + bindingPlan.pushConstantOffset, deviceState->pushConstants, bindingPlan.pushConstantSize);
+	}
 }
 
 static float EdgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
@@ -417,156 +523,20 @@ static float EdgeFunction(const glm::vec4& a, const glm::vec4& b, const glm::vec
 	return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
 }
 
-static void GetVariablePointers(const SPIRV::SPIRVModule* module,
-                                const CompiledModule* llvmModule,
-                                std::vector<VariableInOutData>& inputData,
-                                std::vector<VariableUniformData>& uniformData,
-                                std::vector<VariableInOutData>& outputData,
-                                std::pair<void*, uint32_t>& pushConstant,
-                                uint32_t& inputSize,
-                                uint32_t& outputSize)
+static glm::vec3 GetEdgeEquation(const glm::vec4& a, const glm::vec4& b, const glm::vec2& pixelOrigin, const glm::vec2& pixelStep)
 {
-	auto maxLocation = -1;
-	for (auto i = 0u; i < module->getNumVariables(); i++)
+	// EdgeFunction(a, b, pixelOrigin + pixelStep * (x, y)) expanded as stepX * x + stepY * y + origin
+	return glm::vec3
 	{
-		const auto variable = module->getVariable(i);
-		switch (variable->getStorageClass())
-		{
-		case StorageClassInput:
-			{
-				auto locations = variable->getDecorate(DecorationLocation);
-				if (locations.empty())
-				{
-					continue;
-				}
-
-				const auto location = *locations.begin();
-				const auto size = GetVariableSize(variable->getType()->getPointerElementType());
-				auto interpolationType = InterpolationType::Perspective;
-
-				if (variable->hasDecorate(DecorationNoPerspective))
-				{
-					interpolationType = InterpolationType::Linear;
-				}
-
-				if (variable->hasDecorate(DecorationFlat))
-				{
-					interpolationType = InterpolationType::Flat;
-				}
-				
-				inputData.push_back(VariableInOutData
-					{
-						llvmModule->getPointer(MangleName(variable)),
-						location,
-						GetVariableFormat(variable->getType()->getPointerElementType()),
-						variable->getType()->getPointerElementType(),
-						interpolationType,
-						size,
-						inputSize
-					});
-				inputSize += size;
-				break;
-			}
-
-		case StorageClassUniform:
-		case StorageClassUniformConstant:
-		case StorageClassStorageBuffer:
-			{
-				auto bindingDecorate = variable->getDecorate(DecorationBinding);
-				if (bindingDecorate.size() != 1)
-				{
-					FATAL_ERROR();
-				}
-
-				auto setDecorate = variable->getDecorate(DecorationDescriptorSet);
-				if (setDecorate.size() != 1)
-				{
-					FATAL_ERROR();
-				}
-
-				const auto binding = *bindingDecorate.begin();
-				const auto set = *setDecorate.begin();
-				
-				uniformData.push_back(VariableUniformData
-					{
-						llvmModule->getPointer(MangleName(variable)),
-						binding,
-						set
-					});
-				break;
-			}
-
-		case StorageClassOutput:
-			{
-				auto locations = variable->getDecorate(DecorationLocation);
-				if (locations.empty())
-				{
-					continue;
-				}
-
-				const auto location = *locations.begin();
-
-				const auto ptr = llvmModule->getPointer(MangleName(variable));
-				if (variable->getType()->getPointerElementType()->isTypeArray())
-				{
-					const auto size = variable->getType()->getPointerElementType()->getArrayLength();
-					const auto type = variable->getType()->getPointerElementType()->getArrayElementType();
-					maxLocation = std::max(maxLocation, int32_t(location + size - 1));
-					const auto variableSize = GetVariableSize(type);
-					for (auto j = 0U; j < size; j++)
-					{
-						outputData.push_back(VariableInOutData
-							{
-								static_cast<uint8_t*>(ptr) + j * variableSize,
-								location + j,
-								GetVariableFormat(type),
-								type,
-								InterpolationType::Linear,
-								variableSize,
-								outputSize
-							});
-						outputSize += variableSize;
-					}
-				}
-				else
-				{
-					const auto type = variable->getType()->getPointerElementType();
-					maxLocation = std::max(maxLocation, int32_t(location));
-					outputData.push_back(VariableInOutData
-						{
-							ptr,
-							location,
-							GetVariableFormat(type),
-							type,
-							InterpolationType::Linear,
-							GetVariableSize(type),
-							outputSize
-						});
-					outputSize += GetVariableSize(type);
-				}
-				break;
-			}
-
-		case StorageClassPushConstant:
-			assert(std::get<0>(pushConstant) == nullptr);
-			pushConstant = std::make_pair(llvmModule->getPointer(MangleName(variable)), GetVariableSize(variable->getType()->getPointerElementType()));
-			break;
-
-		case StorageClassWorkgroup:
-		case StorageClassCrossWorkgroup:
-		case StorageClassPrivate:
-		case StorageClassGeneric:
-			break;
-
-		default:
-			FATAL_ERROR();
-		}
-	}
+		pixelStep.x * (b.y - a.y),
+		-pixelStep.y * (b.x - a.x),
+		EdgeFunction(a, b, pixelOrigin),
+	};
 }
 
 void CalculatePrimitives(DeviceState* deviceState, AssemblerOutput& assemblerOutput)
 {
-	const auto vertexCount = assemblerOutput.vertices.size();
+	const auto vertexCount = assemblerOutput.indices.empty() ? assemblerOutput.vertices.size() : assemblerOutput.indices.size();
 	switch (deviceState->graphicsPipelineState.pipeline->getInputAssemblyState().Topology)
 	{
 	case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
@@ -670,6 +640,19 @@ void CalculatePrimitives(DeviceState* deviceState, AssemblerOutput& assemblerOut
 	default:
 		FATAL_ERROR();
 	}
+
+	if (!assemblerOutput.indices.empty())
+	{
+		const auto verticesPerPrimitive = assemblerOutput.primitiveType == PrimitiveType::Point ? 1 : assemblerOutput.primitiveType == PrimitiveType::Line ? 2 : 3;
+		for (auto& primitive : assemblerOutput.primitives)
+		{
+			primitive.provokingVertex = assemblerOutput.indices[primitive.provokingVertex];
+			for (auto i = 0; i < verticesPerPrimitive; i++)
+			{
+				primitive.vertex[i] = assemblerOutput.indices[primitive.vertex[i]];
+			}
+		}
+	}
 }
 
 static AssemblerOutput ProcessInputAssembler(DeviceState* deviceState, uint32_t firstVertex, uint32_t vertexCount)
@@ -687,10 +670,18 @@ static AssemblerOutput ProcessInputAssembler(DeviceState* deviceState, uint32_t
 	return assemblerOutput;
 }
 
+constexpr auto INVALID_VERTEX = 0xFFFFFFFFu;
+
 template<typename T>
 static void ProcessIndexedVertices(AssemblerOutput& assemblerOutput, uint32_t indexCount, uint32_t vertexOffset, uint32_t firstIndex, uint32_t primitiveSize, const T* indexData)
 {
-	auto currentVertex = 0u;
+	if (indexCount == 0)
+	{
+		return;
+	}
+
+	auto minimumIndex = std::numeric_limits<T>::max();
+	auto maximumIndex = std::numeric_limits<T>::min();
 	for (auto i = 0u; i < indexCount; i++)
 	{
 		const auto index = indexData[firstIndex + i];
@@ -698,22 +689,49 @@ static void ProcessIndexedVertices(AssemblerOutput& assemblerOutput, uint32_t in
 		{
 			TODO_ERROR();
 		}
-		
-		assemblerOutput.vertices[currentVertex].rawId = i;
-		assemblerOutput.vertices[currentVertex].vertexId = vertexOffset + index;
-		currentVertex++;
+
+		minimumIndex = std::min(minimumIndex, index);
+		maximumIndex = std::max(maximumIndex, index);
 	}
-	
-	if (assemblerOutput.vertices.size() != currentVertex)
+
+	// Every unique index is shaded once, rawId is its slot in the vertex output storage
+	assemblerOutput.indices.resize(indexCount);
+	const auto addVertex = [&](uint32_t i, T index, uint32_t& slot)
+	{
+		if (slot == INVALID_VERTEX)
+		{
+			slot = static_cast<uint32_t>(assemblerOutput.vertices.size());
+			assemblerOutput.vertices.push_back(VertexInput{slot, vertexOffset + index});
+		}
+		assemblerOutput.indices[i] = slot;
+	};
+
+	const auto indexRange = static_cast<uint64_t>(maximumIndex) - minimumIndex + 1;
+	if (indexRange <= static_cast<uint64_t>(indexCount) * 4)
+	{
+		std::vector<uint32_t> cache(indexRange, INVALID_VERTEX);
+		for (auto i = 0u; i < indexCount; i++)
+		{
+			const auto index = indexData[firstIndex + i];
+			addVertex(i, index, cache[index - minimumIndex]);
+		}
+	}
+	else
 	{
-		assemblerOutput.vertices.resize(currentVertex);
+		std::unordered_map<T, uint32_t> cache{};
+		cache.reserve(indexCount);
+		for (auto i = 0u; i < indexCount; i++)
+		{
+			const auto index = indexData[firstIndex + i];
+			addVertex(i, index, cache.try_emplace(index, INVALID_VERTEX).first->second);
+		}
 	}
 }
 
 static AssemblerOutput ProcessInputAssemblerIndexed(DeviceState* deviceState, uint32_t firstIndex, uint32_t indexCount, uint32_t vertexOffset)
 {
 	AssemblerOutput assemblerOutput{};
-	assemblerOutput.vertices.resize(indexCount);
+	assemblerOutput.vertices.reserve(indexCount);
 
 	uint32_t primitiveSize = 0;
 	if (deviceState->graphicsPipelineState.pipeline->getInputAssemblyState().PrimitiveRestartEnable)
@@ -773,42 +791,58 @@ static bool EnsureVertexMemoryStorage(DeviceState* deviceState, uint64_t numberV
 	return !hasChanged;
 }
 
+static std::unique_ptr<uint8_t[]> PrepareVertexContext(DeviceState* deviceState, const VertexShaderModule* shaderModule, uint32_t& vertexStorageStride)
+{
+	auto context = shaderModule->CreateContext();
+	LoadContextBindings(deviceState, shaderModule->getBindingPlan(), context.get(), deviceState->graphicsPipelineState);
+	vertexStorageStride = shaderModule->getBindingPlan().outputStride;
+
+	return context;
+}
+
 static VertexOutput ProcessVertexShader(DeviceState* deviceState, uint32_t instance, const AssemblerOutput& assemblerOutput)
 {
 	assert(assemblerOutput.vertices.size() <= 0xFFFFFFFF);
 
-	const auto& shaderStage = deviceState->graphicsPipelineState.pipeline->getVertexShaderModule();
+	MaterialiseNonAttachmentClears(deviceState);
 
-	const auto spirvModule = shaderStage->getSPIRVModule();
-	const auto llvmModule = shaderStage->getLLVMModule();
+	const auto& shaderModule = deviceState->graphicsPipelineState.pipeline->getVertexShaderModule();
+	const auto entryPoint = reinterpret_cast<void(*)(const VertexInput*, uint32_t, uint32_t, uint8_t*)>(shaderModule->getEntryPoint());
+	const auto numberVertices = static_cast<uint32_t>(assemblerOutput.vertices.size());
+	const auto numberBatches = (numberVertices + VERTEX_BATCH_SIZE - 1) / VERTEX_BATCH_SIZE;
 
-	auto inputSize = 0u;
-	uint32_t vertexStorageStride = sizeof(VertexBuiltinOutput);
-	std::vector<VariableInOutData> inputData{};
-	std::vector<VariableUniformData> uniformData{};
-	std::vector<VariableInOutData> outputData{};
-	std::pair<void*, uint32_t> pushConstant{};
-	GetVariablePointers(spirvModule, llvmModule, inputData, uniformData, outputData, pushConstant, inputSize, vertexStorageStride);
+	// Every worker shades through its own context, writing only the output slots of its batch
+	const auto numberWorkers = numberBatches > 1 ? deviceState->threadPool->getNumberWorkers() : 1;
+	std::vector<std::unique_ptr<uint8_t[]>> contexts(numberWorkers);
+	uint32_t vertexStorageStride{};
+	for (auto i = 0u; i < numberWorkers; i++)
+	{
+		contexts[i] = PrepareVertexContext(deviceState, shaderModule, vertexStorageStride);
+	}
 
 	EnsureVertexMemoryStorage(deviceState, assemblerOutput.vertices.size(), vertexStorageStride);
-	const auto outputStorage = deviceState->graphicsPipelineState.pipeline->getVertexShaderModule()->getLLVMModule()->getPointer("@outputStorage");
+	const auto outputStorage = shaderModule->getLLVMModule()->getPointer("@outputStorage");
 	*static_cast<void**>(outputStorage) = deviceState->graphicsPipelineState.vertexOutputStorage.data();
 
 	const VertexOutput output
 	{
 		sizeof(VertexBuiltinOutput),
 		vertexStorageStride,
-		static_cast<uint32_t>(assemblerOutput.vertices.size()),
+		numberVertices,
 	};
 
-	LoadUniforms(deviceState, uniformData, deviceState->graphicsPipelineState);
-
-	if (pushConstant.first)
+	if (numberWorkers == 1)
 	{
-		memcpy(pushConstant.first, deviceState->pushConstants, pushConstant.second);
+		entryPoint(assemblerOutput.vertices.data(), numberVertices, instance, contexts[0].get());
+		return output;
 	}
 
-	reinterpret_cast<void(*)(const VertexInput*, uint32_t, uint32_t)>(deviceState->graphicsPipelineState.pipeline->getVertexShaderModule()->getEntryPoint())(assemblerOutput.vertices.data(), static_cast<uint32_t>(assemblerOutput.vertices.size()), instance);
+	deviceState->threadPool->ParallelFor(numberBatches, [&](uint32_t batch, uint32_t workerIndex)
+	{
+		const auto start = batch * VERTEX_BATCH_SIZE;
+		const auto count = std::min(numberVertices - start, static_cast<uint32_t>(VERTEX_BATCH_SIZE));
+		entryPoint(assemblerOutput.vertices.data() + start, count, instance, contexts[workerIndex].get());
+	});
 	
 	return output;
 }
@@ -837,7 +871,7 @@ T SetDatum(const float points[size], const T values[size], const float weights[s
 }
 
 template<bool Perspective, int size>
-void SetDatum(const VariableInOutData& input, float points[size], const void* data[size], float weights[size])
+void SetDatum(const ShaderVariableBinding& input, void* destination, float points[size], const void* data[size], float weights[size])
 {
 	const auto information = GetFormatInformation(input.format);
 	const auto numberElements = information.TotalSize / information.ElementSize;
@@ -856,7 +890,7 @@ void SetDatum(const VariableInOutData& input, float points[size], const void* da
 						values[j] = static_cast<const float*>(data[j])[i];
 					}
 
-					static_cast<float*>(input.pointer)[i] = SetDatum<Perspective, size>(points, values, weights);
+					static_cast<float*>(destination)[i] = SetDatum<Perspective, size>(points, values, weights);
 					break;
 				}
 
@@ -871,86 +905,70 @@ void SetDatum(const VariableInOutData& input, float points[size], const void* da
 	}
 }
 
-static bool GetFragmentInput(const std::vector<VariableInOutData>& inputData, const uint8_t* vertexData, uint64_t vertexStride,
-                             uint32_t provokingVertex, uint32_t p0Index, uint32_t p1Index, uint32_t p2Index,
-                             const glm::vec4& p0, const glm::vec4& p1, const glm::vec4& p2, const glm::vec2& p,
-                             VkCullModeFlags cullMode, float& depth, bool& front)
+// Computes the plane of every interpolated component once per triangle, so interpolating at a pixel is a dot product with its edge values
+static void SetupAttributePlanes(const std::vector<ShaderVariableBinding>& inputData, const uint8_t* vertexData, uint64_t vertexStride,
+                                 TriangleSetup& triangle, std::vector<glm::vec3>& planes)
 {
-	auto area = EdgeFunction(p0, p1, p2);
+	const auto barycentric = glm::vec3(triangle.inverseArea);
+	const auto inverseW = barycentric / glm::vec3(triangle.p0.w, triangle.p1.w, triangle.p2.w);
+	triangle.depthPlane = barycentric * glm::vec3(triangle.p0.z, triangle.p1.z, triangle.p2.z);
+	triangle.inverseWPlane = inverseW;
+	triangle.planeOffset = static_cast<uint32_t>(planes.size());
 
-	float w0;
-	float w1;
-	float w2;
-	if (area < 0)
+	for (const auto& input : inputData)
 	{
-		area = -area;
-		front = false;
-		w0 = EdgeFunction(p2, p1, p);
-		w1 = EdgeFunction(p0, p2, p);
-		w2 = EdgeFunction(p1, p0, p);
-	}
-	else
-	{
-		front = true;
-		w0 = EdgeFunction(p1, p2, p);
-		w1 = EdgeFunction(p2, p0, p);
-		w2 = EdgeFunction(p0, p1, p);
-	}
+		if (input.interpolation == InterpolationType::Flat)
+		{
+			continue;
+		}
 
-	if (w0 < 0 || w1 < 0 || w2 < 0 || ((cullMode & VK_CULL_MODE_BACK_BIT) && !front) || ((cullMode & VK_CULL_MODE_FRONT_BIT) && front))
-	{
-		return false;
+		const auto weights = input.interpolation == InterpolationType::Perspective ? inverseW : barycentric;
+		const auto data0 = reinterpret_cast<const float*>(vertexData + triangle.p0Index * vertexStride + input.offset);
+		const auto data1 = reinterpret_cast<const float*>(vertexData + triangle.p1Index * vertexStride + input.offset);
+		const auto data2 = reinterpret_cast<const float*>(vertexData + triangle.p2Index * vertexStride + input.offset);
+		for (auto i = 0u; i < input.size / sizeof(float); i++)
+		{
+			planes.push_back(weights * glm::vec3(data0[i], data1[i], data2[i]));
+		}
 	}
+}
 
-	w0 /= area;
-	w1 /= area;
-	w2 /= area;
-
-	depth = p0.z * w0 + p1.z * w1 + p2.z * w2;
+static void GetFragmentInput(const std::vector<ShaderVariableBinding>& inputData, const uint8_t* vertexData, uint64_t vertexStride, const glm::vec3* planes,
+                             const TriangleSetup& triangle, const glm::vec3& edges, FragmentBatch& batch, uint32_t lane, float& depth)
+{
+	depth = glm::dot(triangle.depthPlane, edges);
+	const auto w = 1.0f / glm::dot(triangle.inverseWPlane, edges);
 
-	for (auto input : inputData)
+	auto plane = planes + triangle.planeOffset;
+	for (const auto& input : inputData)
 	{
-		float points[]
-		{
-			p0.w,
-			p1.w,
-			p2.w,
-		};
-
-		const void* data[]
-		{
-			vertexData + p0Index * vertexStride + input.offset,
-			vertexData + p1Index * vertexStride + input.offset,
-			vertexData + p2Index * vertexStride + input.offset,
-		};
-
-		float weights[]
-		{
-			w0,
-			w1,
-			w2,
-		};
+		// Batch inputs are laid out per variable, see CompileBatchFunction
+		const auto destination = batch.inputs + (input.offset - sizeof(VertexBuiltinOutput)) * FRAGMENT_BATCH_SIZE + lane * input.size;
 
 		switch (input.interpolation)
 		{
 		case InterpolationType::Perspective:
-			SetDatum<true, 3>(input, points, data, weights);
+			for (auto i = 0u; i < input.size / sizeof(float); i++)
+			{
+				reinterpret_cast<float*>(destination)[i] = glm::dot(*plane++, edges) * w;
+			}
 			break;
 			
 		case InterpolationType::Linear:
-			SetDatum<false, 3>(input, points, data, weights);
+			for (auto i = 0u; i < input.size / sizeof(float); i++)
+			{
+				reinterpret_cast<float*>(destination)[i] = glm::dot(*plane++, edges);
+			}
 			break;
 			
 		case InterpolationType::Flat:
-			memcpy(input.pointer, vertexData + provokingVertex * vertexStride + input.offset, input.size);
+			memcpy(destination, vertexData + triangle.provokingVertex * vertexStride + input.offset, input.size);
 			break;
 			
 		default:
 			FATAL_ERROR();
 		}
 	}
-
-	return true;
 }
 
 template<typename T, bool IsSource>
@@ -1297,25 +1315,107 @@ static ReturnType ImageFetch(DeviceState* deviceState, VkFormat format, ImageVie
 	                            ReturnType{});
 }
 
-static void DrawPixel(DeviceState* deviceState, FragmentBuiltinInput* builtinInput, FragmentBuiltinOutput* builtinOutput, const FragmentShaderModule* shaderModule, bool front, float depth,
+static void DrawPixel(DeviceState* deviceState, FragmentWorker& worker, bool front, float depth,
                       std::pair<AttachmentDescription, ImageView*> depthImage, std::pair<AttachmentDescription, ImageView*> stencilImage,
-                      std::vector<std::pair<AttachmentDescription, ImageView*>>& images, std::vector<VariableInOutData>& outputData, 
+                      std::vector<std::pair<AttachmentDescription, ImageView*>>& images, 
                       uint32_t x, uint32_t y)
 {
-	builtinInput->fragCoord.z = depth;
+	worker.builtinInput->fragCoord.z = depth;
 	
 	const auto viewport = deviceState->graphicsPipelineState.pipeline->getDynamicState().DynamicViewport
 		                      ? deviceState->graphicsPipelineState.dynamicState.viewports[0]
 		                      : deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports[0];
 	depth = (viewport.maxDepth - viewport.minDepth) * depth + viewport.minDepth;
 
-	reinterpret_cast<void(*)(float, uint32_t, uint32_t, bool)>(shaderModule->getEntryPoint())(depth, x, y, front);
+	reinterpret_cast<void(*)(float, uint32_t, uint32_t, bool, uint8_t*)>(worker.entryPoint)(depth, x, y, front, worker.context.get());
 }
 
-static void ProcessPoints(DeviceState* deviceState, const AssemblerOutput& assemblerOutput, FragmentBuiltinInput* builtinInput, FragmentBuiltinOutput* builtinOutput, const FragmentShaderModule* shaderModule,
-                          std::pair<AttachmentDescription, ImageView*> depthImage, std::pair<AttachmentDescription, ImageView*> stencilImage,
-                          std::vector<std::pair<AttachmentDescription, ImageView*>>& images, std::vector<VariableInOutData>& outputData,
-                          const VertexOutput& output, const RasterizationState& rasterisationState, std::vector<VariableInOutData>& inputData)
+static void FlushFragmentBatch(FragmentWorker& worker)
+{
+	if (worker.batchSize == 0)
+	{
+		return;
+	}
+
+	reinterpret_cast<void(*)(FragmentBatch*, uint8_t*)>(worker.batchEntryPoint)(worker.batch.get(), worker.context.get());
+	worker.batch->mask = 0;
+	worker.batchSize = 0;
+}
+
+static void AddFragment(FragmentWorker& worker, const FragmentShaderModule* shaderModule, const TriangleSetup& triangle, const uint8_t* vertexData, uint64_t vertexStride,
+                        const glm::vec3* planes, const VkViewport& viewport, const glm::vec3& edges, int32_t x, int32_t y, bool covered)
+{
+	auto& batch = *worker.batch;
+	const auto lane = worker.batchSize++;
+
+	float depth;
+	GetFragmentInput(worker.bindingPlan->inputs, vertexData, vertexStride, planes, triangle, edges, batch, lane, depth);
+
+	batch.x[lane] = x;
+	batch.y[lane] = y;
+	batch.depth[lane] = (viewport.maxDepth - viewport.minDepth) * depth + viewport.minDepth + triangle.depthBias;
+	batch.fragCoord[lane] = glm::vec4(shaderModule->getOriginUpper() ? x : 2 * viewport.x + viewport.width - x - 1, y, depth, 1);
+	if (covered)
+	{
+		batch.mask |= 1u << lane;
+	}
+
+	if (worker.batchSize == FRAGMENT_BATCH_SIZE)
+	{
+		FlushFragmentBatch(worker);
+	}
+}
+
+struct PixelBounds
+{
+	int32_t startX;
+	int32_t startY;
+	int32_t endX;
+	int32_t endY;
+};
+
+static void ClipBounds(PixelBounds& bounds, const VkRect2D& rect)
+{
+	bounds.startX = std::max(bounds.startX, rect.offset.x);
+	bounds.startY = std::max(bounds.startY, rect.offset.y);
+	bounds.endX = std::min(bounds.endX, static_cast<int32_t>(rect.offset.x + rect.extent.width));
+	bounds.endY = std::min(bounds.endY, static_cast<int32_t>(rect.offset.y + rect.extent.height));
+}
+
+// 27.3. Scissor Test, no fragment outside the scissor or render area is ever kept, so primitives are clipped to them during setup
+static PixelBounds GetRasterisationBounds(DeviceState* deviceState, const VkViewport& viewport)
+{
+	// In framebuffer coordinates, like the scissor and render area
+	PixelBounds bounds
+	{
+		static_cast<int32_t>(viewport.x),
+		static_cast<int32_t>(viewport.y),
+		static_cast<int32_t>(viewport.x + viewport.width),
+		static_cast<int32_t>(viewport.y + viewport.height),
+	};
+
+	const auto pipeline = deviceState->graphicsPipelineState.pipeline;
+	if (pipeline->getDynamicState().DynamicScissor)
+	{
+		ClipBounds(bounds, deviceState->graphicsPipelineState.dynamicState.scissors[0]);
+	}
+	else if (!pipeline->getViewportState().Scissors.empty())
+	{
+		ClipBounds(bounds, pipeline->getViewportState().Scissors[0]);
+	}
+
+	if (deviceState->graphicsPipelineState.currentRenderPass)
+	{
+		ClipBounds(bounds, deviceState->graphicsPipelineState.currentRenderArea);
+	}
+
+	return bounds;
+}
+
+static void ProcessPoints(DeviceState* deviceState, const AssemblerOutput& assemblerOutput, FragmentWorker& worker, const FragmentShaderModule* shaderModule,
+                          std::pair<AttachmentDescription, ImageView*> depthImage, std::pair<AttachmentDescription, ImageView*> stencilImage,
+                          std::vector<std::pair<AttachmentDescription, ImageView*>>& images,
+                          const VertexOutput& output, const RasterizationState& rasterisationState)
 {
 	if (output.vertexCount < 1)
 	{
@@ -1330,6 +1430,7 @@ static void ProcessPoints(DeviceState* deviceState, const AssemblerOutput& assem
 	const auto viewport = deviceState->graphicsPipelineState.pipeline->getDynamicState().DynamicViewport
 		                      ? deviceState->graphicsPipelineState.dynamicState.viewports[0]
 		                      : deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports[0];
+	const auto bounds = GetRasterisationBounds(deviceState, viewport);
 
 	for (const auto& primitive : assemblerOutput.primitives)
 	{
@@ -1342,53 +1443,913 @@ static void ProcessPoints(DeviceState* deviceState, const AssemblerOutput& assem
 		p0.w = builtinData0.position.w;
 		const auto pointScreen = glm::ivec2
 		{
-			static_cast<int32_t>((p0.x + 1) * 0.5f * (viewport.width - 1)),
-			static_cast<int32_t>((p0.y + 1) * 0.5f * (viewport.height - 1)),
+			static_cast<int32_t>(viewport.x + (p0.x + 1) * 0.5f * (viewport.width - 1)),
+			static_cast<int32_t>(viewport.y + (p0.y + 1) * 0.5f * (viewport.height - 1)),
 		};
 		const auto pointSize = builtinData0.pointSize;
 		const auto intPointSize = static_cast<int32_t>(std::ceil(pointSize / 2));
 
-		const auto startX = std::max(0, pointScreen.x - intPointSize);
-		const auto startY = std::max(0, pointScreen.y - intPointSize);
-		const auto endX = std::min(static_cast<int32_t>(viewport.width), pointScreen.x + intPointSize + 1);
-		const auto endY = std::min(static_cast<int32_t>(viewport.height), pointScreen.y + intPointSize + 1);
+		const auto startX = std::max(bounds.startX, pointScreen.x - intPointSize);
+		const auto startY = std::max(bounds.startY, pointScreen.y - intPointSize);
+		const auto endX = std::min(bounds.endX, pointScreen.x + intPointSize + 1);
+		const auto endY = std::min(bounds.endY, pointScreen.y + intPointSize + 1);
 		
 		for (auto y = startY; y < endY; y++)
 		{
-			builtinInput->fragCoord.y = y;
+			worker.builtinInput->fragCoord.y = y;
 		
 			for (auto x = startX; x < endX; x++)
 			{
-				builtinInput->fragCoord.x = shaderModule->getOriginUpper() ? x : viewport.width - x - 1;
+				worker.builtinInput->fragCoord.x = shaderModule->getOriginUpper() ? x : 2 * viewport.x + viewport.width - x - 1;
 
 				const auto s = 0.5f + (static_cast<int32_t>(x) - pointScreen.x) / pointSize;
 				const auto t = 0.5f + (static_cast<int32_t>(y) - pointScreen.y) / pointSize;
 				if (s >= 0 && t >= 0 && s <= 1 && t <= 1)
 				{
-					for (auto input : inputData)
+					for (const auto& input : worker.bindingPlan->inputs)
 					{
 						const auto data = deviceState->graphicsPipelineState.vertexOutputStorage.data() + p0Index * output.outputStride + input.offset;
-						memcpy(input.pointer, data, input.size);
+						memcpy(worker.context.get() + input.contextOffset, data, input.size);
+					}
+
+					const auto depth = p0.z;
+					DrawPixel(deviceState, worker, true, depth, depthImage, stencilImage, images, x, y);
+				}
+			}
+		}
+	}
+}
+
+static void ProcessLines(DeviceState* deviceState, const AssemblerOutput& assemblerOutput, FragmentWorker& worker, const FragmentShaderModule* shaderModule,
+                         std::pair<AttachmentDescription, ImageView*> depthImage, std::pair<AttachmentDescription, ImageView*> stencilImage,
+                         std::vector<std::pair<AttachmentDescription, ImageView*>>& images,
+                         const VertexOutput& output, const RasterizationState& rasterisationState)
+{
+	if (output.vertexCount < 2)
+	{
+		return;
+	}
+
+	if (deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports.size() != 1)
+	{
+		TODO_ERROR();
+	}
+
+	const auto viewport = deviceState->graphicsPipelineState.pipeline->getDynamicState().DynamicViewport
+		                      ? deviceState->graphicsPipelineState.dynamicState.viewports[0]
+		                      : deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports[0];
+
+	const auto bounds = GetRasterisationBounds(deviceState, viewport);
+	const auto halfPixel = glm::vec2(1.0f / viewport.width, 1.0f / viewport.height) * 0.5f;
+	const auto viewportOffset = glm::vec2(viewport.x, viewport.y);
+	const auto viewportSize = glm::vec2(viewport.width, viewport.height);
+	const auto vertexData = deviceState->graphicsPipelineState.vertexOutputStorage.data();
+
+	for (const auto& primitive : assemblerOutput.primitives)
+	{
+		auto provokingVertex = primitive.provokingVertex;
+		const auto p0Index = primitive.vertex[0];
+		const auto p1Index = primitive.vertex[1];
+		
+		if (rasterisationState.StippledLineEnable)
+		{
+			TODO_ERROR();
+		}
+
+		const auto& builtinData0 = *reinterpret_cast<VertexBuiltinOutput*>(vertexData + p0Index * output.outputStride);
+		const auto& builtinData1 = *reinterpret_cast<VertexBuiltinOutput*>(vertexData + p1Index * output.outputStride);
+
+		auto p0 = builtinData0.position / builtinData0.position.w;
+		auto p1 = builtinData1.position / builtinData1.position.w;
+		p0.w = builtinData0.position.w;
+		p1.w = builtinData1.position.w;
+
+		const auto screen0 = viewportOffset + (glm::xy(p0) + 1.0f) * 0.5f * viewportSize;
+		const auto screen1 = viewportOffset + (glm::xy(p1) + 1.0f) * 0.5f * viewportSize;
+		const auto screenDelta = screen1 - screen0;
+		if (screenDelta.x == 0 && screenDelta.y == 0)
+		{
+			continue;
+		}
+
+		const auto drawLinePixel = [&](int32_t x, int32_t y, float t)
+		{
+			worker.builtinInput->fragCoord.x = shaderModule->getOriginUpper() ? x : 2 * viewport.x + viewport.width - x - 1;
+			worker.builtinInput->fragCoord.y = y;
+
+			for (const auto& input : worker.bindingPlan->inputs)
+			{
+				const auto destination = worker.context.get() + input.contextOffset;
+				float points[]
+				{
+					p0.w,
+					p1.w,
+				};
+
+				const void* data[]
+				{
+					vertexData + p0Index * output.outputStride + input.offset,
+					vertexData + p1Index * output.outputStride + input.offset,
+				};
+
+				float weights[]
+				{
+					1 - t,
+					t,
+				};
+
+				switch (input.interpolation)
+				{
+				case InterpolationType::Perspective:
+					SetDatum<true, 2>(input, destination, points, data, weights);
+					break;
+
+				case InterpolationType::Linear:
+					SetDatum<false, 2>(input, destination, points, data, weights);
+					break;
+
+				case InterpolationType::Flat:
+					memcpy(destination, vertexData + provokingVertex * output.outputStride + input.offset, input.size);
+					break;
+
+				default:
+					FATAL_ERROR();
+				}
+			}
+
+			const auto depth = p0.z * (1 - t) + p1.z * t;
+			DrawPixel(deviceState, worker, true, depth, depthImage, stencilImage, images, x, y);
+		};
+
+		switch (rasterisationState.LineRasterizationMode)
+		{
+		case VK_LINE_RASTERIZATION_MODE_DEFAULT_EXT:
+		case VK_LINE_RASTERIZATION_MODE_RECTANGULAR_EXT:
+			{
+				const auto lineWidth = rasterisationState.LineWidth / viewportSize;
+				const auto lineDirection = glm::normalize(glm::xy(p1) - glm::xy(p0));
+				const auto perpendicularLineDirection = glm::fvec2{lineDirection.y, -lineDirection.x};
+				const auto p00 = glm::xy(p0) + perpendicularLineDirection * lineWidth;
+				const auto p01 = glm::xy(p0) - perpendicularLineDirection * lineWidth;
+				const auto p10 = glm::xy(p1) + perpendicularLineDirection * lineWidth;
+				const auto p11 = glm::xy(p1) - perpendicularLineDirection * lineWidth;
+				const auto lineVector = glm::xy(p1) - glm::xy(p0);
+				const auto inverseLengthSquared = 1.0f / glm::dot(lineVector, lineVector);
+
+				// Only walk the pixels under the bounds of the line's rectangle
+				const auto minimum = viewportOffset + (glm::min(glm::min(p00, p01), glm::min(p10, p11)) + 1.0f) * 0.5f * viewportSize;
+				const auto maximum = viewportOffset + (glm::max(glm::max(p00, p01), glm::max(p10, p11)) + 1.0f) * 0.5f * viewportSize;
+				const auto startX = std::max(bounds.startX, static_cast<int32_t>(std::floor(minimum.x)));
+				const auto startY = std::max(bounds.startY, static_cast<int32_t>(std::floor(minimum.y)));
+				const auto endX = std::min(bounds.endX, static_cast<int32_t>(std::ceil(maximum.x)) + 1);
+				const auto endY = std::min(bounds.endY, static_cast<int32_t>(std::ceil(maximum.y)) + 1);
+
+				for (auto y = startY; y < endY; y++)
+				{
+					const auto yf = ((static_cast<float>(y) - viewport.y) / viewport.height + halfPixel.y) * 2 - 1;
+
+					for (auto x = startX; x < endX; x++)
+					{
+						const auto xf = ((static_cast<float>(x) - viewport.x) / viewport.width + halfPixel.x) * 2 - 1;
+						const auto p = glm::vec2(xf, yf);
+
+						// Probably need a better algorithm, too aliased currently
+						if (EdgeFunction(p00, p01, p) >= 0 && EdgeFunction(p11, p10, p) >= 0 && EdgeFunction(p10, p00, p) >= 0 && EdgeFunction(p01, p11, p) >= 0)
+						{
+							const auto t = glm::clamp(glm::dot(p - glm::xy(p0), lineVector) * inverseLengthSquared, 0.0f, 1.0f);
+							drawLinePixel(x, y, t);
+						}
+					}
+				}
+				break;
+			}
+
+		case VK_LINE_RASTERIZATION_MODE_BRESENHAM_EXT:
+			{
+				// Steps one pixel at a time along the major axis, covering the pixels whose centres lie between the end points (diamond exit)
+				const auto major = std::abs(screenDelta.x) >= std::abs(screenDelta.y) ? 0 : 1;
+				const auto minor = 1 - major;
+				const auto majorLower = major == 0 ? bounds.startX : bounds.startY;
+				const auto majorUpper = major == 0 ? bounds.endX : bounds.endY;
+				const auto minorLower = major == 0 ? bounds.startY : bounds.startX;
+				const auto minorUpper = major == 0 ? bounds.endY : bounds.endX;
+				const auto majorStart = std::min(screen0[major], screen1[major]);
+				const auto majorEnd = std::max(screen0[major], screen1[major]);
+				const auto startPixel = std::max(majorLower, static_cast<int32_t>(std::ceil(majorStart - 0.5f)));
+				const auto endPixel = std::min(majorUpper, static_cast<int32_t>(std::ceil(majorEnd - 0.5f)));
+
+				// Wide lines extend along the minor axis
+				const auto width = std::max(1, static_cast<int32_t>(std::round(rasterisationState.LineWidth)));
+				const auto inverseMajorDelta = 1.0f / screenDelta[major];
+
+				for (auto pixel = startPixel; pixel < endPixel; pixel++)
+				{
+					const auto t = glm::clamp((pixel + 0.5f - screen0[major]) * inverseMajorDelta, 0.0f, 1.0f);
+					const auto minorPosition = screen0[minor] + screenDelta[minor] * t;
+					const auto minorStart = static_cast<int32_t>(std::floor(minorPosition)) - (width - 1) / 2;
+
+					for (auto minorPixel = std::max(minorLower, minorStart); minorPixel < std::min(minorUpper, minorStart + width); minorPixel++)
+					{
+						if (major == 0)
+						{
+							drawLinePixel(pixel, minorPixel, t);
+						}
+						else
+						{
+							drawLinePixel(minorPixel, pixel, t);
+						}
+					}
+				}
+				break;
+			}
+
+		case VK_LINE_RASTERIZATION_MODE_RECTANGULAR_SMOOTH_EXT:
+			TODO_ERROR();
+
+		default:
+			FATAL_ERROR();
+		}
+	}
+}
+
+static void UpdateHierarchicalDepth(DeviceState* deviceState, HierarchicalDepth& hierarchicalDepth, uint32_t startBlockX, uint32_t startBlockY, uint32_t endBlockX, uint32_t endBlockY)
+{
+	const auto imageView = hierarchicalDepth.imageView;
+	const auto image = imageView->getImage();
+	const auto& range = imageView->getSubresourceRange();
+	const auto& level = image->getImageSize().Level[range.baseMipLevel];
+
+	for (auto blockY = startBlockY; blockY < endBlockY; blockY++)
+	{
+		for (auto blockX = startBlockX; blockX < endBlockX; blockX++)
+		{
+			auto minimum = std::numeric_limits<float>::max();
+			auto maximum = std::numeric_limits<float>::lowest();
+			for (auto y = blockY * RASTERISER_BLOCK_SIZE; y < std::min((blockY + 1) * RASTERISER_BLOCK_SIZE, level.Height); y++)
+			{
+				for (auto x = blockX * RASTERISER_BLOCK_SIZE; x < std::min((blockX + 1) * RASTERISER_BLOCK_SIZE, level.Width); x++)
+				{
+					const auto depth = GetDepthPixel(deviceState, imageView->getFormat(), image, x, y, 0, range.baseMipLevel, range.baseArrayLayer);
+					minimum = std::min(minimum, depth);
+					maximum = std::max(maximum, depth);
+				}
+			}
+
+			hierarchicalDepth.minimum[blockY * hierarchicalDepth.blocksX + blockX] = minimum;
+			hierarchicalDepth.maximum[blockY * hierarchicalDepth.blocksX + blockX] = maximum;
+		}
+	}
+}
+
+static void BuildHierarchicalDepth(DeviceState* deviceState, ImageView* imageView)
+{
+	auto& hierarchicalDepth = deviceState->graphicsPipelineState.hierarchicalDepth;
+	const auto image = imageView->getImage();
+	const auto& range = imageView->getSubresourceRange();
+	const auto& level = image->getImageSize().Level[range.baseMipLevel];
+	hierarchicalDepth.imageView = imageView;
+	hierarchicalDepth.blocksX = (level.Width + RASTERISER_BLOCK_SIZE - 1) / RASTERISER_BLOCK_SIZE;
+	hierarchicalDepth.blocksY = (level.Height + RASTERISER_BLOCK_SIZE - 1) / RASTERISER_BLOCK_SIZE;
+	hierarchicalDepth.minimum.resize(hierarchicalDepth.blocksX * hierarchicalDepth.blocksY);
+	hierarchicalDepth.maximum.resize(hierarchicalDepth.blocksX * hierarchicalDepth.blocksY);
+
+	// Tiles still waiting on a clear hold the clear depth, which is read back from the first tile so it is rounded like any other
+	const auto pendingClear = image->getPendingClear(range.baseMipLevel, range.baseArrayLayer);
+	auto clearDepth = 0.0f;
+	if (pendingClear)
+	{
+		MaterialiseClearTile(image, range.baseMipLevel, range.baseArrayLayer, 0, 0);
+		clearDepth = GetDepthPixel(deviceState, imageView->getFormat(), image, 0, 0, 0, range.baseMipLevel, range.baseArrayLayer);
+	}
+
+	deviceState->threadPool->ParallelFor(hierarchicalDepth.blocksY, [&](uint32_t blockY, uint32_t)
+	{
+		if (!pendingClear)
+		{
+			UpdateHierarchicalDepth(deviceState, hierarchicalDepth, 0, blockY, hierarchicalDepth.blocksX, blockY + 1);
+			return;
+		}
+
+		const auto tileY = blockY * RASTERISER_BLOCK_SIZE / RASTERISER_TILE_SIZE;
+		for (auto blockX = 0u; blockX < hierarchicalDepth.blocksX; blockX++)
+		{
+			const auto tileX = blockX * RASTERISER_BLOCK_SIZE / RASTERISER_TILE_SIZE;
+			if (pendingClear->materialisedTiles[tileY * pendingClear->tilesX + tileX])
+			{
+				UpdateHierarchicalDepth(deviceState, hierarchicalDepth, blockX, blockY, blockX + 1, blockY + 1);
+			}
+			else
+			{
+				hierarchicalDepth.minimum[blockY * hierarchicalDepth.blocksX + blockX] = clearDepth;
+				hierarchicalDepth.maximum[blockY * hierarchicalDepth.blocksX + blockX] = clearDepth;
+			}
+		}
+	});
+}
+
+// Whether every fragment the triangle could produce in the block fails the depth test against everything stored there
+static bool IsBlockOccluded(const HierarchicalDepth& hierarchicalDepth, VkCompareOp compareOp, const TriangleSetup& triangle, int32_t blockX, int32_t blockY)
+{
+	const auto x = static_cast<uint32_t>(blockX / RASTERISER_BLOCK_SIZE);
+	const auto y = static_cast<uint32_t>(blockY / RASTERISER_BLOCK_SIZE);
+	if (x >= hierarchicalDepth.blocksX || y >= hierarchicalDepth.blocksY)
+	{
+		return false;
+	}
+
+	const auto index = y * hierarchicalDepth.blocksX + x;
+	switch (compareOp)
+	{
+	case VK_COMPARE_OP_NEVER:
+		return true;
+
+	case VK_COMPARE_OP_LESS:
+		return triangle.minDepth >= hierarchicalDepth.maximum[index];
+
+	case VK_COMPARE_OP_LESS_OR_EQUAL:
+		return triangle.minDepth > hierarchicalDepth.maximum[index];
+
+	case VK_COMPARE_OP_GREATER:
+		return triangle.maxDepth <= hierarchicalDepth.minimum[index];
+
+	case VK_COMPARE_OP_GREATER_OR_EQUAL:
+		return triangle.maxDepth < hierarchicalDepth.minimum[index];
+
+	default:
+		return false;
+	}
+}
+
+static void RasteriseTriangle(DeviceState* deviceState, FragmentWorker& worker, const FragmentShaderModule* shaderModule, const TriangleSetup& triangle, const glm::vec3* planes,
+                              const HierarchicalDepth* hierarchicalDepth, const VertexOutput& output, const VkViewport& viewport,
+                              int32_t startX, int32_t startY, int32_t endX, int32_t endY)
+{
+	const auto vertexData = deviceState->graphicsPipelineState.vertexOutputStorage.data();
+	const auto depthCompareOp = deviceState->graphicsPipelineState.pipeline->getDepthStencilState().DepthCompareOp;
+	worker.batch->front = triangle.front;
+
+	for (auto blockY = startY - startY % RASTERISER_BLOCK_SIZE; blockY < endY; blockY += RASTERISER_BLOCK_SIZE)
+	{
+		const auto blockStartY = std::max(blockY, startY);
+		const auto blockEndY = std::min(blockY + RASTERISER_BLOCK_SIZE, endY);
+
+		for (auto blockX = startX - startX % RASTERISER_BLOCK_SIZE; blockX < endX; blockX += RASTERISER_BLOCK_SIZE)
+		{
+			const auto blockStartX = std::max(blockX, startX);
+			const auto blockEndX = std::min(blockX + RASTERISER_BLOCK_SIZE, endX);
+
+			// Edge equations are linear, so the corner pixels bound the values over the whole block
+			const auto edges00 = triangle.edgeOrigin + triangle.edgeStepX * static_cast<float>(blockStartX) + triangle.edgeStepY * static_cast<float>(blockStartY);
+			const auto edges10 = edges00 + triangle.edgeStepX * static_cast<float>(blockEndX - 1 - blockStartX);
+			const auto edges01 = edges00 + triangle.edgeStepY * static_cast<float>(blockEndY - 1 - blockStartY);
+			const auto edges11 = edges10 + edges01 - edges00;
+			const auto minimum = glm::min(glm::min(edges00, edges10), glm::min(edges01, edges11));
+			const auto maximum = glm::max(glm::max(edges00, edges10), glm::max(edges01, edges11));
+
+			if (maximum.x < 0 || maximum.y < 0 || maximum.z < 0)
+			{
+				continue;
+			}
+
+			if (hierarchicalDepth && IsBlockOccluded(*hierarchicalDepth, depthCompareOp, triangle, blockX, blockY))
+			{
+				continue;
+			}
+
+			const auto fullyCovered = minimum.x >= 0 && minimum.y >= 0 && minimum.z >= 0;
+
+			if (worker.quadShading)
+			{
+				// Blocks are aligned to an even pixel, so quads never straddle blocks or tiles
+				for (auto y = blockStartY & ~1; y < blockEndY; y += 2)
+				{
+					for (auto x = blockStartX & ~1; x < blockEndX; x += 2)
+					{
+						const auto edges = triangle.edgeOrigin + triangle.edgeStepX * static_cast<float>(x) + triangle.edgeStepY * static_cast<float>(y);
+						const glm::vec3 quadEdges[]
+						{
+							edges,
+							edges + triangle.edgeStepX,
+							edges + triangle.edgeStepY,
+							edges + triangle.edgeStepX + triangle.edgeStepY,
+						};
+
+						bool covered[4];
+						for (auto i = 0; i < 4; i++)
+						{
+							const auto pixelX = x + (i & 1);
+							const auto pixelY = y + (i >> 1);
+							const auto& pixelEdges = quadEdges[i];
+							covered[i] = pixelX >= blockStartX && pixelX < blockEndX && pixelY >= blockStartY && pixelY < blockEndY &&
+								(fullyCovered || (pixelEdges.x >= 0 && pixelEdges.y >= 0 && pixelEdges.z >= 0));
+						}
+
+						if (!covered[0] && !covered[1] && !covered[2] && !covered[3])
+						{
+							continue;
+						}
+
+						// Uncovered pixels still run as helpers so the covered ones have neighbours to take derivatives against
+						for (auto i = 0; i < 4; i++)
+						{
+							AddFragment(worker, shaderModule, triangle, vertexData, output.outputStride, planes, viewport, quadEdges[i], x + (i & 1), y + (i >> 1), covered[i]);
+						}
+					}
+				}
+				continue;
+			}
+
+			auto rowEdges = edges00;
+			for (auto y = blockStartY; y < blockEndY; y++, rowEdges += triangle.edgeStepY)
+			{
+				auto edges = rowEdges;
+				for (auto x = blockStartX; x < blockEndX; x++, edges += triangle.edgeStepX)
+				{
+					if (fullyCovered || (edges.x >= 0 && edges.y >= 0 && edges.z >= 0))
+					{
+						AddFragment(worker, shaderModule, triangle, vertexData, output.outputStride, planes, viewport, edges, x, y, true);
+					}
+				}
+			}
+		}
+	}
+
+	// Batches never span triangles, so fragments still reach the attachments in primitive order
+	FlushFragmentBatch(worker);
+}
+
+static glm::vec3 GetPixelEdges(const TriangleSetup& triangle, int32_t x, int32_t y)
+{
+	return triangle.edgeOrigin + triangle.edgeStepX * static_cast<float>(x) + triangle.edgeStepY * static_cast<float>(y);
+}
+
+static bool CompareDepth(VkCompareOp compareOp, float depth, float currentDepth)
+{
+	switch (compareOp)
+	{
+	case VK_COMPARE_OP_NEVER:
+		return false;
+
+	case VK_COMPARE_OP_LESS:
+		return depth < currentDepth;
+
+	case VK_COMPARE_OP_EQUAL:
+		return depth == currentDepth;
+
+	case VK_COMPARE_OP_LESS_OR_EQUAL:
+		return depth <= currentDepth;
+
+	case VK_COMPARE_OP_GREATER:
+		return depth > currentDepth;
+
+	case VK_COMPARE_OP_NOT_EQUAL:
+		return depth != currentDepth;
+
+	case VK_COMPARE_OP_GREATER_OR_EQUAL:
+		return depth >= currentDepth;
+
+	case VK_COMPARE_OP_ALWAYS:
+		return true;
+
+	default:
+		FATAL_ERROR();
+	}
+}
+
+// Whether visibility can be resolved before shading: hidden fragments must have no effect, and the last fragment to pass must be the one left in every attachment
+static bool CanResolveVisibility(DeviceState* deviceState, const FragmentShaderModule* shaderModule, std::pair<AttachmentDescription, ImageView*> depthImage,
+                                 const RasterizationState& rasterisationState)
+{
+	const auto& depthStencilState = deviceState->graphicsPipelineState.pipeline->getDepthStencilState();
+	const auto& colourBlendState = deviceState->graphicsPipelineState.pipeline->getColourBlendState();
+	if (!deviceState->deferredShading || !depthImage.second || !shaderModule->getWritesOnlyColour() || rasterisationState.DepthClampEnable ||
+		!depthStencilState.DepthTestEnable || depthStencilState.StencilTestEnable || depthStencilState.DepthBoundsTestEnable || colourBlendState.LogicOpEnable)
+	{
+		return false;
+	}
+
+	// With these the fragment left in the attachment always passes against the depth from before the draw
+	switch (depthStencilState.DepthCompareOp)
+	{
+	case VK_COMPARE_OP_LESS:
+	case VK_COMPARE_OP_EQUAL:
+	case VK_COMPARE_OP_LESS_OR_EQUAL:
+	case VK_COMPARE_OP_GREATER:
+	case VK_COMPARE_OP_GREATER_OR_EQUAL:
+	case VK_COMPARE_OP_ALWAYS:
+		break;
+
+	default:
+		return false;
+	}
+
+	for (const auto& attachment : colourBlendState.Attachments)
+	{
+		if (attachment.blendEnable)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+constexpr auto NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+
+// Runs the depth test for every triangle of the tile in primitive order, leaving the triangle that would finally be written to each pixel
+static void ResolveTileVisibility(DeviceState* deviceState, FragmentWorker& worker, const ImageFunctions* depthFunctions, ImageView* depthImage,
+                                  const std::vector<TriangleSetup>& triangles, const std::vector<uint32_t>& tileTriangles, const VkViewport& viewport,
+                                  int32_t tileStartX, int32_t tileStartY)
+{
+	const auto& depthStencilState = deviceState->graphicsPipelineState.pipeline->getDepthStencilState();
+	const auto image = depthImage->getImage();
+	const auto& range = depthImage->getSubresourceRange();
+	const auto& level = image->getImageSize().Level[range.baseMipLevel];
+	const auto tileEndX = std::min(tileStartX + RASTERISER_TILE_SIZE, static_cast<int32_t>(level.Width));
+	const auto tileEndY = std::min(tileStartY + RASTERISER_TILE_SIZE, static_cast<int32_t>(level.Height));
+
+	std::fill(worker.visibilityTriangle.get(), worker.visibilityTriangle.get() + RASTERISER_TILE_SIZE * RASTERISER_TILE_SIZE, NO_TRIANGLE);
+	for (auto y = tileStartY; y < tileEndY; y++)
+	{
+		for (auto x = tileStartX; x < tileEndX; x++)
+		{
+			const auto index = (y - tileStartY) * RASTERISER_TILE_SIZE + (x - tileStartX);
+			worker.visibilityDepth[index] = GetDepthPixel(deviceState, depthImage->getFormat(), image, x, y, 0, range.baseMipLevel, range.baseArrayLayer);
+		}
+	}
+
+	for (const auto triangleIndex : tileTriangles)
+	{
+		const auto& triangle = triangles[triangleIndex];
+		for (auto y = std::max(triangle.startY, tileStartY); y < std::min(triangle.endY, tileEndY); y++)
+		{
+			for (auto x = std::max(triangle.startX, tileStartX); x < std::min(triangle.endX, tileEndX); x++)
+			{
+				const auto edges = GetPixelEdges(triangle, x, y);
+				if (edges.x < 0 || edges.y < 0 || edges.z < 0)
+				{
+					continue;
+				}
+
+				// Matches the depth the fragment pipeline will test and write
+				const auto depth = (viewport.maxDepth - viewport.minDepth) * glm::dot(triangle.depthPlane, edges) + viewport.minDepth + triangle.depthBias;
+				const auto index = (y - tileStartY) * RASTERISER_TILE_SIZE + (x - tileStartX);
+				if (CompareDepth(depthStencilState.DepthCompareOp, depth, worker.visibilityDepth[index]))
+				{
+					worker.visibilityTriangle[index] = triangleIndex;
+					if (depthStencilState.DepthWriteEnable)
+					{
+						// Round trip through the attachment format, so later comparisons see what would have been stored
+						alignas(8) uint8_t pixel[16]{};
+						depthFunctions->SetPixelDepthStencil(pixel, depth, 0);
+						worker.visibilityDepth[index] = depthFunctions->GetPixelDepth(pixel);
 					}
+				}
+			}
+		}
+	}
+}
+
+// Shades only the pixels the triangle won in ResolveTileVisibility
+static void ShadeVisibleTriangle(FragmentWorker& worker, const FragmentShaderModule* shaderModule, const TriangleSetup& triangle, uint32_t triangleIndex, const glm::vec3* planes,
+                                 const uint8_t* vertexData, const VertexOutput& output, const VkViewport& viewport,
+                                 int32_t tileStartX, int32_t tileStartY, int32_t startX, int32_t startY, int32_t endX, int32_t endY)
+{
+	worker.batch->front = triangle.front;
+
+	const auto isVisible = [&](int32_t x, int32_t y)
+	{
+		return x >= startX && x < endX && y >= startY && y < endY &&
+			worker.visibilityTriangle[(y - tileStartY) * RASTERISER_TILE_SIZE + (x - tileStartX)] == triangleIndex;
+	};
+
+	if (worker.quadShading)
+	{
+		// Tiles start on an even pixel, so quads stay within the tile
+		for (auto y = startY & ~1; y < endY; y += 2)
+		{
+			for (auto x = startX & ~1; x < endX; x += 2)
+			{
+				bool covered[4];
+				for (auto i = 0; i < 4; i++)
+				{
+					covered[i] = isVisible(x + (i & 1), y + (i >> 1));
+				}
+
+				if (!covered[0] && !covered[1] && !covered[2] && !covered[3])
+				{
+					continue;
+				}
+
+				for (auto i = 0; i < 4; i++)
+				{
+					const auto pixelX = x + (i & 1);
+					const auto pixelY = y + (i >> 1);
+					AddFragment(worker, shaderModule, triangle, vertexData, output.outputStride, planes, viewport, GetPixelEdges(triangle, pixelX, pixelY), pixelX, pixelY, covered[i]);
+				}
+			}
+		}
+	}
+	else
+	{
+		for (auto y = startY; y < endY; y++)
+		{
+			for (auto x = startX; x < endX; x++)
+			{
+				if (isVisible(x, y))
+				{
+					AddFragment(worker, shaderModule, triangle, vertexData, output.outputStride, planes, viewport, GetPixelEdges(triangle, x, y), x, y, true);
+				}
+			}
+		}
+	}
+
+	FlushFragmentBatch(worker);
+}
+
+// Clip space planes, a position is inside when dot(plane, position) >= 0
+constexpr auto CLIP_NEAR = 1u << 0;
+constexpr auto CLIP_FAR = 1u << 1;
+constexpr auto CLIP_DEPTH = CLIP_NEAR | CLIP_FAR;
+constexpr auto CLIP_PLANE_COUNT = 6u;
+
+static const glm::vec4 frustumPlanes[CLIP_PLANE_COUNT]
+{
+	glm::vec4(0, 0, 1, 0),
+	glm::vec4(0, 0, -1, 1),
+	glm::vec4(1, 0, 0, 1),
+	glm::vec4(-1, 0, 0, 1),
+	glm::vec4(0, 1, 0, 1),
+	glm::vec4(0, -1, 0, 1),
+};
+
+// The x/y planes sit on the guard band, so only triangles that are both huge and partially visible need clipping against them
+static const glm::vec4 clipPlanes[CLIP_PLANE_COUNT]
+{
+	glm::vec4(0, 0, 1, 0),
+	glm::vec4(0, 0, -1, 1),
+	glm::vec4(1, 0, 0, RASTERISER_GUARD_BAND),
+	glm::vec4(-1, 0, 0, RASTERISER_GUARD_BAND),
+	glm::vec4(0, 1, 0, RASTERISER_GUARD_BAND),
+	glm::vec4(0, -1, 0, RASTERISER_GUARD_BAND),
+};
+
+static uint32_t GetOutcode(const glm::vec4& position, const glm::vec4 (&planes)[CLIP_PLANE_COUNT])
+{
+	auto outcode = 0u;
+	for (auto i = 0u; i < CLIP_PLANE_COUNT; i++)
+	{
+		if (glm::dot(planes[i], position) < 0)
+		{
+			outcode |= 1u << i;
+		}
+	}
+	return outcode;
+}
+
+// Appends a vertex between a and b at t along the edge in clip space. Perspective inputs and the position are linear in clip space, NoPerspective
+// inputs are linear in screen space so use t corrected by w, and Flat inputs are copied from the provoking vertex, which is never a clipped vertex.
+static uint32_t AddClipVertex(std::vector<uint8_t>& clipVertices, const VertexOutput& output, const std::vector<ShaderVariableBinding>& inputData,
+                              const uint8_t* a, const uint8_t* b, const uint8_t* provoking, float t)
+{
+	const auto offset = clipVertices.size();
+	clipVertices.resize(offset + output.outputStride);
+
+	const auto source0 = reinterpret_cast<const float*>(a);
+	const auto source1 = reinterpret_cast<const float*>(b);
+	const auto destination = reinterpret_cast<float*>(clipVertices.data() + offset);
+	for (auto i = 0u; i < output.outputStride / sizeof(float); i++)
+	{
+		destination[i] = source0[i] + (source1[i] - source0[i]) * t;
+	}
+
+	const auto w0 = reinterpret_cast<const VertexBuiltinOutput*>(a)->position.w;
+	const auto w1 = reinterpret_cast<const VertexBuiltinOutput*>(b)->position.w;
+	const auto screenT = t * w1 / (w0 + (w1 - w0) * t);
+	for (const auto& input : inputData)
+	{
+		switch (input.interpolation)
+		{
+		case InterpolationType::Perspective:
+			break;
+
+		case InterpolationType::Linear:
+			for (auto i = input.offset / sizeof(float); i < (input.offset + input.size) / sizeof(float); i++)
+			{
+				destination[i] = source0[i] + (source1[i] - source0[i]) * screenT;
+			}
+			break;
+
+		case InterpolationType::Flat:
+			memcpy(clipVertices.data() + offset + input.offset, provoking + input.offset, input.size);
+			break;
+
+		default:
+			FATAL_ERROR();
+		}
+	}
+
+	return output.vertexCount + static_cast<uint32_t>(offset / output.outputStride);
+}
+
+// Sutherland-Hodgman against the planes in clipMask, returning the number of vertices in the clipped polygon
+static uint32_t ClipTriangle(const Primitive& primitive, const uint8_t* vertexData, std::vector<uint8_t>& clipVertices, const VertexOutput& output,
+                             const std::vector<ShaderVariableBinding>& inputData, uint32_t clipMask, uint32_t (&polygon)[CLIP_PLANE_COUNT + 3])
+{
+	// Every plane adds at most one vertex to the polygon while creating two, reserve up front so the vertex pointers stay valid
+	clipVertices.reserve(clipVertices.size() + CLIP_PLANE_COUNT * 2 * output.outputStride);
+	const auto getVertex = [&](uint32_t index)
+	{
+		return index < output.vertexCount
+			       ? vertexData + index * output.outputStride
+			       : clipVertices.data() + (index - output.vertexCount) * output.outputStride;
+	};
+
+	uint32_t buffer[CLIP_PLANE_COUNT + 3];
+	auto input = buffer;
+	auto result = polygon;
+	auto count = 3u;
+	std::copy(primitive.vertex, primitive.vertex + 3, input);
+
+	for (auto plane = 0u; plane < CLIP_PLANE_COUNT; plane++)
+	{
+		if (!(clipMask & (1u << plane)))
+		{
+			continue;
+		}
+
+		auto resultCount = 0u;
+		for (auto i = 0u; i < count; i++)
+		{
+			const auto current = input[i];
+			const auto next = input[(i + 1) % count];
+			const auto currentDistance = glm::dot(clipPlanes[plane], reinterpret_cast<const VertexBuiltinOutput*>(getVertex(current))->position);
+			const auto nextDistance = glm::dot(clipPlanes[plane], reinterpret_cast<const VertexBuiltinOutput*>(getVertex(next))->position);
+
+			if (currentDistance >= 0)
+			{
+				result[resultCount++] = current;
+			}
+
+			if ((currentDistance >= 0) != (nextDistance >= 0))
+			{
+				const auto t = currentDistance / (currentDistance - nextDistance);
+				result[resultCount++] = AddClipVertex(clipVertices, output, inputData, getVertex(current), getVertex(next), vertexData + primitive.provokingVertex * output.outputStride, t);
+			}
+		}
+
+		std::swap(input, result);
+		count = resultCount;
+		if (count < 3)
+		{
+			return 0;
+		}
+	}
+
+	if (input != polygon)
+	{
+		std::copy(input, input + count, polygon);
+	}
+	return count;
+}
+
+static glm::ivec2 GetScreenPosition(const glm::vec4& position, const VkViewport& viewport)
+{
+	return glm::ivec2
+	{
+		static_cast<int32_t>(viewport.x + (position.x + 1) * 0.5f * viewport.width),
+		static_cast<int32_t>(viewport.y + (position.y + 1) * 0.5f * viewport.height),
+	};
+}
+
+// Computes orientation, area and screen bounds once per triangle, returning false when it can be culled before any pixel is visited
+static bool SetupTriangle(const Primitive& primitive, const glm::vec4 (&positions)[3], const VkViewport& viewport, const PixelBounds& bounds,
+                          const RasterizationState& rasterisationState, const glm::vec2& pixelOrigin, const glm::vec2& pixelStep, TriangleSetup& triangle)
+{
+	triangle.provokingVertex = primitive.provokingVertex;
+	triangle.p0Index = primitive.vertex[0];
+	triangle.p1Index = primitive.vertex[1];
+	triangle.p2Index = primitive.vertex[2];
+	auto position0 = positions[0];
+	auto position2 = positions[2];
+	if (rasterisationState.FrontFace == VK_FRONT_FACE_CLOCKWISE)
+	{
+		std::swap(triangle.p0Index, triangle.p2Index);
+		std::swap(position0, position2);
+	}
+
+	// Clipping guarantees this for anything crossing the near plane, but projections where z >= 0 does not imply w > 0 can still get here
+	if (position0.w <= 0 || positions[1].w <= 0 || position2.w <= 0)
+	{
+		return false;
+	}
+
+	triangle.p0 = position0 / position0.w;
+	triangle.p1 = positions[1] / positions[1].w;
+	triangle.p2 = position2 / position2.w;
+	triangle.p0.w = position0.w;
+	triangle.p1.w = positions[1].w;
+	triangle.p2.w = position2.w;
+
+	// Zero area triangles cover no pixels, and a NaN or infinite area comes from a degenerate w
+	const auto area = EdgeFunction(triangle.p0, triangle.p1, triangle.p2);
+	if (!std::isnormal(area))
+	{
+		return false;
+	}
+
+	triangle.front = area > 0;
+	if (((rasterisationState.CullMode & VK_CULL_MODE_BACK_BIT) && !triangle.front) || ((rasterisationState.CullMode & VK_CULL_MODE_FRONT_BIT) && triangle.front))
+	{
+		return false;
+	}
+
+	const auto p0Screen = GetScreenPosition(triangle.p0, viewport);
+	const auto p1Screen = GetScreenPosition(triangle.p1, viewport);
+	const auto p2Screen = GetScreenPosition(triangle.p2, viewport);
+
+	triangle.startX = std::max(bounds.startX, std::min({p0Screen.x, p1Screen.x, p2Screen.x}));
+	triangle.startY = std::max(bounds.startY, std::min({p0Screen.y, p1Screen.y, p2Screen.y}));
+	triangle.endX = std::min(bounds.endX, std::max({p0Screen.x, p1Screen.x, p2Screen.x}) + 1);
+	triangle.endY = std::min(bounds.endY, std::max({p0Screen.y, p1Screen.y, p2Screen.y}) + 1);
+
+	// Entirely outside the viewport, scissor or render area
+	if (triangle.startX >= triangle.endX || triangle.startY >= triangle.endY)
+	{
+		return false;
+	}
+
+	const auto depth0 = (viewport.maxDepth - viewport.minDepth) * triangle.p0.z + viewport.minDepth;
+	const auto depth1 = (viewport.maxDepth - viewport.minDepth) * triangle.p1.z + viewport.minDepth;
+	const auto depth2 = (viewport.maxDepth - viewport.minDepth) * triangle.p2.z + viewport.minDepth;
+	triangle.minDepth = std::min({depth0, depth1, depth2});
+	triangle.maxDepth = std::max({depth0, depth1, depth2});
+
+	// Back facing triangles wind the other way, flip the edges so inside is always positive
+	const auto sign = triangle.front ? 1.0f : -1.0f;
+	const auto edge0 = GetEdgeEquation(triangle.p1, triangle.p2, pixelOrigin, pixelStep) * sign;
+	const auto edge1 = GetEdgeEquation(triangle.p2, triangle.p0, pixelOrigin, pixelStep) * sign;
+	const auto edge2 = GetEdgeEquation(triangle.p0, triangle.p1, pixelOrigin, pixelStep) * sign;
+	triangle.edgeStepX = glm::vec3(edge0.x, edge1.x, edge2.x);
+	triangle.edgeStepY = glm::vec3(edge0.y, edge1.y, edge2.y);
+	triangle.edgeOrigin = glm::vec3(edge0.z, edge1.z, edge2.z);
+	triangle.inverseArea = 1.0f / std::abs(area);
+	return true;
+}
+
+// 28.7.3. Depth Bias, the offset is constant over the triangle so it is worked out once
+static float GetDepthBias(const RasterizationState& rasterisationState, const VkViewport& viewport, VkFormat depthFormat, const TriangleSetup& triangle)
+{
+	// The largest slope of the depth in framebuffer coordinates
+	const auto depths = glm::vec3(triangle.p0.z, triangle.p1.z, triangle.p2.z) * (viewport.maxDepth - viewport.minDepth) + viewport.minDepth;
+	const auto slopeX = glm::dot(depths, triangle.edgeStepX) * triangle.inverseArea;
+	const auto slopeY = glm::dot(depths, triangle.edgeStepY) * triangle.inverseArea;
+	const auto slope = std::max(std::abs(slopeX), std::abs(slopeY));
+
+	// The minimum resolvable difference of the attachment, for float formats it depends on the largest depth of the triangle
+	float resolvable;
+	switch (depthFormat)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+		resolvable = std::ldexp(1.0f, -16);
+		break;
 
-					const auto depth = p0.z;
-					DrawPixel(deviceState, builtinInput, builtinOutput, shaderModule, true, depth, depthImage, stencilImage, images, outputData, x, y);
-				}
-			}
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+		resolvable = std::ldexp(1.0f, -24);
+		break;
+
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		{
+			auto exponent = 0;
+			std::frexp(std::max({std::abs(depths.x), std::abs(depths.y), std::abs(depths.z)}), &exponent);
+			resolvable = std::ldexp(1.0f, exponent - 1 - 23);
+			break;
 		}
+
+	default:
+		FATAL_ERROR();
 	}
-}
 
-static void ProcessLines(DeviceState* deviceState, const AssemblerOutput& assemblerOutput, FragmentBuiltinInput* builtinInput, FragmentBuiltinOutput* builtinOutput, const FragmentShaderModule* shaderModule,
-                         std::pair<AttachmentDescription, ImageView*> depthImage, std::pair<AttachmentDescription, ImageView*> stencilImage,
-                         std::vector<std::pair<AttachmentDescription, ImageView*>>& images, std::vector<VariableInOutData>& outputData,
-                         const VertexOutput& output, const RasterizationState& rasterisationState, std::vector<VariableInOutData>& inputData)
-{
-	if (output.vertexCount < 2)
+	const auto bias = slope * rasterisationState.DepthBiasSlopeFactor + resolvable * rasterisationState.DepthBiasConstantFactor;
+	if (rasterisationState.DepthBiasClamp > 0)
 	{
-		return;
+		return std::min(bias, rasterisationState.DepthBiasClamp);
 	}
+	if (rasterisationState.DepthBiasClamp < 0)
+	{
+		return std::max(bias, rasterisationState.DepthBiasClamp);
+	}
+	return bias;
+}
 
+static void ProcessTriangles(DeviceState* deviceState, const AssemblerOutput& assemblerOutput, std::vector<FragmentWorker>& workers, const FragmentShaderModule* shaderModule,
+                             std::pair<AttachmentDescription, ImageView*> depthImage, std::pair<AttachmentDescription, ImageView*> stencilImage,
+                             std::vector<std::pair<AttachmentDescription, ImageView*>>& images, 
+                             const VertexOutput& output, const RasterizationState& rasterisationState)
+{
 	if (deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports.size() != 1)
 	{
 		TODO_ERROR();
@@ -1398,199 +2359,273 @@ static void ProcessLines(DeviceState* deviceState, const AssemblerOutput& assemb
 		                      ? deviceState->graphicsPipelineState.dynamicState.viewports[0]
 		                      : deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports[0];
 
-	const auto halfPixel = glm::vec2(1.0f / viewport.width, 1.0f / viewport.height) * 0.5f;
+	// Maps framebuffer pixel (x, y) to the normalised device coordinates of its centre
+	const auto pixelStep = glm::vec2(2.0f / viewport.width, 2.0f / viewport.height);
+	const auto pixelOrigin = (0.5f - glm::vec2(viewport.x, viewport.y)) * pixelStep - 1.0f;
+	const auto vertexData = deviceState->graphicsPipelineState.vertexOutputStorage.data();
+	const auto bounds = GetRasterisationBounds(deviceState, viewport);
 
-	for (const auto& primitive : assemblerOutput.primitives)
+	// Tiles are laid out over the framebuffer from its origin, so they line up with the pending clear tiles and hierarchical depth blocks
+	const auto tilesX = (std::max(bounds.endX, 0) + RASTERISER_TILE_SIZE - 1) / RASTERISER_TILE_SIZE;
+	const auto tilesY = (std::max(bounds.endY, 0) + RASTERISER_TILE_SIZE - 1) / RASTERISER_TILE_SIZE;
+
+	// Bin every triangle into the tiles its bounds overlap, bins keep primitives in API order
+	std::vector<TriangleSetup> triangles{};
+	std::vector<std::vector<uint32_t>> tiles(tilesX * tilesY);
+	triangles.reserve(assemblerOutput.primitives.size());
+
+	const auto applyDepthBias = depthImage.second && rasterisationState.DepthBiasEnable;
+	if (applyDepthBias && deviceState->graphicsPipelineState.pipeline->getDynamicState().DynamicDepthBias)
 	{
-		auto provokingVertex = primitive.provokingVertex;
-		const auto p0Index = primitive.vertex[0];
-		const auto p1Index = primitive.vertex[1];
-		
-		if (rasterisationState.StippledLineEnable)
+		TODO_ERROR();
+	}
+
+	const auto binTriangle = [&](const Primitive& primitive, const glm::vec4 (&positions)[3])
+	{
+		TriangleSetup triangle{};
+		if (!SetupTriangle(primitive, positions, viewport, bounds, rasterisationState, pixelOrigin, pixelStep, triangle))
 		{
-			TODO_ERROR();
+			return;
 		}
 
-		const auto& builtinData0 = *reinterpret_cast<VertexBuiltinOutput*>(deviceState->graphicsPipelineState.vertexOutputStorage.data() + p0Index * output.outputStride);
-		const auto& builtinData1 = *reinterpret_cast<VertexBuiltinOutput*>(deviceState->graphicsPipelineState.vertexOutputStorage.data() + p1Index * output.outputStride);
+		// Biased depth bounds keep hierarchical depth rejection in step with the depth each fragment is tested with
+		if (applyDepthBias)
+		{
+			triangle.depthBias = GetDepthBias(rasterisationState, viewport, depthImage.second->getFormat(), triangle);
+			triangle.minDepth += triangle.depthBias;
+			triangle.maxDepth += triangle.depthBias;
+		}
 
-		auto p0 = builtinData0.position / builtinData0.position.w;
-		auto p1 = builtinData1.position / builtinData1.position.w;
-		p0.w = builtinData0.position.w;
-		p1.w = builtinData1.position.w;
-		const auto lineWidth = rasterisationState.LineWidth / glm::fvec2{viewport.width, viewport.height};
-
-		auto lineDirection = glm::normalize(p1 - p0);
-		auto perpendicularLineDirection = glm::fvec2{lineDirection.y, -lineDirection.x};
-		auto p00 = glm::xy(p0) + perpendicularLineDirection * lineWidth;
-		auto p01 = glm::xy(p0) - perpendicularLineDirection * lineWidth;
-		auto p10 = glm::xy(p1) + perpendicularLineDirection * lineWidth;
-		auto p11 = glm::xy(p1) - perpendicularLineDirection * lineWidth;
-			
-		for (auto y = 0u; y < viewport.height; y++)
+		const auto triangleIndex = static_cast<uint32_t>(triangles.size());
+		triangles.push_back(triangle);
+
+		for (auto tileY = triangle.startY / RASTERISER_TILE_SIZE; tileY <= (triangle.endY - 1) / RASTERISER_TILE_SIZE; tileY++)
 		{
-			const auto yf = (static_cast<float>(y) / viewport.height + halfPixel.y) * 2 - 1;
-			builtinInput->fragCoord.y = y;
-		
-			for (auto x = 0u; x < viewport.width; x++)
+			for (auto tileX = triangle.startX / RASTERISER_TILE_SIZE; tileX <= (triangle.endX - 1) / RASTERISER_TILE_SIZE; tileX++)
 			{
-				const auto xf = (static_cast<float>(x) / viewport.width + halfPixel.x) * 2 - 1;
-				builtinInput->fragCoord.x = shaderModule->getOriginUpper() ? x : viewport.width - x - 1;
-				const auto p = glm::vec2(xf, yf);
+				tiles[tileY * tilesX + tileX].push_back(triangleIndex);
+			}
+		}
+	};
 
-				switch (rasterisationState.LineRasterizationMode)
-				{
-				case VK_LINE_RASTERIZATION_MODE_DEFAULT_EXT:
-				case VK_LINE_RASTERIZATION_MODE_RECTANGULAR_EXT:
-					{
-						// Probably need a better algorithm, too aliased currently
-						if (EdgeFunction(p00, p01, p) >= 0 && EdgeFunction(p11, p10, p) >= 0 && EdgeFunction(p10, p00, p) >= 0 && EdgeFunction(p01, p11, p) >= 0)
-						{
-							auto t = glm::dot(p - glm::xy(p0), glm::xy(p1) - glm::xy(p0)) / (glm::length(glm::xy(p1) - glm::xy(p0)) * glm::length(glm::xy(p1) - glm::xy(p0)));
+	// Depth clamping disables the near and far clip planes
+	const auto planeMask = rasterisationState.DepthClampEnable ? ~CLIP_DEPTH : ~0u;
+	std::vector<uint8_t> clipVertices{};
 
-							for (auto input : inputData)
-							{
-								float points[]
-								{
-									p0.w,
-									p1.w,
-								};
-
-								const void* data[]
-								{
-									deviceState->graphicsPipelineState.vertexOutputStorage.data() + p0Index * output.outputStride + input.offset,
-									deviceState->graphicsPipelineState.vertexOutputStorage.data() + p1Index * output.outputStride + input.offset,
-								};
-
-								float weights[]
-								{
-									1 - t,
-									t,
-								};
-
-								switch (input.interpolation)
-								{
-								case InterpolationType::Perspective:
-									SetDatum<true, 2>(input, points, data, weights);
-									break;
-			
-								case InterpolationType::Linear:
-									SetDatum<false, 2>(input, points, data, weights);
-									break;
-			
-								case InterpolationType::Flat:
-									memcpy(input.pointer, deviceState->graphicsPipelineState.vertexOutputStorage.data() + provokingVertex * output.outputStride + input.offset, input.size);
-									break;
-			
-								default:
-									FATAL_ERROR();
-								}
-							}
+	for (const auto& primitive : assemblerOutput.primitives)
+	{
+		const glm::vec4 positions[]
+		{
+			reinterpret_cast<const VertexBuiltinOutput*>(vertexData + primitive.vertex[0] * output.outputStride)->position,
+			reinterpret_cast<const VertexBuiltinOutput*>(vertexData + primitive.vertex[1] * output.outputStride)->position,
+			reinterpret_cast<const VertexBuiltinOutput*>(vertexData + primitive.vertex[2] * output.outputStride)->position,
+		};
 
-							const auto depth = p0.z * t + p1.z * (1 - t);
-							DrawPixel(deviceState, builtinInput, builtinOutput, shaderModule, true, depth, depthImage, stencilImage, images, outputData, x, y);
-						}
-						break;
-					}
+		// Trivially reject anything wholly outside one frustum plane
+		if (GetOutcode(positions[0], frustumPlanes) & GetOutcode(positions[1], frustumPlanes) & GetOutcode(positions[2], frustumPlanes) & planeMask)
+		{
+			continue;
+		}
 
-				case VK_LINE_RASTERIZATION_MODE_BRESENHAM_EXT:
-					TODO_ERROR();
+		// Trivially accept anything within the near/far planes and the guard band
+		const auto clipMask = (GetOutcode(positions[0], clipPlanes) | GetOutcode(positions[1], clipPlanes) | GetOutcode(positions[2], clipPlanes)) & planeMask;
+		if (clipMask == 0)
+		{
+			binTriangle(primitive, positions);
+			continue;
+		}
 
-				case VK_LINE_RASTERIZATION_MODE_RECTANGULAR_SMOOTH_EXT:
-					TODO_ERROR();
+		uint32_t polygon[CLIP_PLANE_COUNT + 3];
+		const auto count = ClipTriangle(primitive, vertexData, clipVertices, output, shaderModule->getBindingPlan().inputs, clipMask, polygon);
+		const auto getPosition = [&](uint32_t index)
+		{
+			return index < output.vertexCount
+				       ? reinterpret_cast<const VertexBuiltinOutput*>(vertexData + index * output.outputStride)->position
+				       : reinterpret_cast<const VertexBuiltinOutput*>(clipVertices.data() + (index - output.vertexCount) * output.outputStride)->position;
+		};
 
-				default:
-					FATAL_ERROR();
-				}
+		// Clipping keeps the winding, so fanning the polygon gives triangles facing the same way as the original
+		for (auto i = 1u; i + 1 < count; i++)
+		{
+			const Primitive clipped
+			{
+				primitive.provokingVertex,
+				{polygon[0], polygon[i], polygon[i + 1]},
+			};
+			const glm::vec4 clippedPositions[]
+			{
+				getPosition(polygon[0]),
+				getPosition(polygon[i]),
+				getPosition(polygon[i + 1]),
+			};
+			binTriangle(clipped, clippedPositions);
+		}
+	}
+
+	// Clipped vertices are placed after the shaded vertices so fragments can interpolate them like any other
+	if (!clipVertices.empty())
+	{
+		auto& vertexStorage = deviceState->graphicsPipelineState.vertexOutputStorage;
+		const auto clipOffset = output.vertexCount * output.outputStride;
+		if (vertexStorage.size() < clipOffset + clipVertices.size())
+		{
+			vertexStorage.resize(clipOffset + clipVertices.size());
+		}
+		memcpy(vertexStorage.data() + clipOffset, clipVertices.data(), clipVertices.size());
+	}
+
+	const auto& inputData = shaderModule->getBindingPlan().inputs;
+	for (const auto& input : inputData)
+	{
+		if (input.interpolation != InterpolationType::Flat)
+		{
+			const auto information = GetFormatInformation(input.format);
+			if (information.Base != BaseType::SFloat || information.ElementSize != 4)
+			{
+				FATAL_ERROR();
 			}
 		}
 	}
-}
 
-static void ProcessTriangles(DeviceState* deviceState, const AssemblerOutput& assemblerOutput, FragmentBuiltinInput* builtinInput, FragmentBuiltinOutput* builtinOutput, const FragmentShaderModule* shaderModule,
-                             std::pair<AttachmentDescription, ImageView*> depthImage, std::pair<AttachmentDescription, ImageView*> stencilImage,
-                             std::vector<std::pair<AttachmentDescription, ImageView*>>& images, std::vector<VariableInOutData>& outputData, 
-                             const VertexOutput& output, const RasterizationState& rasterisationState, std::vector<VariableInOutData>& inputData)
-{
-	if (deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports.size() != 1)
+	std::vector<glm::vec3> planes{};
+	for (auto& triangle : triangles)
 	{
-		TODO_ERROR();
+		SetupAttributePlanes(inputData, deviceState->graphicsPipelineState.vertexOutputStorage.data(), output.outputStride, triangle, planes);
 	}
 
-	const auto viewport = deviceState->graphicsPipelineState.pipeline->getDynamicState().DynamicViewport
-		                      ? deviceState->graphicsPipelineState.dynamicState.viewports[0]
-		                      : deviceState->graphicsPipelineState.pipeline->getViewportState().Viewports[0];
+	// Blocks can only be skipped when the fragments that fail the depth test would have had no other effect
+	const auto& depthStencilState = deviceState->graphicsPipelineState.pipeline->getDepthStencilState();
+	auto& hierarchicalDepth = deviceState->graphicsPipelineState.hierarchicalDepth;
+	const auto canRejectBlocks = depthImage.second && shaderModule->getEarlyFragmentTests() &&
+		depthStencilState.DepthTestEnable && !depthStencilState.StencilTestEnable && !rasterisationState.DepthClampEnable;
+	if (canRejectBlocks && hierarchicalDepth.imageView != depthImage.second)
+	{
+		BuildHierarchicalDepth(deviceState, depthImage.second);
+	}
 
-	const auto halfPixel = glm::vec2(1.0f / viewport.width, 1.0f / viewport.height) * 0.5f;
+	const auto hasHierarchicalDepth = depthImage.second && hierarchicalDepth.imageView == depthImage.second;
+	const auto updateHierarchicalDepth = hasHierarchicalDepth && depthStencilState.DepthTestEnable && depthStencilState.DepthWriteEnable;
 
-	for (const auto& primitive : assemblerOutput.primitives)
+	const auto resolveVisibility = CanResolveVisibility(deviceState, shaderModule, depthImage, rasterisationState);
+	ImageFunctions* depthFunctions{};
+	if (resolveVisibility)
 	{
-		auto provokingVertex = primitive.provokingVertex;
-		auto p0Index = primitive.vertex[0];
-		auto p1Index = primitive.vertex[1];
-		auto p2Index = primitive.vertex[2];
-		if (rasterisationState.FrontFace == VK_FRONT_FACE_CLOCKWISE)
+		const auto& information = GetFormatInformation(depthImage.second->getFormat());
+		depthFunctions = deviceState->getImageFunctions(information.Format);
+		if (!depthFunctions->GetPixelDepth)
+		{
+			depthFunctions->GetPixelDepth = reinterpret_cast<decltype(depthFunctions->GetPixelDepth)::Type>(CompileGetPixelDepth(deviceState->jit, &information));
+		}
+		if (!depthFunctions->SetPixelDepthStencil)
 		{
-			std::swap(p0Index, p2Index);
+			depthFunctions->SetPixelDepthStencil = reinterpret_cast<decltype(depthFunctions->SetPixelDepthStencil)::Type>(CompileSetPixelDepthStencil(deviceState->jit, &information));
 		}
 
-		const auto& builtinData0 = *reinterpret_cast<VertexBuiltinOutput*>(deviceState->graphicsPipelineState.vertexOutputStorage.data() + p0Index * output.outputStride);
-		const auto& builtinData1 = *reinterpret_cast<VertexBuiltinOutput*>(deviceState->graphicsPipelineState.vertexOutputStorage.data() + p1Index * output.outputStride);
-		const auto& builtinData2 = *reinterpret_cast<VertexBuiltinOutput*>(deviceState->graphicsPipelineState.vertexOutputStorage.data() + p2Index * output.outputStride);
+		for (auto& worker : workers)
+		{
+			if (!worker.visibilityDepth)
+			{
+				worker.visibilityDepth = std::make_unique<float[]>(RASTERISER_TILE_SIZE * RASTERISER_TILE_SIZE);
+				worker.visibilityTriangle = std::make_unique<uint32_t[]>(RASTERISER_TILE_SIZE * RASTERISER_TILE_SIZE);
+			}
+		}
+	}
 
-		auto p0 = builtinData0.position / builtinData0.position.w;
-		auto p1 = builtinData1.position / builtinData1.position.w;
-		auto p2 = builtinData2.position / builtinData2.position.w;
-		p0.w = builtinData0.position.w;
-		p1.w = builtinData1.position.w;
-		p2.w = builtinData2.position.w;
-		
-		const auto p0Screen = glm::ivec2
+	std::vector<uint32_t> activeTiles{};
+	for (auto i = 0u; i < tiles.size(); i++)
+	{
+		if (!tiles[i].empty())
 		{
-			static_cast<int32_t>((p0.x + 1) * 0.5f * viewport.width),
-			static_cast<int32_t>((p0.y + 1) * 0.5f * viewport.height),
-		};
-		
-		const auto p1Screen = glm::ivec2
+			activeTiles.push_back(i);
+		}
+	}
+
+	// Attachments still waiting on a clear get it a tile at a time, just before the tile is shaded
+	const auto tileAttachments = deviceState->pendingClearImages.empty() ? std::vector<const ImageView*>{} : GetTileAttachments(deviceState);
+
+	// Tiles never share pixels, so each can be shaded independently by whichever worker picks it up
+	deviceState->threadPool->ParallelFor(static_cast<uint32_t>(activeTiles.size()), [&](uint32_t index, uint32_t workerIndex)
+	{
+		auto& worker = workers[workerIndex];
+		const auto tile = activeTiles[index];
+		const auto tileStartX = static_cast<int32_t>(tile % tilesX) * RASTERISER_TILE_SIZE;
+		const auto tileStartY = static_cast<int32_t>(tile / tilesX) * RASTERISER_TILE_SIZE;
+
+		for (const auto imageView : tileAttachments)
 		{
-			static_cast<int32_t>((p1.x + 1) * 0.5f * viewport.width),
-			static_cast<int32_t>((p1.y + 1) * 0.5f * viewport.height),
-		};
-		
-		const auto p2Screen = glm::ivec2
+			MaterialiseClearTile(imageView, tile % tilesX, tile / tilesX);
+		}
+
+		if (resolveVisibility)
 		{
-			static_cast<int32_t>((p2.x + 1) * 0.5f * viewport.width),
-			static_cast<int32_t>((p2.y + 1) * 0.5f * viewport.height),
-		};
+			ResolveTileVisibility(deviceState, worker, depthFunctions, depthImage.second, triangles, tiles[tile], viewport, tileStartX, tileStartY);
+		}
 
-		const auto startX = std::max(0, std::min({p0Screen.x, p1Screen.x, p2Screen.x}));
-		const auto startY = std::max(0, std::min({p0Screen.y, p1Screen.y, p2Screen.y}));
-		const auto endX = std::min(static_cast<int32_t>(viewport.width), std::max({p0Screen.x, p1Screen.x, p2Screen.x}) + 1);
-		const auto endY = std::min(static_cast<int32_t>(viewport.height), std::max({p0Screen.y, p1Screen.y, p2Screen.y}) + 1);
+		auto writtenStartX = tileStartX + RASTERISER_TILE_SIZE;
+		auto writtenStartY = tileStartY + RASTERISER_TILE_SIZE;
+		auto writtenEndX = tileStartX;
+		auto writtenEndY = tileStartY;
 
-		for (auto y = startY; y < endY; y++)
+		for (const auto triangleIndex : tiles[tile])
 		{
-			const auto yf = (static_cast<float>(y) / viewport.height + halfPixel.y) * 2 - 1;
-			builtinInput->fragCoord.y = y;
-
-			for (auto x = startX; x < endX; x++)
+			const auto& triangle = triangles[triangleIndex];
+			const auto startX = std::max(triangle.startX, tileStartX);
+			const auto startY = std::max(triangle.startY, tileStartY);
+			const auto endX = std::min(triangle.endX, tileStartX + RASTERISER_TILE_SIZE);
+			const auto endY = std::min(triangle.endY, tileStartY + RASTERISER_TILE_SIZE);
+			if (resolveVisibility)
 			{
-				const auto xf = (static_cast<float>(x) / viewport.width + halfPixel.x) * 2 - 1;
-				builtinInput->fragCoord.x = shaderModule->getOriginUpper() ? x : viewport.width - x - 1;
-				const auto p = glm::vec2(xf, yf);
-
-				float depth;
-				bool front;
-				if (GetFragmentInput(inputData, deviceState->graphicsPipelineState.vertexOutputStorage.data(), output.outputStride,
-				                     provokingVertex, p0Index, p1Index, p2Index,
-				                     p0, p1, p2, p,
-				                     rasterisationState.CullMode, depth, front))
-				{
-					DrawPixel(deviceState, builtinInput, builtinOutput, shaderModule, front, depth, depthImage, stencilImage, images, outputData, x, y);
-				}
+				ShadeVisibleTriangle(worker, shaderModule, triangle, triangleIndex, planes.data(), deviceState->graphicsPipelineState.vertexOutputStorage.data(), output, viewport,
+				                     tileStartX, tileStartY, startX, startY, endX, endY);
+			}
+			else
+			{
+				RasteriseTriangle(deviceState, worker, shaderModule, triangle, planes.data(), canRejectBlocks ? &hierarchicalDepth : nullptr, output, viewport,
+				                  startX, startY, endX, endY);
 			}
+
+			writtenStartX = std::min(writtenStartX, startX);
+			writtenStartY = std::min(writtenStartY, startY);
+			writtenEndX = std::max(writtenEndX, endX);
+			writtenEndY = std::max(writtenEndY, endY);
+		}
+
+		// Tiles are made of whole blocks, so no other worker touches these
+		if (updateHierarchicalDepth)
+		{
+			UpdateHierarchicalDepth(deviceState, hierarchicalDepth,
+			                        writtenStartX / RASTERISER_BLOCK_SIZE,
+			                        writtenStartY / RASTERISER_BLOCK_SIZE,
+			                        std::min((writtenEndX + RASTERISER_BLOCK_SIZE - 1) / RASTERISER_BLOCK_SIZE, static_cast<int32_t>(hierarchicalDepth.blocksX)),
+			                        std::min((writtenEndY + RASTERISER_BLOCK_SIZE - 1) / RASTERISER_BLOCK_SIZE, static_cast<int32_t>(hierarchicalDepth.blocksY)));
 		}
+	});
+}
+
+static FragmentWorker PrepareFragmentWorker(DeviceState* deviceState, const FragmentShaderModule* shaderModule)
+{
+	const auto llvmModule = shaderModule->getLLVMModule();
+
+	FragmentWorker worker{};
+	worker.entryPoint = shaderModule->getEntryPoint();
+	worker.batchEntryPoint = llvmModule->getFunctionPointer("@mainBatch");
+	worker.quadShading = llvmModule->getOptionalPointer("_quadState") != nullptr;
+
+	// Every lane of a quad has its own context, the first is also used for fragments shaded on their own
+	const auto contextCount = worker.quadShading ? FRAGMENT_QUAD_SIZE : 1;
+	worker.context = shaderModule->CreateContext(contextCount);
+	worker.builtinInput = static_cast<FragmentBuiltinInput*>(shaderModule->getContextPointer(worker.context.get(), "_builtinInput"));
+	worker.builtinOutput = static_cast<FragmentBuiltinOutput*>(shaderModule->getContextPointer(worker.context.get(), "_builtinOutput"));
+	
+	worker.bindingPlan = &shaderModule->getBindingPlan();
+	for (auto i = 0; i < contextCount; i++)
+	{
+		LoadContextBindings(deviceState, *worker.bindingPlan, worker.context.get() + shaderModule->getContextSize() * i, deviceState->graphicsPipelineState);
 	}
+	
+	worker.builtinInput->fragCoord = glm::vec4(0, 0, 0, 1);
+	worker.batch = std::make_unique<FragmentBatch>();
+	return worker;
 }
 
 static void ProcessFragmentShader(DeviceState* deviceState, const AssemblerOutput& assemblerOutput, const VertexOutput& output)
@@ -1603,22 +2638,6 @@ static void ProcessFragmentShader(DeviceState* deviceState, const AssemblerOutpu
 	{
 		TODO_ERROR();
 	}
-
-	const auto spirvModule = shaderModule->getSPIRVModule();
-	const auto llvmModule = shaderModule->getLLVMModule();
-
-	const auto builtinInputPointer = llvmModule->getPointer("_builtinInput");
-	const auto builtinOutputPointer = llvmModule->getPointer("_builtinOutput");
-	
-	uint32_t inputSize = sizeof(VertexBuiltinOutput);
-	auto outputSize = 0u;
-	std::vector<VariableInOutData> inputData{};
-	std::vector<VariableUniformData> uniformData{};
-	std::vector<VariableInOutData> outputData{};
-	std::pair<void*, uint32_t> pushConstant{};
-	GetVariablePointers(spirvModule, llvmModule, inputData, uniformData, outputData, pushConstant, inputSize, outputSize);
-	
-	LoadUniforms(deviceState, uniformData, deviceState->graphicsPipelineState);
 	
 	std::vector<std::pair<AttachmentDescription, ImageView*>> images{MAX_FRAGMENT_OUTPUT_ATTACHMENTS};
 	std::pair<AttachmentDescription, ImageView*> depthImage{};
@@ -1663,32 +2682,42 @@ static void ProcessFragmentShader(DeviceState* deviceState, const AssemblerOutpu
 		}
 	}
 	
-	if (pushConstant.first)
+	if (rasterisationState.PolygonMode != VK_POLYGON_MODE_FILL)
+	{
+		TODO_ERROR();
+	}
+
+	// Only triangles are rasterised in parallel, every worker shades through its own context
+	const auto numberWorkers = assemblerOutput.primitiveType == PrimitiveType::Triangle ? deviceState->threadPool->getNumberWorkers() : 1;
+	std::vector<FragmentWorker> workers{};
+	workers.reserve(numberWorkers);
+	for (auto i = 0u; i < numberWorkers; i++)
 	{
-		memcpy(pushConstant.first, deviceState->pushConstants, pushConstant.second);
+		workers.push_back(PrepareFragmentWorker(deviceState, shaderModule));
 	}
 	
-	auto builtinInput = static_cast<FragmentBuiltinInput*>(builtinInputPointer);
-	auto builtinOutput = static_cast<FragmentBuiltinOutput*>(builtinOutputPointer);
-	builtinInput->fragCoord = glm::vec4(0, 0, 0, 1);
-	
-	if (rasterisationState.PolygonMode != VK_POLYGON_MODE_FILL)
+	// Only the triangle rasteriser keeps the hierarchical depth up to date, or clears attachments a tile at a time
+	if (assemblerOutput.primitiveType != PrimitiveType::Triangle)
 	{
-		TODO_ERROR();
+		if (deviceState->graphicsPipelineState.pipeline->getDepthStencilState().DepthWriteEnable)
+		{
+			deviceState->graphicsPipelineState.hierarchicalDepth.imageView = nullptr;
+		}
+		MaterialiseClears(deviceState);
 	}
 	
 	switch (assemblerOutput.primitiveType)
 	{
 	case PrimitiveType::Point:
-		ProcessPoints(deviceState, assemblerOutput, builtinInput, builtinOutput, shaderModule, depthImage, stencilImage, images, outputData, output, rasterisationState, inputData);
+		ProcessPoints(deviceState, assemblerOutput, workers[0], shaderModule, depthImage, stencilImage, images, output, rasterisationState);
 		break;
 
 	case PrimitiveType::Line:
-		ProcessLines(deviceState, assemblerOutput, builtinInput, builtinOutput, shaderModule, depthImage, stencilImage, images, outputData, output, rasterisationState, inputData);
+		ProcessLines(deviceState, assemblerOutput, workers[0], shaderModule, depthImage, stencilImage, images, output, rasterisationState);
 		break;
 
 	case PrimitiveType::Triangle:
-		ProcessTriangles(deviceState, assemblerOutput, builtinInput, builtinOutput, shaderModule, depthImage, stencilImage, images, outputData, output, rasterisationState, inputData);
+		ProcessTriangles(deviceState, assemblerOutput, workers, shaderModule, depthImage, stencilImage, images, output, rasterisationState);
 		break;
 		
 	default:
@@ -1696,57 +2725,77 @@ static void ProcessFragmentShader(DeviceState* deviceState, const AssemblerOutpu
 	}
 }
 
+struct ComputeWorker
+{
+	std::unique_ptr<uint8_t[]> contexts;
+	std::unique_ptr<uint8_t[]> workgroup;
+};
+
+static ComputeWorker PrepareComputeWorker(DeviceState* deviceState, const ComputeShaderModule* shaderModule, uint32_t contextCount, uint64_t workgroupSize)
+{
+	ComputeWorker worker{};
+	worker.contexts = shaderModule->CreateContext(contextCount);
+	if (workgroupSize > 0)
+	{
+		worker.workgroup = std::make_unique<uint8_t[]>(workgroupSize);
+	}
+
+	for (auto i = 0u; i < contextCount; i++)
+	{
+		const auto context = worker.contexts.get() + shaderModule->getContextSize() * i;
+
+		assert(shaderModule->getBindingPlan().inputs.empty() && shaderModule->getBindingPlan().outputs.empty());
+		LoadContextBindings(deviceState, shaderModule->getBindingPlan(), context, deviceState->computePipelineState);
+
+		// Every invocation run by a worker shares its workgroup storage
+		if (worker.workgroup)
+		{
+			*static_cast<uint8_t**>(shaderModule->getContextPointer(context, "_workgroup")) = worker.workgroup.get();
+		}
+	}
+
+	return worker;
+}
+
 static void ProcessComputeShader(DeviceState* deviceState, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
 {
 	const auto& shaderStage = deviceState->computePipelineState.pipeline->getComputeShaderModule();
-	
-	const auto spirvModule = shaderStage->getSPIRVModule();
 	const auto llvmModule = shaderStage->getLLVMModule();
-	const auto localCount = shaderStage->getLocalSize();
-	
-	const auto builtinInputPointer = llvmModule->getPointer("_builtinInput");
-	
-	auto inputSize = 0u;
-	auto outputSize = 0u;
-	std::vector<VariableInOutData> inputData{};
-	std::vector<VariableUniformData> uniformData{};
-	std::vector<VariableInOutData> outputData{};
-	std::pair<void*, uint32_t> pushConstant{};
-	GetVariablePointers(spirvModule, llvmModule, inputData, uniformData, outputData, pushConstant, inputSize, outputSize);
-	
-	assert(inputData.empty() && outputData.empty());
-	
-	LoadUniforms(deviceState, uniformData, deviceState->computePipelineState);
-	
-	if (pushConstant.first)
+	const auto entryPoint = reinterpret_cast<void(*)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint8_t*)>(shaderStage->getEntryPoint());
+	const auto numberGroups = groupCountX * groupCountY * groupCountZ;
+	if (numberGroups == 0)
 	{
-		memcpy(pushConstant.first, deviceState->pushConstants, pushConstant.second);
+		return;
 	}
-	
-	auto builtinInput = static_cast<ComputeBuiltinInput*>(builtinInputPointer);
-	builtinInput->globalInvocationId = glm::ivec3();
-	builtinInput->localInvocationId = glm::ivec3();
-	builtinInput->workgroupInvocationId = glm::ivec3();
-	
-	for (builtinInput->workgroupInvocationId.z = 0, builtinInput->globalInvocationId.z = 0; builtinInput->workgroupInvocationId.z < groupCountZ; builtinInput->workgroupInvocationId.z++)
+
+	// Shaders with barriers take a context for every invocation of the workgroup, and shared variables need storage for each worker
+	const auto contextCount = *static_cast<uint32_t*>(llvmModule->getPointer("@contextCount"));
+	const auto workgroupSizePointer = llvmModule->getOptionalPointer("@workgroupStorageSize");
+	const auto workgroupSize = workgroupSizePointer ? *static_cast<uint64_t*>(workgroupSizePointer) : 0;
+
+	const auto numberWorkers = numberGroups > 1 ? deviceState->threadPool->getNumberWorkers() : 1;
+	std::vector<ComputeWorker> workers{};
+	workers.reserve(numberWorkers);
+	for (auto i = 0u; i < numberWorkers; i++)
 	{
-		for (builtinInput->localInvocationId.z = 0u; builtinInput->localInvocationId.z < localCount.z; builtinInput->localInvocationId.z++, builtinInput->globalInvocationId.z++)
-		{
-			for (builtinInput->workgroupInvocationId.y = 0, builtinInput->globalInvocationId.y = 0; builtinInput->workgroupInvocationId.y < groupCountY; builtinInput->workgroupInvocationId.y++)
-			{
-				for (builtinInput->localInvocationId.y = 0u; builtinInput->localInvocationId.y < localCount.y; builtinInput->localInvocationId.y++, builtinInput->globalInvocationId.y++)
-				{
-					for (builtinInput->workgroupInvocationId.x = 0, builtinInput->globalInvocationId.x = 0; builtinInput->workgroupInvocationId.x < groupCountX; builtinInput->workgroupInvocationId.x++)
-					{
-						for (builtinInput->localInvocationId.x = 0u; builtinInput->localInvocationId.x < localCount.x; builtinInput->localInvocationId.x++, builtinInput->globalInvocationId.x++)
-						{
-							shaderStage->getEntryPoint()();
-						}
-					}
-				}
-			}
-		}
+		workers.push_back(PrepareComputeWorker(deviceState, shaderStage, contextCount, workgroupSize));
+	}
+
+	if (numberWorkers == 1)
+	{
+		entryPoint(groupCountX, groupCountY, groupCountZ, 0, numberGroups, workers[0].contexts.get());
+		return;
 	}
+
+	// Split into several jobs per worker so uneven workgroups still balance across the pool
+	const auto groupsPerJob = std::max(numberGroups / (numberWorkers * COMPUTE_JOBS_PER_WORKER), 1u);
+	const auto numberJobs = (numberGroups + groupsPerJob - 1) / groupsPerJob;
+	deviceState->threadPool->ParallelFor(numberJobs, [&](uint32_t job, uint32_t workerIndex)
+	{
+		const auto firstGroup = job * groupsPerJob;
+		const auto lastGroup = std::min(firstGroup + groupsPerJob, numberGroups);
+		entryPoint(groupCountX, groupCountY, groupCountZ, firstGroup, lastGroup, workers[workerIndex].contexts.get());
+	});
 }
 
 class DrawCommand final : public Command
@@ -1774,6 +2823,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (auto i = 0u; i < instanceCount; i++)
@@ -1837,11 +2891,17 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
+		// The assembled vertices and primitives are the same for every instance
+		const auto assemblerOutput = ProcessInputAssemblerIndexed(deviceState, firstIndex, indexCount, vertexOffset);
 		for (auto i = 0u; i < instanceCount; i++)
 		{
-			const auto assemblerOutput = ProcessInputAssemblerIndexed(deviceState, firstIndex, indexCount, vertexOffset);
 			const auto vertexOutput = ProcessVertexShader(deviceState, firstInstance + i, assemblerOutput);
 
 			if (deviceState->graphicsPipelineState.pipeline->getShaderStage(1) != nullptr)
@@ -1896,6 +2956,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (auto j = 0ULL; j < drawCount; j++)
@@ -1958,14 +3023,20 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (auto j = 0ULL; j < drawCount; j++)
 		{
 			const auto drawCommand = reinterpret_cast<VkDrawIndexedIndirectCommand*>(buffer->getDataPtr(offset + j * stride, sizeof(VkDrawIndexedIndirectCommand)));
+			// The assembled vertices and primitives are the same for every instance
+			const auto assemblerOutput = ProcessInputAssemblerIndexed(deviceState, drawCommand->firstIndex, drawCommand->indexCount, drawCommand->vertexOffset);
 			for (auto i = 0u; i < drawCommand->instanceCount; i++)
 			{
-				const auto assemblerOutput = ProcessInputAssemblerIndexed(deviceState, drawCommand->firstIndex, drawCommand->indexCount, drawCommand->vertexOffset);
 				const auto vertexOutput = ProcessVertexShader(deviceState, drawCommand->firstInstance + i, assemblerOutput);
 
 				if (deviceState->graphicsPipelineState.pipeline->getShaderStage(1) != nullptr)
@@ -2052,6 +3123,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (const auto& range : ranges)
@@ -2108,6 +3184,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (const auto& range : ranges)
@@ -2160,6 +3241,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (auto& attachment : attachments)
@@ -2181,17 +3267,31 @@ public:
 				imageView = deviceState->graphicsPipelineState.currentFramebuffer->getAttachments()[attachmentReference];
 			}
 			
+			const auto canFill = CanFillTexels(GetFormatInformation(format));
+			uint8_t texel[MAX_TEXEL_SIZE]{};
 			if (attachment.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT)
 			{
+				if (canFill)
+				{
+					PackTexel(deviceState, format, attachment.clearValue.color, texel);
+				}
+
 				for (auto& rect : rects)
 				{
 					for (auto layer = 0u; layer < rect.layerCount; layer++)
 					{
+						const auto imageLayer = layer + rect.baseArrayLayer + imageView->getSubresourceRange().baseArrayLayer;
+						if (canFill)
+						{
+							ClearAttachmentRect(deviceState, imageView->getImage(), imageLayer, 0, rect.rect, texel);
+							continue;
+						}
+
 						for (auto y = rect.rect.offset.y; y < rect.rect.offset.y + rect.rect.extent.height; y++)
 						{
 							for (auto x = rect.rect.offset.x; x < rect.rect.offset.x + rect.rect.extent.width; x++)
 							{
-								SetPixel(deviceState, format, imageView->getImage(), x, y, 0, 0, layer + rect.baseArrayLayer + imageView->getSubresourceRange().baseArrayLayer, attachment.clearValue.color);
+								SetPixel(deviceState, format, imageView->getImage(), x, y, 0, 0, imageLayer, attachment.clearValue.color);
 							}
 						}
 					}
@@ -2201,19 +3301,36 @@ public:
 			if (attachment.aspectMask & (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT))
 			{
 				// TODO: use aspectMask
+				if (canFill)
+				{
+					PackTexel(deviceState, format, attachment.clearValue.depthStencil, texel);
+				}
+
 				for (auto& rect : rects)
 				{
 					for (auto layer = 0u; layer < rect.layerCount; layer++)
 					{
+						const auto imageLayer = layer + rect.baseArrayLayer + imageView->getSubresourceRange().baseArrayLayer;
+						if (canFill)
+						{
+							ClearAttachmentRect(deviceState, imageView->getImage(), imageLayer, 0, rect.rect, texel);
+							continue;
+						}
+
 						for (auto y = rect.rect.offset.y; y < rect.rect.offset.y + rect.rect.extent.height; y++)
 						{
 							for (auto x = rect.rect.offset.x; x < rect.rect.offset.x + rect.rect.extent.width; x++)
 							{
-								SetPixel(deviceState, format, imageView->getImage(), x, y, 0, 0, layer + rect.baseArrayLayer + imageView->getSubresourceRange().baseArrayLayer, attachment.clearValue.depthStencil);
+								SetPixel(deviceState, format, imageView->getImage(), x, y, 0, 0, imageLayer, attachment.clearValue.depthStencil);
 							}
 						}
 					}
 				}
+
+				if (deviceState->graphicsPipelineState.hierarchicalDepth.imageView == imageView)
+				{
+					deviceState->graphicsPipelineState.hierarchicalDepth.imageView = nullptr;
+				}
 			}
 		}
 	}
@@ -2245,6 +3362,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		const auto drawCount = std::min(maxDrawCount, *reinterpret_cast<uint32_t*>(countBuffer->getDataPtr(countBufferOffset, 4)));
@@ -2307,15 +3429,21 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		const auto drawCount = std::min(maxDrawCount, *reinterpret_cast<uint32_t*>(countBuffer->getDataPtr(countBufferOffset, 4)));
 		for (auto j = 0ULL; j < drawCount; j++)
 		{
 			const auto drawCommand = reinterpret_cast<VkDrawIndexedIndirectCommand*>(buffer->getDataPtr(offset + j * stride, sizeof(VkDrawIndexedIndirectCommand)));
+			// The assembled vertices and primitives are the same for every instance
+			const auto assemblerOutput = ProcessInputAssemblerIndexed(deviceState, drawCommand->firstIndex, drawCommand->indexCount, drawCommand->vertexOffset);
 			for (auto i = 0u; i < drawCommand->instanceCount; i++)
 			{
-				const auto assemblerOutput = ProcessInputAssemblerIndexed(deviceState, drawCommand->firstIndex, drawCommand->indexCount, drawCommand->vertexOffset);
 				const auto vertexOutput = ProcessVertexShader(deviceState, drawCommand->firstInstance + i, assemblerOutput);
 
 				if (deviceState->graphicsPipelineState.pipeline->getShaderStage(1) != nullptr)
@@ -2418,6 +3546,11 @@ void ClearImage(DeviceState* deviceState, Image* image, VkFormat format, uint32_
 	}
 }
 
+void MaterialiseClears(DeviceState* deviceState)
+{
+	MaterialiseClears(deviceState, {});
+}
+
 #if defined(VK_KHR_draw_indirect_count) || defined(VK_AMD_draw_indirect_count)
 void CommandBuffer::DrawIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride)
 {
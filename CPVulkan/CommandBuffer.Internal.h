@@ -11,6 +11,12 @@ public:
 #endif
 
 	virtual void Process(DeviceState* deviceState) = 0;
+
+	// Whether the command can run with clears still pending, otherwise they are all written before it runs
+	[[nodiscard]] virtual bool KeepsPendingClears() const
+	{
+		return false;
+	}
 };
 
 class FunctionCommand final : public Command
@@ -34,9 +40,16 @@ public:
 		action(deviceState);
 	}
 
+	// Only used for binding state
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 private:
 	std::function<void(DeviceState*)> action;
 };
 
 void ClearImage(DeviceState* deviceState, Image* image, VkFormat format, uint32_t baseMipLevel, uint32_t levelCount, uint32_t baseArrayLayer, uint32_t layerCount, VkClearColorValue colour);
 void ClearImage(DeviceState* deviceState, Image* image, VkFormat format, uint32_t baseMipLevel, uint32_t levelCount, uint32_t baseArrayLayer, uint32_t layerCount, VkImageAspectFlags aspects, VkClearDepthStencilValue colour);
+void MaterialiseClears(DeviceState* deviceState);
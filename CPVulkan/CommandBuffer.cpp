@@ -15,6 +15,7 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 
@@ -25,6 +26,11 @@ static void RunCommands(DeviceState* deviceState, const std::vector<std::unique_
 #if CV_DEBUG_LEVEL > 0
 		command->DebugOutput(deviceState);
 #endif
+		// Anything that could reach an image's memory directly needs the pending clears written first
+		if (!deviceState->pendingClearImages.empty() && !command->KeepsPendingClears())
+		{
+			MaterialiseClears(deviceState);
+		}
 		command->Process(deviceState);
 	}
 }
@@ -486,6 +492,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState*) override
 	{
 		event->Signal();
@@ -514,6 +525,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState*) override
 	{
 		event->Reset();
@@ -549,6 +565,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* state) override
 	{
 		assert(offset + size <= MAX_PUSH_CONSTANTS_SIZE);
@@ -563,6 +584,56 @@ private:
 	std::unique_ptr<uint8_t[]> values;
 };
 
+// Whether any subpass uses the attachment, the load and store operations of an unused attachment are ignored
+static bool IsAttachmentUsed(const RenderPass* renderPass, uint32_t attachment)
+{
+	const auto isAttachment = [&](const AttachmentReference& reference)
+	{
+		return reference.attachment == attachment;
+	};
+
+	for (const auto& subpass : renderPass->getSubpasses())
+	{
+		if (std::any_of(subpass.colourAttachments.begin(), subpass.colourAttachments.end(), isAttachment) ||
+			std::any_of(subpass.inputAttachments.begin(), subpass.inputAttachments.end(), isAttachment) ||
+			std::any_of(subpass.resolveAttachments.begin(), subpass.resolveAttachments.end(), isAttachment) ||
+			subpass.depthStencilAttachment.attachment == attachment)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Whether the operations leave every aspect the attachment's format has undefined
+template<typename Operation>
+static bool IsDontCare(const AttachmentDescription& attachment, Operation operation, Operation stencilOperation, Operation dontCare)
+{
+	const auto& information = GetFormatInformation(attachment.format);
+	if (information.Type != FormatType::DepthStencil)
+	{
+		return operation == dontCare;
+	}
+
+	return (information.DepthStencil.DepthOffset == INVALID_OFFSET || operation == dontCare) &&
+		(information.DepthStencil.StencilOffset == INVALID_OFFSET || stencilOperation == dontCare);
+}
+
+// Drops any clear still pending on the attachment, as whatever it held is undefined it never needs to be written
+static void DiscardClears(ImageView* imageView)
+{
+	const auto image = imageView->getImage();
+	const auto& range = imageView->getSubresourceRange();
+	const auto layerCount = range.layerCount == VK_REMAINING_ARRAY_LAYERS ? image->getArrayLayers() - range.baseArrayLayer : range.layerCount;
+	for (auto layer = 0u; layer < layerCount; layer++)
+	{
+		if (const auto pendingClear = image->getPendingClear(range.baseMipLevel, range.baseArrayLayer + layer))
+		{
+			pendingClear->isPending = false;
+		}
+	}
+}
+
 class BeginRenderPassCommand final : public Command
 {
 public:
@@ -588,6 +659,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		deviceState->graphicsPipelineState.currentSubpass = &renderPass->getSubpasses()[0];
@@ -595,6 +671,7 @@ public:
 		deviceState->graphicsPipelineState.currentRenderPass = renderPass;
 		deviceState->graphicsPipelineState.currentFramebuffer = framebuffer;
 		deviceState->graphicsPipelineState.currentRenderArea = renderArea;
+		deviceState->graphicsPipelineState.hierarchicalDepth.imageView = nullptr;
 
 		for (auto attachmentReference : deviceState->graphicsPipelineState.currentSubpass->colourAttachments)
 		{
@@ -637,6 +714,16 @@ public:
 				           aspects, clearValues[attachmentReference.attachment].depthStencil);
 			}
 		}
+
+		// Attachments loaded as don't care can skip writing any clear that was still pending from before the render pass
+		for (auto i = 0u; i < renderPass->getAttachments().size(); i++)
+		{
+			const auto& attachment = renderPass->getAttachments()[i];
+			if (IsAttachmentUsed(renderPass, i) && IsDontCare(attachment, attachment.loadOp, attachment.stencilLoadOp, VK_ATTACHMENT_LOAD_OP_DONT_CARE))
+			{
+				DiscardClears(framebuffer->getAttachments()[i]);
+			}
+		}
 	}
 
 private:
@@ -656,10 +743,16 @@ public:
 	}
 #endif
 	
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		deviceState->graphicsPipelineState.currentSubpassIndex += 1;
 		deviceState->graphicsPipelineState.currentSubpass = &deviceState->graphicsPipelineState.currentRenderPass->getSubpasses()[deviceState->graphicsPipelineState.currentSubpassIndex];
+		deviceState->graphicsPipelineState.hierarchicalDepth.imageView = nullptr;
 	}
 };
 
@@ -673,6 +766,11 @@ public:
 	}
 #endif
 	
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 #if CV_DEBUG_LEVEL >= CV_DEBUG_IMAGE
@@ -693,10 +791,22 @@ public:
 		}
 #endif
 
+		// The tiles of a don't care attachment that nothing drew to are never written
+		const auto renderPass = deviceState->graphicsPipelineState.currentRenderPass;
+		for (auto i = 0u; i < renderPass->getAttachments().size(); i++)
+		{
+			const auto& attachment = renderPass->getAttachments()[i];
+			if (IsAttachmentUsed(renderPass, i) && IsDontCare(attachment, attachment.storeOp, attachment.stencilStoreOp, VK_ATTACHMENT_STORE_OP_DONT_CARE))
+			{
+				DiscardClears(deviceState->graphicsPipelineState.currentFramebuffer->getAttachments()[i]);
+			}
+		}
+
 		deviceState->graphicsPipelineState.currentSubpass = nullptr;
 		deviceState->graphicsPipelineState.currentSubpassIndex = 0;
 		deviceState->graphicsPipelineState.currentRenderPass = nullptr;
 		deviceState->graphicsPipelineState.currentFramebuffer = nullptr;
+		deviceState->graphicsPipelineState.hierarchicalDepth.imageView = nullptr;
 		// TODO
 	}
 };
@@ -718,6 +828,11 @@ public:
 	}
 #endif
 
+	[[nodiscard]] bool KeepsPendingClears() const override
+	{
+		return true;
+	}
+
 	void Process(DeviceState* deviceState) override
 	{
 		for (const auto commandBuffer : commands)
@@ -964,5 +1079,7 @@ void CommandBuffer::ForceReset()
 VkResult CommandBuffer::Submit()
 {
 	RunCommands(deviceState, commands);
+	// The host and presentation only ever see memory, so nothing can be left pending past a submission
+	MaterialiseClears(deviceState);
 	return VK_SUCCESS;
 }
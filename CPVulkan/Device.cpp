@@ -4,16 +4,35 @@
 #include "DeviceState.h"
 #include "Extensions.h"
 #include "GlslFunctions.h"
+#include "ImageSampler.h"
 #include "Instance.h"
 #include "Queue.h"
+#include "ThreadPool.h"
 #include "Util.h"
+#include "Workgroup.h"
 
 #include <Jit.h>
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
+// Attachment and texture formats nearly every application uses, compiled as soon as the device exists
+static constexpr VkFormat commonFormats[]
+{
+	VK_FORMAT_R8G8B8A8_UNORM,
+	VK_FORMAT_R8G8B8A8_SRGB,
+	VK_FORMAT_B8G8R8A8_UNORM,
+	VK_FORMAT_B8G8R8A8_SRGB,
+	VK_FORMAT_R16G16B16A16_SFLOAT,
+	VK_FORMAT_R32G32B32A32_SFLOAT,
+	VK_FORMAT_D16_UNORM,
+	VK_FORMAT_D24_UNORM_S8_UINT,
+	VK_FORMAT_D32_SFLOAT,
+};
+
 Device::Device() :
 	state{std::make_unique<DeviceState>()}
 {
@@ -23,7 +42,17 @@ Device::Device() :
 #endif
 	
 	state->jit = new CPJit();
+	state->threadPool = new ThreadPool();
+
+	const auto deferredShading = std::getenv(RASTERISER_DEFERRED_SHADING_VARIABLE);
+	state->deferredShading = deferredShading && strcmp(deferredShading, "0") != 0;
+
+	for (const auto format : commonFormats)
+	{
+		PrecompileImageFunctions(state.get(), format);
+	}
 	AddGlslFunctions(state.get());
+	AddWorkgroupFunctions(state.get());
 }
 
 Device::~Device()
@@ -39,7 +68,9 @@ Device::~Device()
 	}
 #endif
 
-	state->imageFunctions.clear();
+	delete state->threadPool;
+	// Wait for any queued precompilation, which writes into the image functions
+	state->jit->FlushCompileThread();
 	delete state->jit;
 }
 
@@ -1039,11 +1070,4 @@ VkResult Device::ReleaseFullScreenExclusiveMode(VkSwapchainKHR swapchain)
 VkResult Device::GetDeviceGroupSurfacePresentModes2(const VkPhysicalDeviceSurfaceInfo2KHR* pSurfaceInfo, VkDeviceGroupPresentModeFlagsKHR* pModes)
 {
 	TODO_ERROR();
-}
-
-ImageFunctions::ImageFunctions(CPJit* jit)
-{
-	this->jit = jit;
-}
-
-ImageFunctions::~ImageFunctions() = default;
\ No newline at end of file
+}
\ No newline at end of file
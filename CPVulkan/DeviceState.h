@@ -1,32 +1,57 @@
 #pragma once
 #include "Base.h"
 
+#include "Formats.h"
+
+#include <atomic>
+
 class CompiledModule;
 class CPJit;
+class ThreadPool;
 
 struct SubpassDescription;
 
-class ImageFunctions
+// A function pointer that one thread can publish while others call it, once read it is safe to call whatever it was compiled from
+template<typename Function>
+class AtomicFunction
 {
 public:
-	explicit ImageFunctions(CPJit* jit);
-	~ImageFunctions();
-
-	float (*GetPixelDepth)(const void* ptr){};
-	uint8_t (*GetPixelStencil)(const void* ptr){};
-	void (*GetPixelF32)(const void* ptr, void* values){};
-	void (*GetPixelF32C)(const void* ptr, void* values, uint32_t x, uint32_t y){};
-	void (*GetPixelI32)(const void* ptr, void* values){};
-	void (*GetPixelU32)(const void* ptr, void* values){};
-	
-	void (*SetPixelDepthStencil)(void* ptr, float depth, uint8_t stencil){};
-	void (*SetPixelF32)(void* ptr, const float* values){};
-	void (*SetPixelI32)(void* ptr, const int32_t* values){};
-	void (*SetPixelU32)(void* ptr, const uint32_t* values){};
+	using Type = Function;
+
+	AtomicFunction() = default;
+	AtomicFunction(const AtomicFunction&) = delete;
+	AtomicFunction& operator=(const AtomicFunction&) = delete;
+
+	AtomicFunction& operator=(Function value)
+	{
+		function.store(value, std::memory_order_release);
+		return *this;
+	}
+
+	operator Function() const
+	{
+		return function.load(std::memory_order_acquire);
+	}
 
 private:
-	std::vector<CompiledModule*> modules{};
-	CPJit* jit;
+	std::atomic<Function> function{};
+};
+
+class ImageFunctions
+{
+public:
+	// Compiled on first use by any thread, or ahead of time on the compile thread, while rasteriser workers call them
+	AtomicFunction<float (*)(const void* ptr)> GetPixelDepth{};
+	AtomicFunction<uint8_t (*)(const void* ptr)> GetPixelStencil{};
+	AtomicFunction<void (*)(const void* ptr, void* values)> GetPixelF32{};
+	AtomicFunction<void (*)(const void* ptr, void* values, uint32_t x, uint32_t y)> GetPixelF32C{};
+	AtomicFunction<void (*)(const void* ptr, void* values)> GetPixelI32{};
+	AtomicFunction<void (*)(const void* ptr, void* values)> GetPixelU32{};
+	
+	AtomicFunction<void (*)(void* ptr, float depth, uint8_t stencil)> SetPixelDepthStencil{};
+	AtomicFunction<void (*)(void* ptr, const float* values)> SetPixelF32{};
+	AtomicFunction<void (*)(void* ptr, const int32_t* values)> SetPixelI32{};
+	AtomicFunction<void (*)(void* ptr, const uint32_t* values)> SetPixelU32{};
 };
 
 struct DynamicPipelineState
@@ -53,6 +78,16 @@ struct GraphicsNativeState
 	ImageView* depthStencilAttachment;
 };
 
+// Per block depth bounds of a depth attachment, only valid until something other than a draw writes to it
+struct HierarchicalDepth
+{
+	ImageView* imageView;
+	uint32_t blocksX;
+	uint32_t blocksY;
+	std::vector<float> minimum;
+	std::vector<float> maximum;
+};
+
 class GraphicsPipelineState final : public CommonPipelineState
 {
 public:
@@ -71,6 +106,7 @@ public:
 	VkRect2D currentRenderArea;
 
 	std::vector<uint8_t> vertexOutputStorage{};
+	HierarchicalDepth hierarchicalDepth{};
 
 	DynamicPipelineState dynamicState;
 };
@@ -100,8 +136,16 @@ public:
 
 	uint8_t pushConstants[MAX_PUSH_CONSTANTS_SIZE];
 
-	std::unordered_map<VkFormat, std::unique_ptr<ImageFunctions>> imageFunctions{};
+	// Images with a clear that has not been written yet, all are written before a submission finishes
+	std::vector<Image*> pendingClearImages{};
+
+	// Indexed by GetFormatIndex
+	std::array<ImageFunctions, FORMAT_INDEX_COUNT> imageFunctions{};
 	CPJit* jit;
+	ThreadPool* threadPool;
+
+	// Resolve visibility per tile before shading where the pipeline allows it, see RASTERISER_DEFERRED_SHADING_VARIABLE
+	bool deferredShading{};
 	
 #if CV_DEBUG_LEVEL > 0
 	std::ofstream* debugOutput;
@@ -109,13 +153,6 @@ public:
 
 	ImageFunctions* getImageFunctions(VkFormat format)
 	{
-		auto ptr = imageFunctions.find(format);
-		if (ptr != imageFunctions.end())
-		{
-			return ptr->second.get();
-		}
-
-		imageFunctions[format] = std::make_unique<ImageFunctions>(jit);
-		return imageFunctions.at(format).get();
+		return &imageFunctions[GetFormatIndex(format)];
 	}
 };
\ No newline at end of file
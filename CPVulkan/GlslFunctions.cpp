@@ -443,8 +443,34 @@ static void GetImageDataArray(ImageDescriptor* descriptor, VkFormat& format, Coo
 	}
 }
 
+// 15.6.4. Cube Map Face Selection, sc, tc and rc of any vector are its dot products with the returned axes
+static uint32_t SelectCubeFace(glm::vec3 coordinates, glm::vec3 faceAxes[3])
+{
+	const auto abs = glm::abs(coordinates);
+	if (abs.z >= abs.y && abs.z >= abs.x)
+	{
+		faceAxes[0] = glm::vec3{coordinates.z < 0 ? -1 : 1, 0, 0};
+		faceAxes[1] = glm::vec3{0, -1, 0};
+		faceAxes[2] = glm::vec3{0, 0, 1};
+		return coordinates.z < 0 ? 5 : 4;
+	}
+
+	if (abs.y >= abs.x)
+	{
+		faceAxes[0] = glm::vec3{1, 0, 0};
+		faceAxes[1] = glm::vec3{0, 0, coordinates.y < 0 ? -1 : 1};
+		faceAxes[2] = glm::vec3{0, 1, 0};
+		return coordinates.y < 0 ? 3 : 2;
+	}
+
+	faceAxes[0] = glm::vec3{0, 0, coordinates.x < 0 ? 1 : -1};
+	faceAxes[1] = glm::vec3{0, -1, 0};
+	faceAxes[2] = glm::vec3{1, 0, 0};
+	return coordinates.x < 0 ? 1 : 0;
+}
+
 template<bool Array>
-void GetImageDataCube(ImageDescriptor* descriptor, VkFormat& format, glm::vec<3 + (Array ? 1 : 0), float> coordinates, gsl::span<uint8_t> data[MAX_MIP_LEVELS], glm::uvec2 range[MAX_MIP_LEVELS], uint32_t& baseLevel, uint32_t& levels, glm::fvec2& realCoordinates)
+void GetImageDataCube(ImageDescriptor* descriptor, VkFormat& format, glm::vec<3 + (Array ? 1 : 0), float> coordinates, gsl::span<uint8_t> data[MAX_MIP_LEVELS], glm::uvec2 range[MAX_MIP_LEVELS], uint32_t& baseLevel, uint32_t& levels, glm::fvec2& realCoordinates, glm::vec3 faceAxes[3])
 {
 	assert(descriptor->Type == ImageDescriptorType::Image);
 
@@ -455,56 +481,11 @@ void GetImageDataCube(ImageDescriptor* descriptor, VkFormat& format, glm::vec<3
 		TODO_ERROR();
 	}
 
-	const auto abs = glm::abs(coordinates);
-	uint32_t layer;
-	float sc;
-	float tc;
-	float rc;
-	if (abs.z >= abs.y && abs.z >= abs.x)
-	{
-		if (coordinates.z < 0)
-		{
-			layer = 5;
-			sc = -coordinates.x;
-		}
-		else
-		{
-			layer = 4;
-			sc = coordinates.x;
-		}
-		tc = -coordinates.y;
-		rc = coordinates.z;
-	}
-	else if (abs.y >= abs.x)
-	{
-		if (coordinates.y < 0)
-		{
-			layer = 3;
-			tc = -coordinates.z;
-		}
-		else
-		{
-			layer = 2;
-			tc = coordinates.z;
-		}
-		sc = coordinates.x;
-		rc = coordinates.y;
-	}
-	else
-	{
-		if (coordinates.x < 0)
-		{
-			layer = 1;
-			sc = coordinates.z;
-		}
-		else
-		{
-			layer = 0;
-			sc = -coordinates.z;
-		}
-		tc = -coordinates.y;
-		rc = coordinates.x;
-	}
+	const auto direction = glm::vec3{coordinates};
+	auto layer = SelectCubeFace(direction, faceAxes);
+	const auto sc = glm::dot(faceAxes[0], direction);
+	const auto tc = glm::dot(faceAxes[1], direction);
+	const auto rc = glm::dot(faceAxes[2], direction);
 
 	if constexpr (Array)
 	{
@@ -595,8 +576,10 @@ struct VectorPointer
 	}
 };
 
+// When derivatives are given the level of detail is computed from them, otherwise lod is used directly
 template<typename ReturnType, typename CoordinateType, bool Array = false, bool Cube = false>
-static void ImageSampleExplicitLod(DeviceState* deviceState, ReturnType* result, ImageDescriptor* descriptor, typename VectorPointer<CoordinateType>::type coordinates, float lod)
+static void ImageSample(DeviceState* deviceState, ReturnType* result, ImageDescriptor* descriptor, typename VectorPointer<CoordinateType>::type coordinates, float lod,
+                        const typename VectorPointer<CoordinateType>::vtype* dx, const typename VectorPointer<CoordinateType>::vtype* dy)
 {
 	constexpr auto finalLength = VectorPointer<CoordinateType>::length + (Array ? -1 : 0) + (Cube ? -1 : 0);
 		
@@ -606,9 +589,10 @@ static void ImageSampleExplicitLod(DeviceState* deviceState, ReturnType* result,
 	glm::vec<finalLength, float> realCoordinates;
 	uint32_t baseLevel;
 	uint32_t levels;
+	glm::vec3 faceAxes[3];
 	if constexpr (Cube)
 	{
-		GetImageDataCube<Array>(descriptor, format, VectorPointer<CoordinateType>::get(coordinates), data, range, baseLevel, levels, realCoordinates);
+		GetImageDataCube<Array>(descriptor, format, VectorPointer<CoordinateType>::get(coordinates), data, range, baseLevel, levels, realCoordinates, faceAxes);
 	}
 	else if constexpr (Array)
 	{
@@ -622,7 +606,47 @@ static void ImageSampleExplicitLod(DeviceState* deviceState, ReturnType* result,
 	}
 
 	const auto sampler = descriptor->ImageSampler;
-	const auto lambdaBase = lod;
+	auto lambdaBase = lod;
+	if (dx && dy)
+	{
+		// 15.6.7. Scale Factor Operation, Level-of-Detail Operation and Image Level(s) Selection
+		const auto size = glm::vec<finalLength, float>(range[0]);
+		glm::vec<finalLength, float> scaledX;
+		glm::vec<finalLength, float> scaledY;
+		if constexpr (Cube)
+		{
+			// 15.6.4. Cube Map Face Selection and Transformations, the derivatives of s and t on the selected face
+			const auto direction = glm::vec3{VectorPointer<CoordinateType>::get(coordinates)};
+			const auto sc = glm::dot(faceAxes[0], direction);
+			const auto tc = glm::dot(faceAxes[1], direction);
+			const auto rc = glm::dot(faceAxes[2], direction);
+			const auto project = [&](const glm::vec3& derivative)
+			{
+				const auto absRcDerivative = glm::dot(faceAxes[2], derivative) * (rc < 0 ? -1.0f : 1.0f);
+				return glm::vec2
+				{
+					0.5f * (std::abs(rc) * glm::dot(faceAxes[0], derivative) - sc * absRcDerivative) / (rc * rc),
+					0.5f * (std::abs(rc) * glm::dot(faceAxes[1], derivative) - tc * absRcDerivative) / (rc * rc)
+				};
+			};
+			scaledX = project(glm::vec3{*dx}) * size;
+			scaledY = project(glm::vec3{*dy}) * size;
+		}
+		else if constexpr (Array)
+		{
+			scaledX = ReduceDimension(*dx) * size;
+			scaledY = ReduceDimension(*dy) * size;
+		}
+		else
+		{
+			scaledX = *dx * size;
+			scaledY = *dy * size;
+		}
+
+		const auto rhoMax = std::max(glm::length(scaledX), glm::length(scaledY));
+		lambdaBase = rhoMax > 0 ? std::log2(rhoMax) : -std::numeric_limits<float>::infinity();
+	}
+	
 	constexpr float bias = 0;
 	const auto lambdaPrime = lambdaBase + std::clamp(sampler->getMipLodBias() + bias, -MAX_SAMPLER_LOD_BIAS, MAX_SAMPLER_LOD_BIAS);
 	const auto lambda = std::clamp(lambdaPrime, sampler->getMinLod(), sampler->getMaxLod());
@@ -654,9 +678,16 @@ static void ImageSampleExplicitLod(DeviceState* deviceState, ReturnType* result,
 }
 
 template<typename ReturnType, typename CoordinateType, bool Array = false, bool Cube = false>
-static void ImageSampleImplicitLod(DeviceState* deviceState, ReturnType* result, ImageDescriptor* descriptor, typename VectorPointer<CoordinateType>::type coordinates)
+static void ImageSampleExplicitLod(DeviceState* deviceState, ReturnType* result, ImageDescriptor* descriptor, typename VectorPointer<CoordinateType>::type coordinates, float lod)
+{
+	ImageSample<ReturnType, CoordinateType, Array, Cube>(deviceState, result, descriptor, coordinates, lod, nullptr, nullptr);
+}
+
+template<typename ReturnType, typename CoordinateType, bool Array = false, bool Cube = false>
+static void ImageSampleImplicitLod(DeviceState* deviceState, ReturnType* result, ImageDescriptor* descriptor, typename VectorPointer<CoordinateType>::type coordinates,
+                                   typename VectorPointer<CoordinateType>::type dx, typename VectorPointer<CoordinateType>::type dy)
 {
-	// TODO: Lod
+	// TODO: Anisotropy
 	// 	const auto sampler = descriptor->Sampler;
 	// #if defined(SAMPLER_ANISOTROPY)
 	// 	auto lambdaBase = 1.0f;
@@ -665,10 +696,10 @@ static void ImageSampleImplicitLod(DeviceState* deviceState, ReturnType* result,
 	// 		const auto eta = std::min(pMax / pMin, sampler->getMaxAnisotropy());
 	// 		lambdaBase = std::log2(pMax / eta);
 	// 	}
-	// #else
-	// 	constexpr auto lambdaBase = 0.0f;
 	// #endif
-	return ImageSampleExplicitLod<ReturnType, CoordinateType, Array, Cube>(deviceState, result, descriptor, coordinates, 0);
+	const auto derivativeX = VectorPointer<CoordinateType>::get(dx);
+	const auto derivativeY = VectorPointer<CoordinateType>::get(dy);
+	ImageSample<ReturnType, CoordinateType, Array, Cube>(deviceState, result, descriptor, coordinates, 0, &derivativeX, &derivativeY);
 }
 
 template<typename ReturnType, typename CoordinateType, bool Array = false, bool Cube = false>
@@ -742,6 +773,40 @@ static void ImageRead(DeviceState* deviceState, ReturnType* result, ImageDescrip
 	return ImageFetch<ReturnType, CoordinateType, Array, Cube>(deviceState, result, descriptor, coordinates);
 }
 
+// Input attachments are only read from the first level and layer of the view, so none of the per level setup of a general read is needed
+template<typename ReturnType>
+static void SubpassRead(DeviceState* deviceState, ReturnType* result, ImageDescriptor* descriptor, typename VectorPointer<glm::ivec2>::type coordinates)
+{
+	const auto imageView = descriptor->Data.Image;
+	const auto image = imageView->getImage();
+	if (image->getSamples() != VK_SAMPLE_COUNT_1_BIT)
+	{
+		TODO_ERROR();
+	}
+
+	const auto& range = imageView->getSubresourceRange();
+	const auto& level = image->getImageSize().Level[range.baseMipLevel];
+	const auto offset = GetImagePixelOffset(image->getImageSize(), 0, 0, 0, range.baseMipLevel, range.baseArrayLayer);
+	*result = GetPixel<ReturnType>(deviceState,
+	                               imageView->getFormat(),
+	                               image->getData(offset, level.LevelSize),
+	                               glm::uvec2{level.Width, level.Height},
+	                               VectorPointer<glm::ivec2>::get(coordinates),
+	                               ReturnType{});
+
+	if ((imageView->getComponents().r != VK_COMPONENT_SWIZZLE_IDENTITY && imageView->getComponents().r != VK_COMPONENT_SWIZZLE_R) ||
+		(imageView->getComponents().g != VK_COMPONENT_SWIZZLE_IDENTITY && imageView->getComponents().g != VK_COMPONENT_SWIZZLE_G) ||
+		(imageView->getComponents().b != VK_COMPONENT_SWIZZLE_IDENTITY && imageView->getComponents().b != VK_COMPONENT_SWIZZLE_B) ||
+		(imageView->getComponents().a != VK_COMPONENT_SWIZZLE_IDENTITY && imageView->getComponents().a != VK_COMPONENT_SWIZZLE_A))
+	{
+		const auto oldResult = *result;
+		result->r = Swizzle(oldResult, imageView->getComponents().r, 0);
+		result->g = Swizzle(oldResult, imageView->getComponents().g, 1);
+		result->b = Swizzle(oldResult, imageView->getComponents().b, 2);
+		result->a = Swizzle(oldResult, imageView->getComponents().a, 3);
+	}
+}
+
 template<typename CoordinateType, typename TexelType, bool Array = false, bool Cube = false>
 static void ImageWrite(DeviceState* deviceState, ImageDescriptor* descriptor, typename VectorPointer<CoordinateType>::type coordinates, typename VectorPointer<TexelType>::type texel)
 {
@@ -1319,45 +1384,45 @@ void AddGlslFunctions(DeviceState* deviceState)
 
 	// Implicit sampling
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,buffer].F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, float>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,buffer].F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, float>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,buffer].F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, float>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,buffer].F32.Dx.F32.Dy.F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, float>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,buffer].F32.Dx.F32.Dy.F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, float>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,buffer].F32.Dx.F32.Dy.F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, float>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,1D].F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, float>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,1D].F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, float>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,1D].F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, float>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,1D].F32.Dx.F32.Dy.F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, float>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,1D].F32.Dx.F32.Dy.F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, float>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,1D].F32.Dx.F32.Dy.F32", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, float>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,1D,array].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec2, true>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,1D,array].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec2, true>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,1D,array].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec2, true>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,1D,array].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec2, true>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,1D,array].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec2, true>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,1D,array].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec2, true>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,2D].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec2>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,2D].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec2>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,2D].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec2>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,2D].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec2>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,2D].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec2>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,2D].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec2>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,subpass].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec2>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,subpass].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec2>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,subpass].F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec2>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,subpass].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec2>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,subpass].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec2>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,subpass].F32[2].Dx.F32[2].Dy.F32[2]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec2>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,2D,array].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec3, true>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,2D,array].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec3, true>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,2D,array].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec3, true>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,2D,array].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec3, true>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,2D,array].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec3, true>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,2D,array].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec3, true>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,3D].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec3>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,3D].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec3>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,3D].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec3>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,3D].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec3>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,3D].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec3>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,3D].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec3>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,3D,array].F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec4, true>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,3D,array].F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec4, true>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,3D,array].F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec4, true>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,3D,array].F32[4].Dx.F32[4].Dy.F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec4, true>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,3D,array].F32[4].Dx.F32[4].Dy.F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec4, true>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,3D,array].F32[4].Dx.F32[4].Dy.F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec4, true>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,cube].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec3, false, true>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,cube].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec3, false, true>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,cube].F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec3, false, true>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,cube].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec3, false, true>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,cube].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec3, false, true>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,cube].F32[3].Dx.F32[3].Dy.F32[3]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec3, false, true>));
 
-	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,cube,array].F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec4, true, true>));
-	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,cube,array].F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec4, true, true>));
-	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,cube,array].F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec4, true, true>));
+	jit->AddFunction("@Image.Sample.Implicit.F32[4].SampledImage[F32,cube,array].F32[4].Dx.F32[4].Dy.F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::fvec4, glm::fvec4, true, true>));
+	jit->AddFunction("@Image.Sample.Implicit.I32[4].SampledImage[I32,cube,array].F32[4].Dx.F32[4].Dy.F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::ivec4, glm::fvec4, true, true>));
+	jit->AddFunction("@Image.Sample.Implicit.U32[4].SampledImage[U32,cube,array].F32[4].Dx.F32[4].Dy.F32[4]", reinterpret_cast<FunctionPointer>(ImageSampleImplicitLod<glm::uvec4, glm::fvec4, true, true>));
 
 	// Explicit sampling
 	
@@ -1445,9 +1510,9 @@ void AddGlslFunctions(DeviceState* deviceState)
 	jit->AddFunction("@Image.Read.I32[4].Image[I32,2D,array].I32[3]", reinterpret_cast<FunctionPointer>(ImageRead<glm::ivec4, glm::ivec3, true>));
 	jit->AddFunction("@Image.Read.U32[4].Image[U32,2D,array].I32[3]", reinterpret_cast<FunctionPointer>(ImageRead<glm::uvec4, glm::ivec3, true>));
 
-	jit->AddFunction("@Image.Read.F32[4].Image[F32,subpass].I32[2]", reinterpret_cast<FunctionPointer>(ImageRead<glm::fvec4, glm::ivec2>));
-	jit->AddFunction("@Image.Read.I32[4].Image[I32,subpass].I32[2]", reinterpret_cast<FunctionPointer>(ImageRead<glm::ivec4, glm::ivec2>));
-	jit->AddFunction("@Image.Read.U32[4].Image[U32,subpass].I32[2]", reinterpret_cast<FunctionPointer>(ImageRead<glm::uvec4, glm::ivec2>));
+	jit->AddFunction("@Image.Read.F32[4].Image[F32,subpass].I32[2]", reinterpret_cast<FunctionPointer>(SubpassRead<glm::fvec4>));
+	jit->AddFunction("@Image.Read.I32[4].Image[I32,subpass].I32[2]", reinterpret_cast<FunctionPointer>(SubpassRead<glm::ivec4>));
+	jit->AddFunction("@Image.Read.U32[4].Image[U32,subpass].I32[2]", reinterpret_cast<FunctionPointer>(SubpassRead<glm::uvec4>));
 
 	jit->AddFunction("@Image.Read.F32[4].Image[F32,cube].I32[3]", reinterpret_cast<FunctionPointer>(ImageRead<glm::fvec4, glm::ivec3, false, true>));
 	jit->AddFunction("@Image.Read.I32[4].Image[I32,cube].I32[3]", reinterpret_cast<FunctionPointer>(ImageRead<glm::ivec4, glm::ivec3, false, true>));
@@ -2,6 +2,7 @@
 
 #include "Device.h"
 #include "Formats.h"
+#include "ImageSampler.h"
 #include "Swapchain.h"
 #include "Util.h"
 
@@ -159,7 +160,12 @@ VkResult Image::Create(const VkImageCreateInfo* pCreateInfo, const VkAllocationC
 
 VkResult Device::CreateImage(const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkImage* pImage)
 {
-	return Image::Create(pCreateInfo, pAllocator, pImage);
+	const auto result = Image::Create(pCreateInfo, pAllocator, pImage);
+	if (result == VK_SUCCESS)
+	{
+		PrecompileImageFunctions(state.get(), pCreateInfo->format);
+	}
+	return result;
 }
 
 void Device::DestroyImage(VkImage image, const VkAllocationCallbacks* pAllocator)
@@ -3,6 +3,20 @@
 
 #include <Formats.h>
 
+#include <vector>
+
+// A clear recorded for one subresource, but not yet written to memory
+struct PendingClear
+{
+	uint8_t texel[MAX_TEXEL_SIZE];
+	uint32_t texelSize;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	// Non-zero for every RASTERISER_TILE_SIZE tile that already holds the texel
+	std::vector<uint8_t> materialisedTiles;
+	bool isPending;
+};
+
 class Image final
 {
 public:
@@ -50,6 +64,29 @@ public:
 		return getData(offset, size).data();
 	}
 
+	[[nodiscard]] PendingClear* getPendingClear(uint32_t mipLevel, uint32_t layer)
+	{
+		if (pendingClears.empty())
+		{
+			return nullptr;
+		}
+
+		auto& pendingClear = pendingClears[layer * mipLevels + mipLevel];
+		return pendingClear.isPending ? &pendingClear : nullptr;
+	}
+
+	PendingClear& setPendingClear(uint32_t mipLevel, uint32_t layer)
+	{
+		if (pendingClears.empty())
+		{
+			pendingClears.resize(mipLevels * arrayLayers);
+		}
+
+		auto& pendingClear = pendingClears[layer * mipLevels + mipLevel];
+		pendingClear.isPending = true;
+		return pendingClear;
+	}
+
 private:
 	VkImageCreateFlags flags{};
 	VkImageType imageType{};
@@ -64,4 +101,7 @@ private:
 
 	gsl::span<uint8_t> data{};
 	ImageSize imageSize{};
+
+	// Indexed by layer * mipLevels + mipLevel, empty until the image is first cleared
+	std::vector<PendingClear> pendingClears{};
 };
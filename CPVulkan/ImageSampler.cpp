@@ -6,6 +6,7 @@
 #include "Sampler.h"
 
 #include <Compilers.h>
+#include <Jit.h>
 
 #include <glm/glm.hpp>
 
@@ -61,7 +62,7 @@ float GetDepthPixel(DeviceState* deviceState, VkFormat format, const Image* imag
 	auto functions = deviceState->getImageFunctions(format);
 	if (!functions->GetPixelDepth)
 	{
-		functions->GetPixelDepth = reinterpret_cast<decltype(functions->GetPixelDepth)>(CompileGetPixelDepth(deviceState->jit, &information));
+		functions->GetPixelDepth = reinterpret_cast<decltype(functions->GetPixelDepth)::Type>(CompileGetPixelDepth(deviceState->jit, &information));
 	}
 
 	return functions->GetPixelDepth(image->getDataPtr(offset, information.TotalSize));
@@ -74,7 +75,7 @@ uint8_t GetStencilPixel(DeviceState* deviceState, VkFormat format, const Image*
 	auto functions = deviceState->getImageFunctions(format);
 	if (!functions->GetPixelStencil)
 	{
-		functions->GetPixelStencil = reinterpret_cast<decltype(functions->GetPixelStencil)>(CompileGetPixelStencil(deviceState->jit, &information));
+		functions->GetPixelStencil = reinterpret_cast<decltype(functions->GetPixelStencil)::Type>(CompileGetPixelStencil(deviceState->jit, &information));
 	}
 
 	return functions->GetPixelStencil(image->getDataPtr(offset, information.TotalSize));
@@ -94,7 +95,7 @@ glm::fvec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 	
 	if (!functions->GetPixelF32)
 	{
-		functions->GetPixelF32 = reinterpret_cast<decltype(functions->GetPixelF32)>(CompileGetPixelF32(deviceState->jit, &information));
+		functions->GetPixelF32 = reinterpret_cast<decltype(functions->GetPixelF32)::Type>(CompileGetPixelF32(deviceState->jit, &information));
 	}
 
 	float values[4]{};
@@ -122,7 +123,7 @@ glm::fvec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 		if (!functions->GetPixelF32C)
 		{
-			functions->GetPixelF32C = reinterpret_cast<decltype(functions->GetPixelF32C)>(CompileGetPixelF32(deviceState->jit, &information));
+			functions->GetPixelF32C = reinterpret_cast<decltype(functions->GetPixelF32C)::Type>(CompileGetPixelF32(deviceState->jit, &information));
 		}
 
 		float values[4]{};
@@ -135,7 +136,7 @@ glm::fvec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 		if (!functions->GetPixelF32)
 		{
-			functions->GetPixelF32 = reinterpret_cast<decltype(functions->GetPixelF32)>(CompileGetPixelF32(deviceState->jit, &information));
+			functions->GetPixelF32 = reinterpret_cast<decltype(functions->GetPixelF32)::Type>(CompileGetPixelF32(deviceState->jit, &information));
 		}
 
 		float values[4]{};
@@ -158,7 +159,7 @@ glm::fvec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 	
 	if (!functions->GetPixelF32)
 	{
-		functions->GetPixelF32 = reinterpret_cast<decltype(functions->GetPixelF32)>(CompileGetPixelF32(deviceState->jit, &information));
+		functions->GetPixelF32 = reinterpret_cast<decltype(functions->GetPixelF32)::Type>(CompileGetPixelF32(deviceState->jit, &information));
 	}
 
 	float values[4]{};
@@ -180,7 +181,7 @@ glm::ivec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 	if (!functions->GetPixelI32)
 	{
-		functions->GetPixelI32 = reinterpret_cast<decltype(functions->GetPixelI32)>(CompileGetPixelI32(deviceState->jit, &information));
+		functions->GetPixelI32 = reinterpret_cast<decltype(functions->GetPixelI32)::Type>(CompileGetPixelI32(deviceState->jit, &information));
 	}
 
 	uint32_t values[4]{};
@@ -202,7 +203,7 @@ glm::ivec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 	if (!functions->GetPixelI32)
 	{
-		functions->GetPixelI32 = reinterpret_cast<decltype(functions->GetPixelI32)>(CompileGetPixelI32(deviceState->jit, &information));
+		functions->GetPixelI32 = reinterpret_cast<decltype(functions->GetPixelI32)::Type>(CompileGetPixelI32(deviceState->jit, &information));
 	}
 
 	uint32_t values[4]{};
@@ -224,7 +225,7 @@ glm::ivec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 	if (!functions->GetPixelI32)
 	{
-		functions->GetPixelI32 = reinterpret_cast<decltype(functions->GetPixelI32)>(CompileGetPixelI32(deviceState->jit, &information));
+		functions->GetPixelI32 = reinterpret_cast<decltype(functions->GetPixelI32)::Type>(CompileGetPixelI32(deviceState->jit, &information));
 	}
 
 	uint32_t values[4]{};
@@ -246,7 +247,7 @@ glm::uvec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 	if (!functions->GetPixelU32)
 	{
-		functions->GetPixelU32 = reinterpret_cast<decltype(functions->GetPixelU32)>(CompileGetPixelU32(deviceState->jit, &information));
+		functions->GetPixelU32 = reinterpret_cast<decltype(functions->GetPixelU32)::Type>(CompileGetPixelU32(deviceState->jit, &information));
 	}
 
 	uint32_t values[4]{};
@@ -268,7 +269,7 @@ glm::uvec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 	if (!functions->GetPixelU32)
 	{
-		functions->GetPixelU32 = reinterpret_cast<decltype(functions->GetPixelU32)>(CompileGetPixelU32(deviceState->jit, &information));
+		functions->GetPixelU32 = reinterpret_cast<decltype(functions->GetPixelU32)::Type>(CompileGetPixelU32(deviceState->jit, &information));
 	}
 
 	uint32_t values[4]{};
@@ -290,7 +291,7 @@ glm::uvec4 GetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t
 
 	if (!functions->GetPixelU32)
 	{
-		functions->GetPixelU32 = reinterpret_cast<decltype(functions->GetPixelU32)>(CompileGetPixelU32(deviceState->jit, &information));
+		functions->GetPixelU32 = reinterpret_cast<decltype(functions->GetPixelU32)::Type>(CompileGetPixelU32(deviceState->jit, &information));
 	}
 
 	uint32_t values[4]{};
@@ -313,7 +314,7 @@ void SetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t> data
 
 	if (!functions->SetPixelF32)
 	{
-		functions->SetPixelF32 = reinterpret_cast<decltype(functions->SetPixelF32)>(CompileSetPixelF32(deviceState->jit, &information));
+		functions->SetPixelF32 = reinterpret_cast<decltype(functions->SetPixelF32)::Type>(CompileSetPixelF32(deviceState->jit, &information));
 	}
 
 	functions->SetPixelF32(data.subspan(offset, information.TotalSize).data(), &texel.r);
@@ -333,7 +334,7 @@ void SetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t> data
 
 	if (!functions->SetPixelI32)
 	{
-		functions->SetPixelI32 = reinterpret_cast<decltype(functions->SetPixelI32)>(CompileSetPixelI32(deviceState->jit, &information));
+		functions->SetPixelI32 = reinterpret_cast<decltype(functions->SetPixelI32)::Type>(CompileSetPixelI32(deviceState->jit, &information));
 	}
 
 	functions->SetPixelI32(data.subspan(offset, information.TotalSize).data(), &texel.r);
@@ -353,7 +354,7 @@ void SetPixel(DeviceState* deviceState, VkFormat format, gsl::span<uint8_t> data
 
 	if (!functions->SetPixelU32)
 	{
-		functions->SetPixelU32 = reinterpret_cast<decltype(functions->SetPixelU32)>(CompileSetPixelU32(deviceState->jit, &information));
+		functions->SetPixelU32 = reinterpret_cast<decltype(functions->SetPixelU32)::Type>(CompileSetPixelU32(deviceState->jit, &information));
 	}
 
 	functions->SetPixelU32(data.subspan(offset, information.TotalSize).data(), &texel.r);
@@ -727,7 +728,7 @@ void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i
 	auto functions = deviceState->getImageFunctions(format);
 	if (!functions->SetPixelDepthStencil)
 	{
-		functions->SetPixelDepthStencil = reinterpret_cast<decltype(functions->SetPixelDepthStencil)>(CompileSetPixelDepthStencil(deviceState->jit, &information));
+		functions->SetPixelDepthStencil = reinterpret_cast<decltype(functions->SetPixelDepthStencil)::Type>(CompileSetPixelDepthStencil(deviceState->jit, &information));
 	}
 
 	functions->SetPixelDepthStencil(image->getDataPtr(offset, information.TotalSize), value.depth, value.stencil);
@@ -767,7 +768,7 @@ void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i
 	auto functions = deviceState->getImageFunctions(format);
 	if (!functions->SetPixelF32)
 	{
-		functions->SetPixelF32 = reinterpret_cast<decltype(functions->SetPixelF32)>(CompileSetPixelF32(deviceState->jit, &information));
+		functions->SetPixelF32 = reinterpret_cast<decltype(functions->SetPixelF32)::Type>(CompileSetPixelF32(deviceState->jit, &information));
 	}
 
 	functions->SetPixelF32(image->getDataPtr(offset, information.TotalSize), values);
@@ -780,7 +781,7 @@ void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i
 	auto functions = deviceState->getImageFunctions(format);
 	if (!functions->SetPixelI32)
 	{
-		functions->SetPixelI32 = reinterpret_cast<decltype(functions->SetPixelI32)>(CompileSetPixelI32(deviceState->jit, &information));
+		functions->SetPixelI32 = reinterpret_cast<decltype(functions->SetPixelI32)::Type>(CompileSetPixelI32(deviceState->jit, &information));
 	}
 
 	functions->SetPixelI32(image->getDataPtr(offset, information.TotalSize), values);
@@ -793,8 +794,177 @@ void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i
 	auto functions = deviceState->getImageFunctions(format);
 	if (!functions->SetPixelU32)
 	{
-		functions->SetPixelU32 = reinterpret_cast<decltype(functions->SetPixelU32)>(CompileSetPixelU32(deviceState->jit, &information));
+		functions->SetPixelU32 = reinterpret_cast<decltype(functions->SetPixelU32)::Type>(CompileSetPixelU32(deviceState->jit, &information));
 	}
 
 	functions->SetPixelU32(image->getDataPtr(offset, information.TotalSize), values);
+}
+
+void PackTexel(DeviceState* deviceState, VkFormat format, VkClearDepthStencilValue value, uint8_t* texel)
+{
+	const auto& information = GetFormatInformation(format);
+	auto functions = deviceState->getImageFunctions(format);
+	if (!functions->SetPixelDepthStencil)
+	{
+		functions->SetPixelDepthStencil = reinterpret_cast<decltype(functions->SetPixelDepthStencil)::Type>(CompileSetPixelDepthStencil(deviceState->jit, &information));
+	}
+
+	functions->SetPixelDepthStencil(texel, value.depth, value.stencil);
+}
+
+void PackTexel(DeviceState* deviceState, VkFormat format, VkClearColorValue value, uint8_t* texel)
+{
+	const auto& information = GetFormatInformation(format);
+	auto functions = deviceState->getImageFunctions(format);
+	switch (information.Base)
+	{
+	case BaseType::UNorm:
+	case BaseType::SNorm:
+	case BaseType::UScaled:
+	case BaseType::SScaled:
+	case BaseType::UFloat:
+	case BaseType::SFloat:
+	case BaseType::SRGB:
+		if (!functions->SetPixelF32)
+		{
+			functions->SetPixelF32 = reinterpret_cast<decltype(functions->SetPixelF32)::Type>(CompileSetPixelF32(deviceState->jit, &information));
+		}
+		functions->SetPixelF32(texel, value.float32);
+		break;
+
+	case BaseType::UInt:
+		if (!functions->SetPixelU32)
+		{
+			functions->SetPixelU32 = reinterpret_cast<decltype(functions->SetPixelU32)::Type>(CompileSetPixelU32(deviceState->jit, &information));
+		}
+		functions->SetPixelU32(texel, value.uint32);
+		break;
+
+	case BaseType::SInt:
+		if (!functions->SetPixelI32)
+		{
+			functions->SetPixelI32 = reinterpret_cast<decltype(functions->SetPixelI32)::Type>(CompileSetPixelI32(deviceState->jit, &information));
+		}
+		functions->SetPixelI32(texel, value.int32);
+		break;
+
+	default:
+		FATAL_ERROR();
+	}
+}
+
+// Only the accessors the image compiler fully supports, anything else is still compiled on first use
+static bool CanPrecompile(const FormatInformation& information)
+{
+	switch (information.Type)
+	{
+	case FormatType::Normal:
+		switch (information.Base)
+		{
+		case BaseType::UNorm:
+		case BaseType::SNorm:
+		case BaseType::UInt:
+		case BaseType::SInt:
+		case BaseType::SRGB:
+			return information.ElementSize == 1 || information.ElementSize == 2 || information.ElementSize == 4;
+
+		case BaseType::SFloat:
+			return information.ElementSize == 2 || information.ElementSize == 4;
+
+		default:
+			return false;
+		}
+
+	case FormatType::DepthStencil:
+		switch (information.Format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		case VK_FORMAT_S8_UINT:
+			return true;
+
+		default:
+			return false;
+		}
+
+	default:
+		return false;
+	}
+}
+
+void PrecompileImageFunctions(DeviceState* deviceState, VkFormat format)
+{
+	const auto& information = GetFormatInformation(format);
+	if (!CanPrecompile(information))
+	{
+		return;
+	}
+
+	const auto functions = deviceState->getImageFunctions(format);
+	const auto jit = deviceState->jit;
+	jit->QueueOnCompileThread([functions, jit, &information]()
+	{
+		// Compiles run in order on this thread, so whatever is still missing here has not been compiled by anything else
+		if (information.Type == FormatType::DepthStencil)
+		{
+			if (information.DepthStencil.DepthOffset != INVALID_OFFSET && !functions->GetPixelDepth)
+			{
+				functions->GetPixelDepth = reinterpret_cast<decltype(functions->GetPixelDepth)::Type>(CompileGetPixelDepth(jit, &information));
+			}
+
+			if (information.DepthStencil.StencilOffset != INVALID_OFFSET && !functions->GetPixelStencil)
+			{
+				functions->GetPixelStencil = reinterpret_cast<decltype(functions->GetPixelStencil)::Type>(CompileGetPixelStencil(jit, &information));
+			}
+
+			if (!functions->SetPixelDepthStencil)
+			{
+				functions->SetPixelDepthStencil = reinterpret_cast<decltype(functions->SetPixelDepthStencil)::Type>(CompileSetPixelDepthStencil(jit, &information));
+			}
+			return;
+		}
+
+		switch (information.Base)
+		{
+		case BaseType::UInt:
+			if (!functions->GetPixelU32)
+			{
+				functions->GetPixelU32 = reinterpret_cast<decltype(functions->GetPixelU32)::Type>(CompileGetPixelU32(jit, &information));
+			}
+
+			if (!functions->SetPixelU32)
+			{
+				functions->SetPixelU32 = reinterpret_cast<decltype(functions->SetPixelU32)::Type>(CompileSetPixelU32(jit, &information));
+			}
+			break;
+
+		case BaseType::SInt:
+			if (!functions->GetPixelI32)
+			{
+				functions->GetPixelI32 = reinterpret_cast<decltype(functions->GetPixelI32)::Type>(CompileGetPixelI32(jit, &information));
+			}
+
+			if (!functions->SetPixelI32)
+			{
+				functions->SetPixelI32 = reinterpret_cast<decltype(functions->SetPixelI32)::Type>(CompileSetPixelI32(jit, &information));
+			}
+			break;
+
+		default:
+			if (!functions->GetPixelF32)
+			{
+				functions->GetPixelF32 = reinterpret_cast<decltype(functions->GetPixelF32)::Type>(CompileGetPixelF32(jit, &information));
+			}
+
+			if (!functions->SetPixelF32)
+			{
+				functions->SetPixelF32 = reinterpret_cast<decltype(functions->SetPixelF32)::Type>(CompileSetPixelF32(jit, &information));
+			}
+			break;
+		}
+	});
 }
\ No newline at end of file
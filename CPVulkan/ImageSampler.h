@@ -25,4 +25,11 @@ void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i
 void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i, int32_t j, int32_t k, uint32_t mipLevel, uint32_t layer, VkClearColorValue value);
 void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i, int32_t j, int32_t k, uint32_t mipLevel, uint32_t layer, const float values[4]);
 void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i, int32_t j, int32_t k, uint32_t mipLevel, uint32_t layer, const int32_t values[4]);
-void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i, int32_t j, int32_t k, uint32_t mipLevel, uint32_t layer, const uint32_t values[4]);
\ No newline at end of file
+void SetPixel(DeviceState* deviceState, VkFormat format, Image* image, int32_t i, int32_t j, int32_t k, uint32_t mipLevel, uint32_t layer, const uint32_t values[4]);
+
+// Writes value as the bytes of a single texel of format, texel must hold at least its total size
+void PackTexel(DeviceState* deviceState, VkFormat format, VkClearDepthStencilValue value, uint8_t* texel);
+void PackTexel(DeviceState* deviceState, VkFormat format, VkClearColorValue value, uint8_t* texel);
+
+// Queues every accessor the format supports to be compiled in the background, so drawing rarely has to wait on the JIT
+void PrecompileImageFunctions(DeviceState* deviceState, VkFormat format);
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "ImageView.h"
 
 #include "Device.h"
+#include "ImageSampler.h"
 
 #include <cassert>
 
@@ -52,7 +53,12 @@ VkResult ImageView::Create(const VkImageViewCreateInfo* pCreateInfo, const VkAll
 
 VkResult Device::CreateImageView(const VkImageViewCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkImageView* pView)
 {
-	return ImageView::Create(pCreateInfo, pAllocator, pView);
+	const auto result = ImageView::Create(pCreateInfo, pAllocator, pView);
+	if (result == VK_SUCCESS)
+	{
+		PrecompileImageFunctions(state.get(), pCreateInfo->format);
+	}
+	return result;
 }
 
 void Device::DestroyImageView(VkImageView imageView, const VkAllocationCallbacks* pAllocator)
@@ -13,8 +13,10 @@
 #include <CompiledModule.h>
 #include <Compilers.h>
 #include <Jit.h>
+#include <PipelineData.h>
 #include <SPIRVCompiler.h>
 #include <SPIRVFunction.h>
+#include <SPIRVInstruction.h>
 #include <SPIRVModule.h>
 
 #include <cassert>
@@ -532,11 +534,409 @@ private:
 	std::vector<char> data{};
 };
 
+static VkFormat GetVariableFormat(SPIRV::SPIRVType* type)
+{
+	if (type->isTypeMatrix())
+	{
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	if (type->isTypeVector())
+	{
+		if (type->getVectorComponentType()->isTypeFloat(32))
+		{
+			switch (type->getVectorComponentCount())
+			{
+			case 2:
+				return VK_FORMAT_R32G32_SFLOAT;
+			case 3:
+				return VK_FORMAT_R32G32B32_SFLOAT;
+			case 4:
+				return VK_FORMAT_R32G32B32A32_SFLOAT;
+			}
+		}
+
+		if (type->getVectorComponentType()->isTypeFloat(64))
+		{
+			switch (type->getVectorComponentCount())
+			{
+			case 2:
+				return VK_FORMAT_R64G64_SFLOAT;
+			case 3:
+				return VK_FORMAT_R64G64B64_SFLOAT;
+			case 4:
+				return VK_FORMAT_R64G64B64A64_SFLOAT;
+			}
+		}
+
+		if (type->getVectorComponentType()->isTypeInt(32) && static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
+		{
+			switch (type->getVectorComponentCount())
+			{
+			case 2:
+				return VK_FORMAT_R32G32_SINT;
+			case 3:
+				return VK_FORMAT_R32G32B32_SINT;
+			case 4:
+				return VK_FORMAT_R32G32B32A32_SINT;
+			}
+		}
+
+		if (type->getVectorComponentType()->isTypeInt(64) && static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
+		{
+			switch (type->getVectorComponentCount())
+			{
+			case 2:
+				return VK_FORMAT_R64G64_SINT;
+			case 3:
+				return VK_FORMAT_R64G64B64_SINT;
+			case 4:
+				return VK_FORMAT_R64G64B64A64_SINT;
+			}
+		}
+
+		if (type->getVectorComponentType()->isTypeInt(32) && !static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
+		{
+			switch (type->getVectorComponentCount())
+			{
+			case 2:
+				return VK_FORMAT_R32G32_UINT;
+			case 3:
+				return VK_FORMAT_R32G32B32_UINT;
+			case 4:
+				return VK_FORMAT_R32G32B32A32_UINT;
+			}
+		}
+
+		if (type->getVectorComponentType()->isTypeInt(64) && !static_cast<SPIRV::SPIRVTypeInt*>(type->getVectorComponentType())->isSigned())
+		{
+			switch (type->getVectorComponentCount())
+			{
+			case 2:
+				return VK_FORMAT_R64G64_UINT;
+			case 3:
+				return VK_FORMAT_R64G64B64_UINT;
+			case 4:
+				return VK_FORMAT_R64G64B64A64_UINT;
+			}
+		}
+	}
+
+	if (type->isTypeFloat(16))
+	{
+		return VK_FORMAT_R16_SFLOAT;
+	}
+
+	if (type->isTypeFloat(32))
+	{
+		return VK_FORMAT_R32_SFLOAT;
+	}
+
+	if (type->isTypeFloat(64))
+	{
+		return VK_FORMAT_R64_SFLOAT;
+	}
+
+	if (type->isTypeInt(8) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R8_SINT;
+	}
+
+	if (type->isTypeInt(16) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R16_SINT;
+	}
+
+	if (type->isTypeInt(32) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R32_SINT;
+	}
+
+	if (type->isTypeInt(64) && static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R64_SINT;
+	}
+
+	if (type->isTypeInt(8) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R8_UINT;
+	}
+
+	if (type->isTypeInt(16) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R16_UINT;
+	}
+
+	if (type->isTypeInt(32) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R32_UINT;
+	}
+
+	if (type->isTypeInt(64) && !static_cast<SPIRV::SPIRVTypeInt*>(type)->isSigned())
+	{
+		return VK_FORMAT_R64_UINT;
+	}
+
+	FATAL_ERROR();
+}
+
+static uint32_t GetVariableSize(SPIRV::SPIRVType* type)
+{
+	if (type->isTypeArray())
+	{
+		const auto size = GetVariableSize(type->getArrayElementType());
+		if (type->hasDecorate(DecorationArrayStride))
+		{
+			const auto stride = *type->getDecorate(DecorationArrayStride).begin();
+			if (stride != size)
+			{
+				TODO_ERROR();
+			}
+		}
+
+		return size * type->getArrayLength();
+	}
+
+	if (type->isTypeStruct())
+	{
+		auto size = 0u;
+		for (auto i = 0u; i < type->getStructMemberCount(); i++)
+		{
+			const auto decorate = type->getMemberDecorate(i, DecorationOffset);
+			if (decorate && decorate->getLiteral(0) != size)
+			{
+				const auto offset = decorate->getLiteral(0);
+				if (offset < size)
+				{
+					TODO_ERROR();
+				}
+				else
+				{
+					size = offset;
+				}
+			}
+			size += GetVariableSize(type->getStructMemberType(i));
+		}
+		return size;
+	}
+
+	if (type->isTypeMatrix())
+	{
+		// TODO: Matrix stride & so on
+		return GetVariableSize(type->getScalarType()) * type->getMatrixColumnCount() * type->getMatrixColumnType()->getVectorComponentCount();
+	}
+
+	if (type->isTypeVector())
+	{
+		return GetVariableSize(type->getScalarType()) * type->getVectorComponentCount();
+	}
+
+	if (type->isTypeFloat() || type->isTypeInt())
+	{
+		return type->getBitWidth() / 8;
+	}
+
+	FATAL_ERROR();
+}
+
 CompiledShaderModule::~CompiledShaderModule()
 {
 	delete llvmModule;
 }
 
+std::unique_ptr<uint8_t[]> CompiledShaderModule::CreateContext(uint32_t count) const
+{
+	LoadContextTemplate();
+
+	auto context = std::make_unique<uint8_t[]>(contextSize * count);
+	for (auto i = 0u; i < count; i++)
+	{
+		memcpy(context.get() + contextSize * i, contextTemplate, contextSize);
+	}
+	return context;
+}
+
+uint64_t CompiledShaderModule::getContextSize() const
+{
+	LoadContextTemplate();
+	return contextSize;
+}
+
+void* CompiledShaderModule::getContextPointer(uint8_t* context, const std::string& name) const
+{
+	const auto pointer = getOptionalContextPointer(context, name);
+	if (!pointer)
+	{
+		FATAL_ERROR();
+	}
+	return pointer;
+}
+
+void* CompiledShaderModule::getOptionalContextPointer(uint8_t* context, const std::string& name) const
+{
+	// Each member is exported at its address within the template, which gives its offset into any context
+	const auto pointer = static_cast<uint8_t*>(llvmModule->getOptionalPointer(name));
+	if (!pointer)
+	{
+		return nullptr;
+	}
+	return context + (pointer - static_cast<uint8_t*>(llvmModule->getPointer("@context")));
+}
+
+void CompiledShaderModule::LoadBindingPlan()
+{
+	const auto contextBase = static_cast<uint8_t*>(llvmModule->getPointer("@context"));
+	const auto getContextOffset = [&](const SPIRV::SPIRVVariable* variable)
+	{
+		return static_cast<uint64_t>(static_cast<uint8_t*>(llvmModule->getPointer(MangleName(variable))) - contextBase);
+	};
+
+	// Inputs and outputs are packed after the builtins of each vertex in the vertex output storage
+	auto inputSize = static_cast<uint32_t>(sizeof(VertexBuiltinOutput));
+	auto outputSize = static_cast<uint32_t>(sizeof(VertexBuiltinOutput));
+	for (auto i = 0u; i < spirvModule->getNumVariables(); i++)
+	{
+		const auto variable = spirvModule->getVariable(i);
+		switch (variable->getStorageClass())
+		{
+		case StorageClassInput:
+			{
+				auto locations = variable->getDecorate(DecorationLocation);
+				if (locations.empty())
+				{
+					continue;
+				}
+
+				const auto location = *locations.begin();
+				const auto size = GetVariableSize(variable->getType()->getPointerElementType());
+				auto interpolationType = InterpolationType::Perspective;
+
+				if (variable->hasDecorate(DecorationNoPerspective))
+				{
+					interpolationType = InterpolationType::Linear;
+				}
+
+				if (variable->hasDecorate(DecorationFlat))
+				{
+					interpolationType = InterpolationType::Flat;
+				}
+
+				bindingPlan.inputs.push_back(ShaderVariableBinding
+					{
+						getContextOffset(variable),
+						location,
+						GetVariableFormat(variable->getType()->getPointerElementType()),
+						variable->getType()->getPointerElementType(),
+						interpolationType,
+						size,
+						inputSize
+					});
+				inputSize += size;
+				break;
+			}
+
+		case StorageClassUniform:
+		case StorageClassUniformConstant:
+		case StorageClassStorageBuffer:
+			{
+				auto bindingDecorate = variable->getDecorate(DecorationBinding);
+				if (bindingDecorate.size() != 1)
+				{
+					FATAL_ERROR();
+				}
+
+				auto setDecorate = variable->getDecorate(DecorationDescriptorSet);
+				if (setDecorate.size() != 1)
+				{
+					FATAL_ERROR();
+				}
+
+				bindingPlan.uniforms.push_back(ShaderUniformBinding
+					{
+						getContextOffset(variable),
+						*bindingDecorate.begin(),
+						*setDecorate.begin()
+					});
+				break;
+			}
+
+		case StorageClassOutput:
+			{
+				auto locations = variable->getDecorate(DecorationLocation);
+				if (locations.empty())
+				{
+					continue;
+				}
+
+				const auto location = *locations.begin();
+				const auto contextOffset = getContextOffset(variable);
+				if (variable->getType()->getPointerElementType()->isTypeArray())
+				{
+					const auto size = variable->getType()->getPointerElementType()->getArrayLength();
+					const auto type = variable->getType()->getPointerElementType()->getArrayElementType();
+					const auto variableSize = GetVariableSize(type);
+					for (auto j = 0U; j < size; j++)
+					{
+						bindingPlan.outputs.push_back(ShaderVariableBinding
+							{
+								contextOffset + j * variableSize,
+								location + j,
+								GetVariableFormat(type),
+								type,
+								InterpolationType::Linear,
+								variableSize,
+								outputSize
+							});
+						outputSize += variableSize;
+					}
+				}
+				else
+				{
+					const auto type = variable->getType()->getPointerElementType();
+					bindingPlan.outputs.push_back(ShaderVariableBinding
+						{
+							contextOffset,
+							location,
+							GetVariableFormat(type),
+							type,
+							InterpolationType::Linear,
+							GetVariableSize(type),
+							outputSize
+						});
+					outputSize += GetVariableSize(type);
+				}
+				break;
+			}
+
+		case StorageClassPushConstant:
+			assert(bindingPlan.pushConstantSize == 0);
+			bindingPlan.pushConstantOffset = getContextOffset(variable);
+			bindingPlan.pushConstantSize = GetVariableSize(variable->getType()->getPointerElementType());
+			break;
+
+		case StorageClassWorkgroup:
+		case StorageClassCrossWorkgroup:
+		case StorageClassPrivate:
+		case StorageClassGeneric:
+			break;
+
+		default:
+			FATAL_ERROR();
+		}
+	}
+
+	bindingPlan.outputStride = outputSize;
+}
+
+void CompiledShaderModule::LoadContextTemplate() const
+{
+	if (!contextTemplate)
+	{
+		contextTemplate = static_cast<uint8_t*>(llvmModule->getPointer("@context"));
+		contextSize = *static_cast<uint64_t*>(llvmModule->getPointer("@contextSize"));
+	}
+}
+
 void Pipeline::CompileBaseShaderModule(ShaderModule* shaderModule, const char* entryName, const VkSpecializationInfo* specializationInfo, spv::ExecutionModel executionModel, 
                                        bool& hitCache, CompiledModule*& llvmModule, SPIRV::SPIRVFunction*& entryPointFunction, 
                                        std::function<CompiledModule*(CPJit*, const SPIRV::SPIRVModule*, spv::ExecutionModel, const SPIRV::SPIRVFunction*, const VkSpecializationInfo*)> compileFunction = CompileSPIRVModule)
@@ -983,10 +1383,9 @@ std::unique_ptr<FragmentShaderModule> GraphicsPipeline::CompileFragmentShaderMod
 		result->originUpper = false;
 	}
 	
-	if (entryPointFunction->getExecutionMode(SPIRV::SPIRVExecutionModeKind::ExecutionModeEarlyFragmentTests))
-	{
-		TODO_ERROR();
-	}
+	// Either requested by the shader, or nothing in the shader can tell the difference
+	result->earlyFragmentTests = *static_cast<uint32_t*>(llvmModule->getPointer("@earlyFragmentTests")) != 0;
+	result->writesOnlyColour = *static_cast<uint32_t*>(llvmModule->getPointer("@writesOnlyColour")) != 0;
 	
 	if (entryPointFunction->getExecutionMode(SPIRV::SPIRVExecutionModeKind::ExecutionModeDepthReplacing))
 	{
@@ -1148,14 +1547,19 @@ std::unique_ptr<ComputeShaderModule> ComputePipeline::CompileComputeShaderModule
 {
 	CompiledModule* llvmModule{};
 	SPIRV::SPIRVFunction* entryPointFunction;
-	CompileBaseShaderModule(shaderModule, entryName, specializationInfo, ExecutionModelGLCompute, hitCache, llvmModule, entryPointFunction);
+	CompileBaseShaderModule(shaderModule, entryName, specializationInfo, ExecutionModelGLCompute, 
+	                        hitCache, llvmModule, entryPointFunction, 
+	                        [](CPJit* jit, const SPIRV::SPIRVModule* spirvModule, spv::ExecutionModel, const SPIRV::SPIRVFunction* entryPoint, const VkSpecializationInfo* specializationInfo)
+	                        {
+		                        return CompileComputePipeline(jit, spirvModule, entryPoint, specializationInfo);
+	                        });
 	
 	if (entryPointFunction->getExecutionMode(SPIRV::SPIRVExecutionModeKind::ExecutionModeXfb))
 	{
 		TODO_ERROR();
 	}
 
-	const auto entryPoint = llvmModule->getFunctionPointer(MangleName(entryPointFunction));
+	const auto entryPoint = llvmModule->getFunctionPointer("@main");
 	auto result = std::make_unique<ComputeShaderModule>(shaderModule->getModule(), llvmModule, entryPoint);
 	
 	const auto localSize = entryPointFunction->getExecutionMode(SPIRV::SPIRVExecutionModeKind::ExecutionModeLocalSize);
@@ -15,11 +15,13 @@ namespace SPIRV
 {
 	class SPIRVFunction;
 	class SPIRVModule;
+	class SPIRVType;
 }
 
 class CompiledModule;
 class CPJit;
 
+struct DeviceState;
 struct StageFeedback;
 
 using EntryPoint = void (*)();
@@ -34,6 +36,44 @@ struct Hash
 	};
 };
 
+enum class InterpolationType
+{
+	Perspective,
+	Linear,
+	Flat,
+};
+
+struct ShaderVariableBinding
+{
+	uint64_t contextOffset;
+	uint32_t location;
+	VkFormat format;
+	SPIRV::SPIRVType* type;
+	InterpolationType interpolation;
+	uint32_t size;
+	// Offset within a vertex of the vertex output storage
+	uint32_t offset;
+};
+
+struct ShaderUniformBinding
+{
+	uint64_t contextOffset;
+	uint32_t binding;
+	uint32_t set;
+};
+
+// Where every interface variable lives within a context, reflected once from the SPIR-V when the module is created
+struct ShaderBindingPlan
+{
+	std::vector<ShaderVariableBinding> inputs{};
+	std::vector<ShaderVariableBinding> outputs{};
+	std::vector<ShaderUniformBinding> uniforms{};
+	uint64_t pushConstantOffset{};
+	uint32_t pushConstantSize{};
+	// Size of a vertex in the vertex output storage, including the builtins
+	uint32_t outputStride{};
+};
+
 class CompiledShaderModule
 {
 public:
@@ -42,6 +82,7 @@ public:
 		llvmModule{llvmModule},
 		entryPoint{entryPoint}
 	{
+		LoadBindingPlan();
 	}
 
 	virtual ~CompiledShaderModule();
@@ -49,11 +90,25 @@ public:
 	[[nodiscard]] const SPIRV::SPIRVModule* getSPIRVModule() const { return spirvModule; }
 	[[nodiscard]] CompiledModule* getLLVMModule() const { return llvmModule; }
 	[[nodiscard]] EntryPoint getEntryPoint() const { return entryPoint; }
+	[[nodiscard]] const ShaderBindingPlan& getBindingPlan() const { return bindingPlan; }
+
+	// Shader variables and builtins live in a context passed to every call, so each thread shading concurrently needs its own
+	// Creates count contexts laid out contiguously, getContextSize() apart
+	[[nodiscard]] std::unique_ptr<uint8_t[]> CreateContext(uint32_t count = 1) const;
+	[[nodiscard]] uint64_t getContextSize() const;
+	[[nodiscard]] void* getContextPointer(uint8_t* context, const std::string& name) const;
+	[[nodiscard]] void* getOptionalContextPointer(uint8_t* context, const std::string& name) const;
 
 private:
 	const SPIRV::SPIRVModule* spirvModule;
 	CompiledModule* llvmModule;
 	EntryPoint entryPoint;
+	ShaderBindingPlan bindingPlan{};
+	mutable uint8_t* contextTemplate{};
+	mutable uint64_t contextSize{};
+
+	void LoadBindingPlan();
+	void LoadContextTemplate() const;
 };
 
 class VertexShaderModule final : public CompiledShaderModule
@@ -119,11 +174,15 @@ public:
 	~FragmentShaderModule() override = default;
 
 	[[nodiscard]] bool getOriginUpper() const { return originUpper; }
+	[[nodiscard]] bool getEarlyFragmentTests() const { return earlyFragmentTests; }
+	[[nodiscard]] bool getWritesOnlyColour() const { return writesOnlyColour; }
 	
 	friend class GraphicsPipeline;
 
 private:
 	bool originUpper{};
+	bool earlyFragmentTests{};
+	bool writesOnlyColour{};
 };
 
 class ComputeShaderModule final : public CompiledShaderModule
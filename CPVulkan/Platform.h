@@ -28,4 +28,11 @@ namespace Platform
 
 	void* AlignedMalloc(size_t size, size_t alignment);
 	void AlignedFree(void* ptr);
+
+	// The calling thread must be converted to a fiber before it can switch to any other fiber. Fiber functions must never return.
+	void* ConvertThreadToFiber();
+	void ConvertFiberToThread(void* fiber);
+	void* CreateFiber(size_t stackSize, void (*function)(void*), void* parameter);
+	void DeleteFiber(void* fiber);
+	void SwitchToFiber(void* fiber);
 }
@@ -3,9 +3,11 @@
 #include <sys/sysinfo.h>
 
 #include <time.h>
+#include <ucontext.h>
 #include <unistd.h>
 
 #include <cstdint>
+#include <memory>
 
 /*
  * WIN32 Events for POSIX
@@ -625,4 +627,73 @@ void* Platform::AlignedMalloc(size_t size, size_t alignment)
 void Platform::AlignedFree(void* ptr)
 {
 	free(ptr);
+}
+
+struct LinuxFiber
+{
+	ucontext_t context{};
+	std::unique_ptr<uint8_t[]> stack{};
+	void (*function)(void*){};
+	void* parameter{};
+};
+
+static thread_local LinuxFiber* currentFiber{};
+
+static void FiberStart(uint32_t low, uint32_t high)
+{
+	// makecontext can only pass int arguments, so the fiber pointer is split in two
+	const auto fiber = reinterpret_cast<LinuxFiber*>(static_cast<uintptr_t>(high) << 32 | low);
+	fiber->function(fiber->parameter);
+	FATAL_ERROR();
+}
+
+void* Platform::ConvertThreadToFiber()
+{
+	assert(!currentFiber);
+	currentFiber = new LinuxFiber{};
+	return currentFiber;
+}
+
+void Platform::ConvertFiberToThread(void* fiber)
+{
+	assert(currentFiber == fiber);
+	delete static_cast<LinuxFiber*>(fiber);
+	currentFiber = nullptr;
+}
+
+void* Platform::CreateFiber(size_t stackSize, void (*function)(void*), void* parameter)
+{
+	auto fiber = new LinuxFiber{};
+	fiber->stack = std::unique_ptr<uint8_t[]>(new uint8_t[stackSize]);
+	fiber->function = function;
+	fiber->parameter = parameter;
+
+	if (getcontext(&fiber->context) != 0)
+	{
+		FATAL_ERROR();
+	}
+
+	fiber->context.uc_stack.ss_sp = fiber->stack.get();
+	fiber->context.uc_stack.ss_size = stackSize;
+	fiber->context.uc_link = nullptr;
+
+	const auto pointer = reinterpret_cast<uintptr_t>(fiber);
+	makecontext(&fiber->context, reinterpret_cast<void(*)()>(FiberStart), 2, static_cast<uint32_t>(pointer), static_cast<uint32_t>(pointer >> 32));
+	return fiber;
+}
+
+void Platform::DeleteFiber(void* fiber)
+{
+	assert(currentFiber != fiber);
+	delete static_cast<LinuxFiber*>(fiber);
+}
+
+void Platform::SwitchToFiber(void* fiber)
+{
+	const auto previousFiber = currentFiber;
+	currentFiber = static_cast<LinuxFiber*>(fiber);
+	if (swapcontext(&previousFiber->context, &currentFiber->context) != 0)
+	{
+		FATAL_ERROR();
+	}
 }
\ No newline at end of file
@@ -173,4 +173,56 @@ void* Platform::AlignedMalloc(size_t size, size_t alignment)
 void Platform::AlignedFree(void* ptr)
 {
 	_aligned_free(ptr);
+}
+
+struct Win32FiberStart
+{
+	void (*function)(void*);
+	void* parameter;
+};
+
+static void WINAPI FiberStart(void* parameter)
+{
+	const auto start = *static_cast<Win32FiberStart*>(parameter);
+	delete static_cast<Win32FiberStart*>(parameter);
+	start.function(start.parameter);
+	FATAL_ERROR();
+}
+
+void* Platform::ConvertThreadToFiber()
+{
+	const auto fiber = ::ConvertThreadToFiber(nullptr);
+	if (!fiber)
+	{
+		FATAL_ERROR();
+	}
+	return fiber;
+}
+
+void Platform::ConvertFiberToThread(void*)
+{
+	if (!::ConvertFiberToThread())
+	{
+		FATAL_ERROR();
+	}
+}
+
+void* Platform::CreateFiber(size_t stackSize, void (*function)(void*), void* parameter)
+{
+	const auto fiber = ::CreateFiber(stackSize, FiberStart, new Win32FiberStart{function, parameter});
+	if (!fiber)
+	{
+		FATAL_ERROR();
+	}
+	return fiber;
+}
+
+void Platform::DeleteFiber(void* fiber)
+{
+	::DeleteFiber(fiber);
+}
+
+void Platform::SwitchToFiber(void* fiber)
+{
+	::SwitchToFiber(fiber);
 }
\ No newline at end of file
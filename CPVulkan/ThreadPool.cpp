@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+// The pool and worker index the current thread is running jobs for, used to spot nested dispatches
+static thread_local const ThreadPool* currentPool{};
+static thread_local uint32_t currentWorker{};
+
+ThreadPool::ThreadPool(uint32_t numberWorkers)
+{
+	for (auto i = 1u; i < std::max(numberWorkers, 1u); i++)
+	{
+		threads.emplace_back([this, i]()
+		{
+			WorkerUpdate(i);
+		});
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock{mutex};
+		shouldExit = true;
+		startEvent.notify_all();
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t worker)>& action)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// A dispatch from inside one of this pool's jobs would wait on itself, so it runs inline on the calling worker
+	const auto nested = currentPool == this;
+	if (threads.empty() || count == 1 || nested)
+	{
+		const auto worker = nested ? currentWorker : 0;
+		for (auto i = 0u; i < count; i++)
+		{
+			action(i, worker);
+		}
+		return;
+	}
+
+	std::unique_lock<std::mutex> dispatchLock{dispatchMutex};
+
+	{
+		std::unique_lock<std::mutex> lock{mutex};
+		assert(currentAction == nullptr);
+		currentAction = &action;
+		currentCount = count;
+		nextIndex = 0;
+		busyWorkers = static_cast<uint32_t>(threads.size());
+		generation++;
+		startEvent.notify_all();
+	}
+
+	RunJob(0);
+
+	{
+		std::unique_lock<std::mutex> lock{mutex};
+		while (busyWorkers > 0)
+		{
+			finishEvent.wait(lock);
+		}
+		currentAction = nullptr;
+	}
+}
+
+void ThreadPool::RunJob(uint32_t worker)
+{
+	const auto previousPool = currentPool;
+	const auto previousWorker = currentWorker;
+	currentPool = this;
+	currentWorker = worker;
+
+	while (true)
+	{
+		const auto index = nextIndex.fetch_add(1);
+		if (index >= currentCount)
+		{
+			break;
+		}
+
+		(*currentAction)(index, worker);
+	}
+
+	currentPool = previousPool;
+	currentWorker = previousWorker;
+}
+
+void ThreadPool::WorkerUpdate(uint32_t worker)
+{
+	auto lastGeneration = 0ull;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock{mutex};
+			while (generation == lastGeneration && !shouldExit)
+			{
+				startEvent.wait(lock);
+			}
+
+			if (shouldExit)
+			{
+				return;
+			}
+
+			lastGeneration = generation;
+		}
+
+		RunJob(worker);
+
+		{
+			std::unique_lock<std::mutex> lock{mutex};
+			busyWorkers--;
+			if (busyWorkers == 0)
+			{
+				finishEvent.notify_one();
+			}
+		}
+	}
+}
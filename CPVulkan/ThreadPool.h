@@ -0,0 +1,45 @@
+#pragma once
+#include "Base.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CP_DLL_EXPORT ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t numberWorkers = std::thread::hardware_concurrency());
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	~ThreadPool();
+
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool& operator=(ThreadPool&&) = delete;
+
+	// Calls action(index, worker) for every index in [0, count), blocking until all have finished. The calling thread always participates as worker 0.
+	// Called from inside one of this pool's jobs, the work runs inline with the caller's worker index.
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t worker)>& action);
+
+	[[nodiscard]] uint32_t getNumberWorkers() const { return static_cast<uint32_t>(threads.size()) + 1; }
+
+private:
+	std::vector<std::thread> threads{};
+
+	std::mutex dispatchMutex{};
+	std::mutex mutex{};
+	std::condition_variable startEvent{};
+	std::condition_variable finishEvent{};
+
+	const std::function<void(uint32_t, uint32_t)>* currentAction{};
+	uint32_t currentCount{};
+	std::atomic_uint32_t nextIndex{};
+	uint64_t generation{};
+	uint32_t busyWorkers{};
+	bool shouldExit{};
+
+	void RunJob(uint32_t worker);
+	void WorkerUpdate(uint32_t worker);
+};
@@ -0,0 +1,174 @@
+#include "Workgroup.h"
+
+#include "Base.h"
+#include "DeviceState.h"
+#include "Platform.h"
+
+#include <Jit.h>
+
+#include <memory>
+#include <vector>
+
+struct WorkgroupInvocation
+{
+	void* fiber{};
+	void* schedulerFiber{};
+	void (*entryPoint)(uint8_t*){};
+	uint8_t* context{};
+	bool finished{};
+};
+
+// The fiber a thread is converted into, shared by every scheduler on the thread as they all switch back to it
+class ThreadFiber
+{
+public:
+	ThreadFiber() = default;
+	ThreadFiber(const ThreadFiber&) = delete;
+	ThreadFiber(ThreadFiber&&) = delete;
+
+	~ThreadFiber()
+	{
+		if (fiber)
+		{
+			Platform::ConvertFiberToThread(fiber);
+		}
+	}
+
+	ThreadFiber& operator=(const ThreadFiber&) = delete;
+	ThreadFiber&& operator=(const ThreadFiber&&) = delete;
+
+	[[nodiscard]] void* getFiber()
+	{
+		if (!fiber)
+		{
+			fiber = Platform::ConvertThreadToFiber();
+		}
+		return fiber;
+	}
+
+private:
+	void* fiber{};
+};
+
+static thread_local ThreadFiber threadFiber{};
+
+// Runs the invocations of a workgroup as fibers on the current thread, so each can be suspended at a barrier until the rest catch up.
+class WorkgroupScheduler
+{
+public:
+	explicit WorkgroupScheduler(size_t stackSize) :
+		stackSize{stackSize}
+	{
+	}
+
+	WorkgroupScheduler(const WorkgroupScheduler&) = delete;
+	WorkgroupScheduler(WorkgroupScheduler&&) = delete;
+
+	~WorkgroupScheduler()
+	{
+		for (const auto& invocation : invocations)
+		{
+			Platform::DeleteFiber(invocation->fiber);
+		}
+	}
+
+	WorkgroupScheduler& operator=(const WorkgroupScheduler&) = delete;
+	WorkgroupScheduler&& operator=(const WorkgroupScheduler&&) = delete;
+
+	void Run(void (*entryPoint)(uint8_t*), uint8_t* contexts, uint32_t count, uint64_t stride)
+	{
+		schedulerFiber = threadFiber.getFiber();
+
+		// Fibers are kept between workgroups, as each returns to the start of its loop once finished
+		while (invocations.size() < count)
+		{
+			auto invocation = std::make_unique<WorkgroupInvocation>();
+			invocation->fiber = Platform::CreateFiber(stackSize, InvocationMain, invocation.get());
+			invocation->schedulerFiber = schedulerFiber;
+			invocations.push_back(std::move(invocation));
+		}
+
+		for (auto i = 0u; i < count; i++)
+		{
+			invocations[i]->entryPoint = entryPoint;
+			invocations[i]->context = contexts + stride * i;
+			invocations[i]->finished = false;
+		}
+
+		// Each pass runs every invocation up to its next barrier, so no invocation passes a barrier until all have reached it
+		running = true;
+		auto unfinished = true;
+		while (unfinished)
+		{
+			unfinished = false;
+			for (auto i = 0u; i < count; i++)
+			{
+				if (!invocations[i]->finished)
+				{
+					Platform::SwitchToFiber(invocations[i]->fiber);
+					unfinished |= !invocations[i]->finished;
+				}
+			}
+		}
+		running = false;
+	}
+
+	void Barrier() const
+	{
+		// Fragment shaders also run outside of quads, for points and lines, where there is nothing to wait for
+		if (running)
+		{
+			Platform::SwitchToFiber(schedulerFiber);
+		}
+	}
+
+private:
+	size_t stackSize;
+	void* schedulerFiber{};
+	bool running{};
+	std::vector<std::unique_ptr<WorkgroupInvocation>> invocations{};
+
+	static void InvocationMain(void* parameter)
+	{
+		const auto invocation = static_cast<WorkgroupInvocation*>(parameter);
+		while (true)
+		{
+			invocation->entryPoint(invocation->context);
+			invocation->finished = true;
+			Platform::SwitchToFiber(invocation->schedulerFiber);
+		}
+	}
+};
+
+static thread_local WorkgroupScheduler workgroupScheduler{COMPUTE_FIBER_STACK_SIZE};
+static thread_local WorkgroupScheduler quadScheduler{FRAGMENT_FIBER_STACK_SIZE};
+
+static void RunWorkgroup(void (*entryPoint)(uint8_t*), uint8_t* contexts, uint32_t count, uint64_t stride)
+{
+	workgroupScheduler.Run(entryPoint, contexts, count, stride);
+}
+
+static void ControlBarrier()
+{
+	workgroupScheduler.Barrier();
+}
+
+// The lanes of a fragment quad run the same way as a workgroup, with a barrier at every derivative
+static void RunQuad(void (*entryPoint)(uint8_t*), uint8_t* contexts, uint32_t count, uint64_t stride)
+{
+	quadScheduler.Run(entryPoint, contexts, count, stride);
+}
+
+static void QuadBarrier()
+{
+	quadScheduler.Barrier();
+}
+
+void AddWorkgroupFunctions(DeviceState* deviceState)
+{
+	auto jit = deviceState->jit;
+	jit->AddFunction("@runWorkgroup", reinterpret_cast<FunctionPointer>(RunWorkgroup));
+	jit->AddFunction("@controlBarrier", reinterpret_cast<FunctionPointer>(ControlBarrier));
+	jit->AddFunction("@runQuad", reinterpret_cast<FunctionPointer>(RunQuad));
+	jit->AddFunction("@quadBarrier", reinterpret_cast<FunctionPointer>(QuadBarrier));
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#pragma once
+
+struct DeviceState;
+
+void AddWorkgroupFunctions(DeviceState* deviceState);
\ No newline at end of file
@@ -213,6 +213,23 @@ constexpr auto RT_MAX_INSTANCE_COUNT = 0xFFFFFFFF;
 constexpr auto RT_MAX_TRIANGLE_COUNT = 0xFFFFFFFF;
 constexpr auto RT_MAX_DESCRIPTOR_SET_ACCELERATION_STRUCTURES = 0x10000;
 
+constexpr auto RASTERISER_TILE_SIZE = 64;
+constexpr auto RASTERISER_BLOCK_SIZE = 8;
+constexpr auto RASTERISER_GUARD_BAND = 8.0f; // In multiples of the viewport, triangles within it are never clipped in x/y
+constexpr auto RASTERISER_DEFERRED_SHADING_VARIABLE = "CPVULKAN_DEFERRED_SHADING"; // Set to 1 to resolve visibility per tile first for opaque pipelines, so each pixel is shaded once, read when a device is created
+constexpr auto FRAGMENT_BATCH_SIZE = 8;
+constexpr auto FRAGMENT_QUAD_SIZE = 4; // Lanes of a 2x2 quad, each with its own context when the shader takes derivatives
+constexpr auto VERTEX_BATCH_SIZE = 256;
+constexpr auto SHADER_LANE_COUNT = 8; // Vertex and compute invocations run together by one call of a lane widened shader, each in an element of its vectors
+constexpr auto COMPUTE_JOBS_PER_WORKER = 4;
+constexpr auto COMPUTE_FIBER_STACK_SIZE = 64 * 1024;
+constexpr auto FRAGMENT_FIBER_STACK_SIZE = 256 * 1024; // Quads run the whole fragment shader, including the image functions it calls, on these
+constexpr auto CLEAR_JOB_SIZE = 256 * 1024; // Bytes filled by each job of a multithreaded clear
+
+static_assert(RASTERISER_TILE_SIZE % RASTERISER_BLOCK_SIZE == 0);
+static_assert(FRAGMENT_BATCH_SIZE < 32);
+static_assert(FRAGMENT_BATCH_SIZE % FRAGMENT_QUAD_SIZE == 0);
+
 static_assert(MAX_FRAGMENT_OUTPUT_ATTACHMENTS == MAX_COLOUR_ATTACHMENTS);
 static_assert(MAX_FRAGMENT_COMBINED_OUTPUT_RESOURCES >= MAX_FRAGMENT_OUTPUT_ATTACHMENTS);
 
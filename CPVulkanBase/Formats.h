@@ -27,6 +27,9 @@ enum class BaseType
 
 constexpr auto INVALID_OFFSET = 0xFFFFFFFF;
 
+// Size of the largest texel, or compressed block, of any format
+constexpr auto MAX_TEXEL_SIZE = 32u;
+
 struct FormatInformation
 {
 	VkFormat Format;
@@ -135,6 +138,32 @@ struct ImageSize
 	uint64_t PixelSize;
 };
 
+constexpr auto FORMAT_YCBCR_COUNT = VK_FORMAT_G16_B16_R16_3PLANE_444_UNORM - VK_FORMAT_G8B8G8R8_422_UNORM + 1;
+constexpr auto FORMAT_PVRTC_COUNT = VK_FORMAT_PVRTC2_4BPP_SRGB_BLOCK_IMG - VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG + 1;
+constexpr auto FORMAT_INDEX_COUNT = static_cast<uint32_t>(VK_FORMAT_RANGE_SIZE + FORMAT_YCBCR_COUNT + FORMAT_PVRTC_COUNT);
+
+// Maps every supported format to a dense index below FORMAT_INDEX_COUNT, core formats first and then the extension ranges, so per format tables can be flat arrays
+inline uint32_t GetFormatIndex(VkFormat format)
+{
+	const auto iFormat = static_cast<int32_t>(format);
+	if (iFormat >= VK_FORMAT_BEGIN_RANGE && iFormat <= VK_FORMAT_END_RANGE)
+	{
+		return static_cast<uint32_t>(iFormat - VK_FORMAT_BEGIN_RANGE);
+	}
+
+	if (iFormat >= VK_FORMAT_G8B8G8R8_422_UNORM && iFormat <= VK_FORMAT_G16_B16_R16_3PLANE_444_UNORM)
+	{
+		return static_cast<uint32_t>(VK_FORMAT_RANGE_SIZE + (iFormat - VK_FORMAT_G8B8G8R8_422_UNORM));
+	}
+
+	if (iFormat >= VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG && iFormat <= VK_FORMAT_PVRTC2_4BPP_SRGB_BLOCK_IMG)
+	{
+		return static_cast<uint32_t>(VK_FORMAT_RANGE_SIZE + FORMAT_YCBCR_COUNT + (iFormat - VK_FORMAT_PVRTC1_2BPP_UNORM_BLOCK_IMG));
+	}
+
+	FATAL_ERROR();
+}
+
 CP_DLL_EXPORT const FormatInformation& GetFormatInformation(VkFormat format);
 
 CP_DLL_EXPORT ImageSize GetImageSize(const FormatInformation& format, uint32_t width, uint32_t height, uint32_t depth, uint32_t arrayLayers, uint32_t mipLevels);
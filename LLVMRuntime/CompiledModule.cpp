@@ -51,6 +51,8 @@ CompiledModule* Compile(CompiledModuleBuilder* moduleBuilder, CPJit* jit, std::f
 	{
 		const auto context = LLVMContextCreate();
 		const auto module = LLVMModuleCreateWithNameInContext("", context);
+		LLVMSetTarget(module, jit->getTargetTriple().c_str());
+		LLVMSetModuleDataLayout(module, jit->getDataLayout());
 		const auto builder = LLVMCreateBuilderInContext(context);
 
 		moduleBuilder->Initialise(jit, context, module);
@@ -95,6 +97,8 @@ CompiledModule::CompiledModule(CPJit* jit, LLVMContextRef context, LLVMModuleRef
 			const auto errorMessage = LLVMGetErrorMessage(error);
 			TODO_ERROR();
 		}
+
+		ResolveDefinedSymbols();
 	});
 }
 
@@ -179,6 +183,49 @@ uint64_t CompiledModule::ResolveSymbol(const char* name)
 	return reinterpret_cast<uint64_t>(function);
 }
 
+void CompiledModule::ResolveDefinedSymbols()
+{
+	const auto resolve = [&](LLVMValueRef value)
+	{
+		if (LLVMIsDeclaration(value))
+		{
+			return;
+		}
+
+		size_t length;
+		const auto pointer = LLVMGetValueName2(value, &length);
+		if (length == 0)
+		{
+			return;
+		}
+
+		const std::string name{pointer, length};
+		LLVMOrcTargetAddress symbolAddress;
+		const auto error = LLVMOrcGetSymbolAddressIn(jit->getOrc(), &symbolAddress, orcModule, name.c_str());
+		if (error)
+		{
+			const auto errorMessage = LLVMGetErrorMessage(error);
+			TODO_ERROR();
+		}
+
+		// Symbols with local linkage are not exported
+		if (symbolAddress)
+		{
+			symbols[name] = reinterpret_cast<void*>(symbolAddress);
+		}
+	};
+
+	for (auto global = LLVMGetFirstGlobal(module); global; global = LLVMGetNextGlobal(global))
+	{
+		resolve(global);
+	}
+
+	for (auto function = LLVMGetFirstFunction(module); function; function = LLVMGetNextFunction(function))
+	{
+		resolve(function);
+	}
+}
+
 CompiledModule* CompiledModule::CreateFromBitcode(CPJit* jit, const std::function<void*(const std::basic_string<char>&)>& getFunction, const std::vector<uint8_t>& data)
 {
 	CompiledModule* result{};
@@ -213,19 +260,8 @@ void* CompiledModule::getPointer(const std::string& name) const
 
 void* CompiledModule::getOptionalPointer(const std::string& name) const
 {
-	LLVMOrcTargetAddress symbolAddress;
-	
-	jit->RunOnCompileThread([&]()
-	{
-		const auto error = LLVMOrcGetSymbolAddressIn(jit->getOrc(), &symbolAddress, orcModule, name.c_str());
-		if (error)
-		{
-			const auto errorMessage = LLVMGetErrorMessage(error);
-			TODO_ERROR();
-		}
-	});
-
-	return reinterpret_cast<void*>(symbolAddress);
+	const auto symbol = symbols.find(name);
+	return symbol != symbols.end() ? symbol->second : nullptr;
 }
 
 FunctionPointer CompiledModule::getFunctionPointer(const std::string& name) const
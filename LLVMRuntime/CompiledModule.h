@@ -4,6 +4,8 @@
 #include "Jit.h"
 #include "../CPVulkan/PipelineCache.h"
 
+#include <unordered_map>
+
 using LLVMBuilderRef = struct LLVMOpaqueBuilder*;
 using LLVMContextRef = struct LLVMOpaqueContext*;
 using LLVMModuleRef = struct LLVMOpaqueModule*;
@@ -33,4 +35,8 @@ private:
 	LLVMModuleRef module;
 	std::function<void*(const std::string&)> getFunction;
 	LLVMOrcModuleHandle orcModule;
+	// Every symbol the module defines, resolved once it is compiled so lookups never wait on the compile thread
+	std::unordered_map<std::string, void*> symbols{};
+
+	void ResolveDefinedSymbols();
 };
\ No newline at end of file
@@ -43,5 +43,10 @@ CP_DLL_EXPORT CompiledModule* CompileFragmentPipeline(CPJit* jit,
                                                       const SPIRV::SPIRVFunction* entryPoint,
                                                       const VkSpecializationInfo* specializationInfo);
 
+CP_DLL_EXPORT CompiledModule* CompileComputePipeline(CPJit* jit,
+                                                     const SPIRV::SPIRVModule* computeShader,
+                                                     const SPIRV::SPIRVFunction* entryPoint,
+                                                     const VkSpecializationInfo* specializationInfo);
+
 CP_DLL_EXPORT CompiledModule* CompileSPIRVModule(CPJit* jit, const SPIRV::SPIRVModule* spirvModule, spv::ExecutionModel executionModel, 
                                                  const SPIRV::SPIRVFunction* entryPoint, const VkSpecializationInfo* specializationInfo);
\ No newline at end of file
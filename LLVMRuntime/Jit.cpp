@@ -8,7 +8,9 @@
 #include <llvm-c/Support.h>
 #include <llvm-c/Target.h>
 #include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/InstCombine.h>
 #include <llvm-c/Transforms/PassManagerBuilder.h>
+#include <llvm-c/Transforms/Vectorize.h>
 
 #include <atomic>
 #include <mutex>
@@ -27,6 +29,8 @@ struct Task
 	std::mutex mutex{};
 	std::condition_variable event{};
 	std::atomic_bool isDone{};
+	// Nobody waits on a queued task, so the compile thread deletes it once run
+	bool isQueued{};
 };
 
 class CPJit::Impl
@@ -54,6 +58,7 @@ public:
 				targetMachine = LLVMCreateTargetMachine(target, targetTriple, hostCpu, hostCpuFeatures, LLVMCodeGenLevelAggressive, LLVMRelocDefault, LLVMCodeModelJITDefault);
 
 				dataLayout = LLVMCreateTargetDataLayout(targetMachine);
+				this->targetTriple = targetTriple;
 
 				LLVMDisposeMessage(hostCpuFeatures);
 				LLVMDisposeMessage(hostCpu);
@@ -63,12 +68,17 @@ public:
 
 				LLVMLoadLibraryPermanently(nullptr);
 
+				// Target analysis gives the vectorisers the real SIMD width of the host rather than a generic cost model
 				passManager = LLVMCreatePassManager();
+				LLVMAddAnalysisPasses(targetMachine, passManager);
 				const auto passBuilder = LLVMPassManagerBuilderCreate();
 				LLVMPassManagerBuilderSetOptLevel(passBuilder, 3);
 				LLVMPassManagerBuilderSetSizeLevel(passBuilder, 1);
 				LLVMPassManagerBuilderPopulateModulePassManager(passBuilder, passManager);
 				LLVMPassManagerBuilderDispose(passBuilder);
+				LLVMAddLoopVectorizePass(passManager);
+				LLVMAddSLPVectorizePass(passManager);
+				LLVMAddInstructionCombiningPass(passManager);
 				
 				this->ThreadUpdate();
 			}
@@ -77,6 +87,8 @@ public:
 
 	~Impl()
 	{
+		// Calls go ahead of queued work, so let the queue finish before the JIT goes away under it
+		this->Flush();
 		this->Call([this]()
 		{
 			shouldExit = true;
@@ -95,16 +107,24 @@ public:
 			Task* task = nullptr;
 			{
 				std::unique_lock<std::mutex> lock{compileMutex};
-				while (compileQueue.empty())
+				while (compileQueue.empty() && backgroundQueue.empty())
 				{
 					conditionalEvent.wait(lock);
 				}
 
-				task = compileQueue.front();
-				compileQueue.pop();
+				// Someone is blocked on every task in compileQueue, so they go before anything compiled ahead of time
+				auto& queue = compileQueue.empty() ? backgroundQueue : compileQueue;
+				task = queue.front();
+				queue.pop();
 			}
 
 			task->action();
+
+			if (task->isQueued)
+			{
+				delete task;
+				continue;
+			}
 			
 			{
 				std::unique_lock<std::mutex> lock{task->mutex};
@@ -128,19 +148,41 @@ public:
 		else
 		{
 			Task task(action);
+			Wait(task, compileQueue);
+		}
+	}
 
-			{
-				std::unique_lock<std::mutex> lock{compileMutex};
-				compileQueue.push(&task);
-				conditionalEvent.notify_one();
-			}
+	void Flush()
+	{
+		Task task([]()
+		{
+		});
+		Wait(task, backgroundQueue);
+	}
+
+	void Queue(std::function<void()> action)
+	{
+		const auto task = new Task(std::move(action));
+		task->isQueued = true;
 
+		std::unique_lock<std::mutex> lock{compileMutex};
+		backgroundQueue.push(task);
+		conditionalEvent.notify_one();
+	}
+
+	void Wait(Task& task, std::queue<Task*>& queue)
+	{
+		{
+			std::unique_lock<std::mutex> lock{compileMutex};
+			queue.push(&task);
+			conditionalEvent.notify_one();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock{task.mutex};
+			while (!task.isDone)
 			{
-				std::unique_lock<std::mutex> lock{task.mutex};
-				while (!task.isDone)
-				{
-					task.event.wait(lock);
-				}
+				task.event.wait(lock);
 			}
 		}
 	}
@@ -170,6 +212,11 @@ public:
 		return dataLayout;
 	}
 
+	[[nodiscard]] const std::string& getTargetTriple() const
+	{
+		return targetTriple;
+	}
+
 	[[nodiscard]] LLVMOrcJITStackRef getOrc() const
 	{
 		return orcInstance;
@@ -188,6 +235,7 @@ public:
 private:
 	LLVMTargetMachineRef targetMachine;
 	LLVMTargetDataRef dataLayout;
+	std::string targetTriple;
 	LLVMOrcJITStackRef orcInstance;
 	LLVMPassManagerRef passManager;
 
@@ -196,6 +244,7 @@ private:
 
 	std::thread compileThread;
 	std::queue<Task*> compileQueue{};
+	std::queue<Task*> backgroundQueue{};
 	std::mutex compileMutex;
 	std::condition_variable conditionalEvent{};
 	std::atomic_bool shouldExit{};
@@ -221,6 +270,16 @@ void CPJit::RunOnCompileThread(const std::function<void()>& action)
 	impl->Call(action);
 }
 
+void CPJit::QueueOnCompileThread(std::function<void()> action)
+{
+	impl->Queue(std::move(action));
+}
+
+void CPJit::FlushCompileThread()
+{
+	impl->Flush();
+}
+
 FunctionPointer CPJit::getFunction(const std::string& name)
 {
 	return impl->getFunction(name);
@@ -236,6 +295,11 @@ LLVMTargetDataRef CPJit::getDataLayout() const
 	return impl->getDataLayout();
 }
 
+const std::string& CPJit::getTargetTriple() const
+{
+	return impl->getTargetTriple();
+}
+
 LLVMOrcJITStackRef CPJit::getOrc() const
 {
 	return impl->getOrc();
@@ -17,11 +17,17 @@ public:
 	~CPJit();
 
 	void AddFunction(const std::string& name, FunctionPointer pointer);
+	// Runs action on the compile thread and waits for it, ahead of anything queued with QueueOnCompileThread
 	void RunOnCompileThread(const std::function<void()>& action);
+	// Runs action on the compile thread once nothing is waiting on it, without waiting for it
+	void QueueOnCompileThread(std::function<void()> action);
+	// Waits for everything queued with QueueOnCompileThread to have run
+	void FlushCompileThread();
 
 	[[nodiscard]] FunctionPointer getFunction(const std::string& name);
 	[[nodiscard]] void* getUserData() const;
 	[[nodiscard]] LLVMTargetDataRef getDataLayout() const;
+	[[nodiscard]] const std::string& getTargetTriple() const;
 	[[nodiscard]] LLVMOrcJITStackRef getOrc() const;
 	[[nodiscard]] LLVMPassManagerRef getPassManager() const;
 
@@ -472,14 +472,36 @@ protected:
 	LLVMValueRef shaderEntryPoint{};
 	LLVMValueRef pipelineState{};
 	
-	void CompileShader(ExecutionModel executionModel)
+	void CompileShader(ExecutionModel executionModel, uint32_t laneCount = 0)
 	{
 		//TODO: share structs
-		shaderModuleBuilder = std::make_unique<SPIRVCompiledModuleBuilder>(shader, executionModel, entryPoint, specializationInfo);
+		shaderModuleBuilder = std::make_unique<SPIRVCompiledModuleBuilder>(shader, executionModel, entryPoint, specializationInfo, laneCount);
 		shaderModuleBuilder->Initialise(jit, context, module);
 		shaderEntryPoint = shaderModuleBuilder->CompileMainFunction();
 	}
 
+	LLVMValueRef GetShaderVariable(LLVMValueRef shaderContext, const SPIRV::SPIRVValue* variable, LLVMValueRef lane = nullptr)
+	{
+		const auto shaderVariable = CreateGEP(shaderContext, 0, shaderModuleBuilder->getContextIndex(variable));
+		if (lane)
+		{
+			// Lane widened shaders hold an element of each variable per invocation
+			return CreateGEP(shaderVariable, std::vector<LLVMValueRef>{ConstU32(0), lane});
+		}
+		return shaderVariable;
+	}
+
+	// Lanes from first onwards are active until end
+	LLVMValueRef CreateLaneMask(LLVMValueRef first, LLVMValueRef end, uint32_t laneCount)
+	{
+		auto mask = LLVMGetUndef(LLVMVectorType(LLVMInt1TypeInContext(context), laneCount));
+		for (auto i = 0u; i < laneCount; i++)
+		{
+			mask = CreateInsertElement(mask, CreateICmpULT(CreateAdd(first, ConstU32(i)), end), ConstU32(i));
+		}
+		return mask;
+	}
+
 	void CreatePipelineState()
 	{
 		std::vector<LLVMTypeRef> pipelineStateMembers
@@ -512,7 +534,7 @@ public:
 protected:
 	LLVMValueRef CompileMainFunctionImpl() override
 	{
-		CompileShader(ExecutionModelVertex);
+		CompileShader(ExecutionModelVertex, SHADER_LANE_COUNT);
 		CreatePipelineState();
 		
 		std::vector<LLVMTypeRef> assemblerOutputMembers
@@ -547,11 +569,12 @@ protected:
 		const auto outputType = LLVMPointerType(StructType(outputMembers, "_Output", true), 0);
 		const auto outputVariable = GlobalVariable(LLVMPointerType(LLVMInt8TypeInContext(context), 0), LLVMExternalLinkage, "@outputStorage");
 		
-		std::array<LLVMTypeRef, 3> parameters
+		std::array<LLVMTypeRef, 4> parameters
 		{
 			LLVMPointerType(assemblerOutputType, 0),
 			LLVMInt32TypeInContext(context),
 			LLVMInt32TypeInContext(context),
+			LLVMPointerType(shaderModuleBuilder->getContextType(), 0),
 		};
 		const auto functionType = LLVMFunctionType(LLVMVoidType(), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
 		const auto function = LLVMAddFunction(module, "@main", functionType);
@@ -562,19 +585,59 @@ protected:
 
 		const auto numberVertices = LLVMGetParam(function, 1);
 		const auto instanceId = LLVMGetParam(function, 2);
+		const auto shaderContext = LLVMGetParam(function, 3);
 		
-		// Get shader variables
-		const auto shaderBuiltinInputAddress = CreateBitCast(shaderModuleBuilder->getBuiltinInput(), LLVMPointerType(builtinInputType, 0));
-		const auto shaderBuiltinOutputAddress = CreateBitCast(shaderModuleBuilder->getBuiltinOutput(), LLVMPointerType(builtinOutputType, 0));
+		const auto laneCount = shaderModuleBuilder->getLaneCount();
+		if (laneCount)
+		{
+			// Each call of the shader processes the next laneCount vertices, with every variable holding one element per vertex
+			CreateFor(function, ConstU32(0), numberVertices, ConstU32(laneCount), [&](LLVMValueRef first, LLVMBasicBlockRef, LLVMBasicBlockRef)
+			{
+				const auto mask = CreateLaneMask(first, numberVertices, laneCount);
+				const auto forEachLane = [&](const std::function<void(LLVMValueRef rawId, LLVMValueRef vertexId, LLVMValueRef lane)>& laneFunction)
+				{
+					for (auto i = 0u; i < laneCount; i++)
+					{
+						CreateIf(function, CreateExtractElement(mask, ConstU32(i)), "lane", [&](LLVMBasicBlockRef)
+						{
+							const auto index = CreateAdd(first, ConstU32(i));
+							const auto rawId = CreateLoad(CreateGEP(LLVMGetParam(function, 0), std::vector<LLVMValueRef>{index, ConstU32(0)}));
+							const auto vertexId = CreateLoad(CreateGEP(LLVMGetParam(function, 0), std::vector<LLVMValueRef>{index, ConstU32(1)}));
+							laneFunction(rawId, vertexId, ConstU32(i));
+						}, nullptr);
+					}
+				};
 
-		CreateFor(function, ConstU32(0), numberVertices, ConstU32(1), [&](LLVMValueRef i, LLVMBasicBlockRef, LLVMBasicBlockRef)
+				forEachLane([&](LLVMValueRef, LLVMValueRef vertexId, LLVMValueRef lane)
+				{
+					const auto laneBuiltinInputAddress = CreateBitCast(CreateGEP(shaderContext, std::vector<LLVMValueRef>{ConstU32(0), ConstU32(shaderModuleBuilder->getBuiltinInputIndex()), lane}), LLVMPointerType(builtinInputType, 0));
+					CompileCopyVertexInput(vertexId, instanceId, shaderContext, laneBuiltinInputAddress, lane);
+				});
+
+				CreateCall(shaderEntryPoint, {mask, shaderContext});
+
+				forEachLane([&](LLVMValueRef rawId, LLVMValueRef, LLVMValueRef lane)
+				{
+					const auto laneBuiltinOutputAddress = CreateBitCast(CreateGEP(shaderContext, std::vector<LLVMValueRef>{ConstU32(0), ConstU32(shaderModuleBuilder->getBuiltinOutputIndex()), lane}), LLVMPointerType(builtinOutputType, 0));
+					CompileCopyVertexOutput(rawId, shaderContext, laneBuiltinOutputAddress, outputVariable, outputType, lane);
+				});
+			});
+		}
+		else
 		{
-			const auto rawId = CreateLoad(CreateGEP(LLVMGetParam(function, 0), std::vector<LLVMValueRef>{i, ConstU32(0)}));
-			const auto vertexId = CreateLoad(CreateGEP(LLVMGetParam(function, 0), std::vector<LLVMValueRef>{i, ConstU32(1)}));
-			CompileProcessVertex(rawId, vertexId, instanceId,
-			                     shaderBuiltinInputAddress, shaderBuiltinOutputAddress,
-			                     outputVariable, outputType);
-		});
+			// Get shader variables
+			const auto shaderBuiltinInputAddress = CreateBitCast(CreateGEP(shaderContext, 0, shaderModuleBuilder->getBuiltinInputIndex()), LLVMPointerType(builtinInputType, 0));
+			const auto shaderBuiltinOutputAddress = CreateBitCast(CreateGEP(shaderContext, 0, shaderModuleBuilder->getBuiltinOutputIndex()), LLVMPointerType(builtinOutputType, 0));
+
+			CreateFor(function, ConstU32(0), numberVertices, ConstU32(1), [&](LLVMValueRef i, LLVMBasicBlockRef, LLVMBasicBlockRef)
+			{
+				const auto rawId = CreateLoad(CreateGEP(LLVMGetParam(function, 0), std::vector<LLVMValueRef>{i, ConstU32(0)}));
+				const auto vertexId = CreateLoad(CreateGEP(LLVMGetParam(function, 0), std::vector<LLVMValueRef>{i, ConstU32(1)}));
+				CompileProcessVertex(rawId, vertexId, instanceId, shaderContext,
+				                     shaderBuiltinInputAddress, shaderBuiltinOutputAddress,
+				                     outputVariable, outputType);
+			});
+		}
 
 		LLVMBuildRetVoid(builder);
 
@@ -895,12 +958,21 @@ private:
 		CreateStore(bufferData, shaderAddress);
 	}
 
-	void CompileProcessVertex(LLVMValueRef rawId, LLVMValueRef vertexId, LLVMValueRef instanceId,
+	void CompileProcessVertex(LLVMValueRef rawId, LLVMValueRef vertexId, LLVMValueRef instanceId, LLVMValueRef shaderContext,
 	                          LLVMValueRef shaderBuiltinInputAddress, LLVMValueRef shaderBuiltinOutputAddress, 
 	                          LLVMValueRef outputVariable, LLVMTypeRef outputType)
 	{
-		const auto outputStride = LLVMSizeOfTypeInBits(jit->getDataLayout(), LLVMGetElementType(outputType)) / 8;
-		
+		CompileCopyVertexInput(vertexId, instanceId, shaderContext, shaderBuiltinInputAddress);
+
+		// Call the vertex shader
+		CreateCall(shaderEntryPoint, {shaderContext});
+
+		CompileCopyVertexOutput(rawId, shaderContext, shaderBuiltinOutputAddress, outputVariable, outputType);
+	}
+
+	void CompileCopyVertexInput(LLVMValueRef vertexId, LLVMValueRef instanceId, LLVMValueRef shaderContext,
+	                            LLVMValueRef shaderBuiltinInputAddress, LLVMValueRef lane = nullptr)
+	{
 		// Set vertex shader builtin
 		CreateStore(vertexId, CreateGEP(shaderBuiltinInputAddress, 0, 0), false);
 		CreateStore(instanceId, CreateGEP(shaderBuiltinInputAddress, 0, 1), false);
@@ -919,7 +991,7 @@ private:
 
 				const auto location = *locations.begin();
 				const auto spirvType = variable->getType()->getPointerElementType();
-				const auto shaderVariable = shaderModuleBuilder->ConvertValue(variable, nullptr);
+				const auto shaderVariable = GetShaderVariable(shaderContext, variable, lane);
 				
 				if (spirvType->isTypeArray())
 				{
@@ -948,9 +1020,12 @@ private:
 				}
 			}
 		}
+	}
 
-		// Call the vertex shader
-		LLVMBuildCall(builder, shaderEntryPoint, nullptr, 0, "");
+	void CompileCopyVertexOutput(LLVMValueRef rawId, LLVMValueRef shaderContext, LLVMValueRef shaderBuiltinOutputAddress,
+	                             LLVMValueRef outputVariable, LLVMTypeRef outputType, LLVMValueRef lane = nullptr)
+	{
+		const auto outputStride = LLVMSizeOfTypeInBits(jit->getDataLayout(), LLVMGetElementType(outputType)) / 8;
 
 		// TODO: Modify vertex shader to use pointers directly instead of copying
 
@@ -972,7 +1047,7 @@ private:
 					continue;
 				}
 
-				const auto shaderVariable = shaderModuleBuilder->ConvertValue(variable, nullptr);
+				const auto shaderVariable = GetShaderVariable(shaderContext, variable, lane);
 				const auto shaderValue = CreateLoad(shaderVariable);
 				CreateStore(shaderValue, CreateGEP(outputStorage, 0, j + 1));
 				j++;
@@ -1003,6 +1078,7 @@ public:
 
 protected:
 	LLVMValueRef mainFunction{};
+	LLVMValueRef shaderContext{};
 	LLVMValueRef depth{};
 	LLVMValueRef x{};
 	LLVMValueRef y{};
@@ -1024,12 +1100,13 @@ protected:
 
 		FindShaderLocations();
 
-		std::array<LLVMTypeRef, 4> parameters
+		std::array<LLVMTypeRef, 5> parameters
 		{
 			LLVMFloatTypeInContext(context),
 			LLVMInt32TypeInContext(context),
 			LLVMInt32TypeInContext(context),
 			LLVMInt1TypeInContext(context),
+			LLVMPointerType(shaderModuleBuilder->getContextType(), 0),
 		};
 		const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
 		mainFunction = LLVMAddFunction(module, "@main", functionType);
@@ -1039,49 +1116,341 @@ protected:
 		x = LLVMGetParam(mainFunction, 1);
 		y = LLVMGetParam(mainFunction, 2);
 		isFront = LLVMGetParam(mainFunction, 3);
+		shaderContext = LLVMGetParam(mainFunction, 4);
 
 		const auto basicBlock = LLVMAppendBasicBlockInContext(context, mainFunction, "run-fragment-shader");
 		LLVMPositionBuilderAtEnd(builder, basicBlock);
 
 		// TODO: 27.2. Discard Rectangles Test
-		// TODO: 27.3. Scissor Test
+		// 27.3. Scissor Test is done by the rasteriser, which never visits pixels outside the scissor
 		// TODO: 27.4. Exclusive Scissor Test
 		// TODO: 27.5. Sample Mask
 
-		// TODO: If early per-fragment operations are enabled by the fragment shader, these operations are also performed:
-		// TODO: 27.11. Depth Bounds Test
-		// TODO: 27.12. Stencil Test
-		// TODO: 27.13. Depth Test
+		const auto callShader = [&]()
+		{
+			return CreateCall(shaderEntryPoint, {shaderContext});
+		};
+
+		// Without any other effects the tests can move before the shader, as nothing can tell the difference
+		const auto writesOnlyColour = WritesOnlyColour();
+		const auto earlyFragmentTests = writesOnlyColour || entryPoint->getExecutionMode(SPIRV::SPIRVExecutionModeKind::ExecutionModeEarlyFragmentTests);
+		GlobalVariable(LLVMInt32TypeInContext(context), true, LLVMExternalLinkage, ConstU32(writesOnlyColour ? 1 : 0), "@writesOnlyColour");
+		GlobalVariable(LLVMInt32TypeInContext(context), true, LLVMExternalLinkage, ConstU32(earlyFragmentTests ? 1 : 0), "@earlyFragmentTests");
+
+		if (earlyFragmentTests)
+		{
+			// The shader cannot change the outcome of the tests, so fragments that fail them are never shaded
+			const auto endFragmentBlock = LLVMCreateBasicBlockInContext(context, "end-fragment");
+			CompileFragmentTests(endFragmentBlock);
+			std::function<void(LLVMBasicBlockRef)> failedTests{};
+			if (shaderModuleBuilder->getQuadStateIndex() != INVALID_CONTEXT_INDEX)
+			{
+				failedTests = [&](LLVMBasicBlockRef)
+				{
+					// Within a quad the fragment still runs as a helper, so its neighbours have a value to take derivatives against
+					const auto quadState = CreateGEP(shaderContext, 0, shaderModuleBuilder->getQuadStateIndex());
+					const auto inQuad = CreateICmpNE(CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_ACTIVE)), ConstU32(0));
+					CreateIf(mainFunction, inQuad, "quad-helper", [&](LLVMBasicBlockRef)
+					{
+						CreateStore(ConstU32(1), CreateGEP(quadState, 0, QUAD_STATE_HELPER));
+						callShader();
+					}, nullptr);
+				};
+			}
+
+			CreateIf(mainFunction, CreateAnd(stencilResult, depthResult), "early-tests-passed", [&](LLVMBasicBlockRef)
+			{
+				// Depth and stencil are already written by the tests, a discard only drops the colour
+				const auto shaderResult = callShader();
+				CreateIf(mainFunction, shaderResult, "check-discard", nullptr, [&](LLVMBasicBlockRef)
+				{
+					CompileWriteFragment();
+				});
+			}, failedTests);
+			CreateBr(endFragmentBlock);
+			LLVMAppendExistingBasicBlock(mainFunction, endFragmentBlock);
+			LLVMPositionBuilderAtEnd(builder, endFragmentBlock);
+		}
+		else
+		{
+			const auto shaderResult = callShader();
+			CreateIf(mainFunction, shaderResult, "check-discard", nullptr, [&](LLVMBasicBlockRef endFragmentBlock)
+			{
+				CompileFragmentTests(endFragmentBlock);
+				CompileWriteFragment();
+			});
+		}
+
+		CreateRetVoid();
+
+		CompileBatchFunction();
+
+		return mainFunction;
+	}
+
+	// Whether the shader's only effect is its colour outputs, so it cannot discard, write depth, or store anywhere else
+	bool WritesOnlyColour() const
+	{
+		for (auto i = 0u; i < shader->getNumVariables(); i++)
+		{
+			const auto variable = shader->getVariable(i);
+			switch (variable->getStorageClass())
+			{
+			case StorageClassOutput:
+				if (variable->hasDecorate(DecorationBuiltIn))
+				{
+					const auto builtin = static_cast<BuiltIn>(*variable->getDecorate(DecorationBuiltIn).begin());
+					if (builtin == BuiltInFragDepth || builtin == BuiltInSampleMask || builtin == BuiltInFragStencilRefEXT)
+					{
+						return false;
+					}
+				}
+				break;
+
+			case StorageClassStorageBuffer:
+			case StorageClassPhysicalStorageBuffer:
+				return false;
+
+			case StorageClassUniform:
+				if (variable->getType()->getPointerElementType()->hasDecorate(DecorationBufferBlock))
+				{
+					return false;
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		for (auto i = 0u; i < shader->getNumFunctions(); i++)
+		{
+			const auto spirvFunction = shader->getFunction(i);
+			for (auto j = 0u; j < spirvFunction->getNumBasicBlock(); j++)
+			{
+				const auto spirvBasicBlock = spirvFunction->getBasicBlock(j);
+				for (auto k = 0u; k < spirvBasicBlock->getNumInst(); k++)
+				{
+					const auto opCode = spirvBasicBlock->getInst(k)->getOpCode();
+					if (opCode == OpKill || opCode == OpImageWrite || (opCode >= OpAtomicLoad && opCode <= OpAtomicXor))
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void CompileFragmentTests(LLVMBasicBlockRef endFragmentBlock)
+	{
+		CompileGetCurrentData();
+
+		// TODO: 27.8. Mixed attachment samples
+		// TODO: 27.9. Multisample Coverage
+		// TODO: 27.10. Depth and Stencil Operations
+
+		CompileDepthBoundsTest(endFragmentBlock);
+		CompileStencilTest([this](bool front)
+		{
+			CompileDepthTest();
+			CompileDepthStencilWrite(front);
+		});
 		// TODO: 27.14. Representative Fragment Test
 		// TODO: 27.15. Sample Counting
+		// TODO: 27.16. Fragment Coverage To Color
+		// TODO: 27.17. Coverage Reduction
+	}
 
-		// Call the shader
-		const auto shaderResult = CreateCall(shaderEntryPoint, {});
+	void CompileBatchFunction()
+	{
+		// Layout must match FragmentBatch in CommandBuffer.Draw.cpp
+		std::vector<LLVMTypeRef> batchMembers
+		{
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMArrayType(LLVMInt32TypeInContext(context), FRAGMENT_BATCH_SIZE),
+			LLVMArrayType(LLVMInt32TypeInContext(context), FRAGMENT_BATCH_SIZE),
+			LLVMArrayType(LLVMFloatTypeInContext(context), FRAGMENT_BATCH_SIZE),
+			LLVMArrayType(LLVMArrayType(LLVMFloatTypeInContext(context), 4), FRAGMENT_BATCH_SIZE),
+			LLVMArrayType(LLVMInt8TypeInContext(context), MAX_FRAGMENT_INPUT_COMPONENTS * 4 * FRAGMENT_BATCH_SIZE),
+		};
+		const auto batchType = StructType(batchMembers, "_FragmentBatch", true);
 
-		CreateIf(mainFunction, shaderResult, "check-discard", nullptr, [&](LLVMBasicBlockRef endFragmentBlock)
+		std::array<LLVMTypeRef, 2> parameters
 		{
-			CompileGetCurrentData();
-			
-			// TODO: 27.8. Mixed attachment samples
-			// TODO: 27.9. Multisample Coverage
-			// TODO: 27.10. Depth and Stencil Operations
+			LLVMPointerType(batchType, 0),
+			LLVMPointerType(shaderModuleBuilder->getContextType(), 0),
+		};
+		const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
+		const auto batchFunction = LLVMAddFunction(module, "@mainBatch", functionType);
+		LLVMSetLinkage(batchFunction, LLVMExternalLinkage);
+
+		const auto batch = LLVMGetParam(batchFunction, 0);
+		const auto batchContext = LLVMGetParam(batchFunction, 1);
 
-			CompileDepthBoundsTest(endFragmentBlock);
-			CompileStencilTest([this](bool front)
+		const auto basicBlock = LLVMAppendBasicBlockInContext(context, batchFunction, "run-fragment-batch");
+		LLVMPositionBuilderAtEnd(builder, basicBlock);
+
+		const auto mask = CreateLoad(CreateGEP(batch, 0, 0));
+		const auto batchFront = CreateICmpNE(CreateLoad(CreateGEP(batch, 0, 1)), ConstU32(0));
+		const auto isLaneActive = [&](LLVMValueRef lane)
+		{
+			return CreateICmpNE(CreateAnd(CreateLShr(mask, lane), ConstU32(1)), ConstU32(0));
+		};
+		const auto callMain = [&](LLVMValueRef lane)
+		{
+			std::array<LLVMValueRef, 5> arguments
 			{
-				CompileDepthTest();
-				CompileDepthStencilWrite(front);
+				CreateLoad(CreateGEP(batch, {ConstU32(0), ConstU32(4), lane})),
+				CreateLoad(CreateGEP(batch, {ConstU32(0), ConstU32(2), lane})),
+				CreateLoad(CreateGEP(batch, {ConstU32(0), ConstU32(3), lane})),
+				batchFront,
+				batchContext,
+			};
+			CreateCall(mainFunction, arguments.data(), static_cast<uint32_t>(arguments.size()));
+		};
+
+		if (shaderModuleBuilder->getQuadStateIndex() == INVALID_CONTEXT_INDEX)
+		{
+			CreateFor(batchFunction, ConstU32(0), ConstU32(FRAGMENT_BATCH_SIZE), ConstU32(1), [&](LLVMValueRef lane, LLVMBasicBlockRef, LLVMBasicBlockRef)
+			{
+				CreateIf(batchFunction, isLaneActive(lane), "lane-active", [&](LLVMBasicBlockRef)
+				{
+					CompileLoadBatchLane(batch, batchContext, lane);
+					callMain(lane);
+				}, nullptr);
 			});
-			// TODO: 27.14. Representative Fragment Test
-			// TODO: 27.15. Sample Counting
-			// TODO: 27.16. Fragment Coverage To Color
-			// TODO: 27.17. Coverage Reduction
-			CompileWriteFragment();
-		});
+		}
+		else
+		{
+			// Lanes are grouped into 2x2 quads, each lane loaded into its own context. The lanes of a quad then run together as fibers, suspending
+			// at every derivative until the rest of the quad has its value, so the shader runs once per lane. Uncovered lanes run as helpers, which
+			// only compute values for their neighbours and never write anything visible outside of themselves.
+			const auto quadLaneFunction = CompileQuadLaneFunction();
+			CreateFor(batchFunction, ConstU32(0), ConstU32(FRAGMENT_BATCH_SIZE), ConstU32(FRAGMENT_QUAD_SIZE), [&](LLVMValueRef quad, LLVMBasicBlockRef, LLVMBasicBlockRef)
+			{
+				const auto quadMask = CreateAnd(CreateLShr(mask, quad), ConstU32((1 << FRAGMENT_QUAD_SIZE) - 1));
+				CreateIf(batchFunction, CreateICmpNE(quadMask, ConstU32(0)), "quad-active", [&](LLVMBasicBlockRef)
+				{
+					for (auto quadLane = 0; quadLane < FRAGMENT_QUAD_SIZE; quadLane++)
+					{
+						const auto lane = CreateAdd(quad, ConstU32(quadLane));
+						const auto laneContext = CreateGEP(batchContext, std::vector<LLVMValueRef>{ConstU32(quadLane)});
+						const auto quadState = CreateGEP(laneContext, 0, shaderModuleBuilder->getQuadStateIndex());
+						CreateStore(ConstU32(1), CreateGEP(quadState, 0, QUAD_STATE_ACTIVE));
+						CreateStore(ConstU32(quadLane), CreateGEP(quadState, 0, QUAD_STATE_LANE));
+						CreateStore(CreateZExt(CreateNot(isLaneActive(lane)), LLVMInt32TypeInContext(context)), CreateGEP(quadState, 0, QUAD_STATE_HELPER));
+						CreateStore(ConstU32(0), CreateGEP(quadState, 0, QUAD_STATE_PARITY));
+						CreateStore(CreateLoad(CreateGEP(batch, {ConstU32(0), ConstU32(4), lane})), CreateGEP(quadState, 0, QUAD_STATE_DEPTH));
+						CreateStore(CreateLoad(CreateGEP(batch, {ConstU32(0), ConstU32(2), lane})), CreateGEP(quadState, 0, QUAD_STATE_X));
+						CreateStore(CreateLoad(CreateGEP(batch, {ConstU32(0), ConstU32(3), lane})), CreateGEP(quadState, 0, QUAD_STATE_Y));
+						CreateStore(CreateZExt(batchFront, LLVMInt32TypeInContext(context)), CreateGEP(quadState, 0, QUAD_STATE_FRONT));
+						CompileLoadBatchLane(batch, laneContext, lane);
+					}
+
+					CompileRunQuad(quadLaneFunction, batchContext);
+				}, nullptr);
+			});
+
+			// Points and lines call @main directly with the first context, outside of any quad
+			const auto quadState = CreateGEP(batchContext, 0, shaderModuleBuilder->getQuadStateIndex());
+			CreateStore(ConstU32(0), CreateGEP(quadState, 0, QUAD_STATE_ACTIVE));
+			CreateStore(ConstU32(0), CreateGEP(quadState, 0, QUAD_STATE_HELPER));
+		}
 
 		CreateRetVoid();
+	}
 
-		return mainFunction;
+	// void mainQuadLane(_Context* context), what each lane of a quad runs as, taking its arguments from the quad state
+	LLVMValueRef CompileQuadLaneFunction()
+	{
+		std::array<LLVMTypeRef, 1> parameters
+		{
+			LLVMPointerType(shaderModuleBuilder->getContextType(), 0),
+		};
+		const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
+		const auto function = LLVMAddFunction(module, "@mainQuadLane", functionType);
+		LLVMSetLinkage(function, LLVMPrivateLinkage);
+
+		const auto previousBlock = LLVMGetInsertBlock(builder);
+		LLVMPositionBuilderAtEnd(builder, LLVMAppendBasicBlockInContext(context, function, "run-quad-lane"));
+
+		const auto laneContext = LLVMGetParam(function, 0);
+		const auto quadState = CreateGEP(laneContext, 0, shaderModuleBuilder->getQuadStateIndex());
+		const auto helper = CreateICmpNE(CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_HELPER)), ConstU32(0));
+		CreateIf(function, helper, "helper-lane", [&](LLVMBasicBlockRef)
+		{
+			CreateCall(shaderEntryPoint, {laneContext});
+		}, [&](LLVMBasicBlockRef)
+		{
+			std::array<LLVMValueRef, 5> arguments
+			{
+				CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_DEPTH)),
+				CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_X)),
+				CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_Y)),
+				CreateICmpNE(CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_FRONT)), ConstU32(0)),
+				laneContext,
+			};
+			CreateCall(mainFunction, arguments.data(), static_cast<uint32_t>(arguments.size()));
+		});
+		CreateRetVoid();
+
+		LLVMPositionBuilderAtEnd(builder, previousBlock);
+		return function;
+	}
+
+	void CompileRunQuad(LLVMValueRef quadLaneFunction, LLVMValueRef quadContexts)
+	{
+		// The host runs each lane until it finishes or reaches a derivative, resuming them in turn until all have finished
+		auto runQuad = LLVMGetNamedFunction(module, "@runQuad");
+		if (!runQuad)
+		{
+			std::array<LLVMTypeRef, 4> parameters
+			{
+				LLVMPointerType(LLVMInt8TypeInContext(context), 0),
+				LLVMPointerType(LLVMInt8TypeInContext(context), 0),
+				LLVMInt32TypeInContext(context),
+				LLVMInt64TypeInContext(context),
+			};
+			const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
+			runQuad = LLVMAddFunction(module, "@runQuad", functionType);
+		}
+
+		std::vector<LLVMValueRef> arguments
+		{
+			CreateBitCast(quadLaneFunction, LLVMPointerType(LLVMInt8TypeInContext(context), 0)),
+			CreateBitCast(quadContexts, LLVMPointerType(LLVMInt8TypeInContext(context), 0)),
+			ConstU32(FRAGMENT_QUAD_SIZE),
+			ConstU64(LLVMABISizeOfType(jit->getDataLayout(), shaderModuleBuilder->getContextType())),
+		};
+		CreateCall(runQuad, arguments);
+	}
+
+	void CompileLoadBatchLane(LLVMValueRef batch, LLVMValueRef batchContext, LLVMValueRef lane)
+	{
+		const auto bytePointerType = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+		const auto fragCoord = CreateBitCast(CreateGEP(batchContext, 0, shaderModuleBuilder->getBuiltinInputIndex()), bytePointerType);
+		const auto laneFragCoord = CreateBitCast(CreateGEP(batch, {ConstU32(0), ConstU32(5), lane}), bytePointerType);
+		CreateMemCpy(fragCoord, 4, laneFragCoord, 4, ConstU64(sizeof(float) * 4));
+
+		// Inputs are stored per variable, with each lane's value packed after the previous lane's
+		auto inputOffset = 0u;
+		for (auto i = 0u; i < shader->getNumVariables(); i++)
+		{
+			const auto variable = shader->getVariable(i);
+			if (variable->getStorageClass() != StorageClassInput || variable->getDecorate(DecorationLocation).empty())
+			{
+				continue;
+			}
+
+			const auto size = GetVariableSize(variable->getType()->getPointerElementType());
+			const auto laneInput = CreateGEP(batch, {ConstU32(0), ConstU32(6), CreateAdd(ConstU32(inputOffset * FRAGMENT_BATCH_SIZE), CreateMul(lane, ConstU32(size)))});
+			const auto shaderVariable = CreateBitCast(GetShaderVariable(batchContext, variable), bytePointerType);
+			CreateMemCpy(shaderVariable, 4, laneInput, 4, ConstU64(size));
+			inputOffset += size;
+		}
 	}
 
 	void CompileGetCurrentData()
@@ -1657,7 +2026,7 @@ protected:
 		SPIRV::SPIRVVariable* variable;
 		uint32_t arrayIndex;
 		std::tie(variable, arrayIndex) = outputLocations.at(index);
-		const auto value = shaderModuleBuilder->ConvertValue(variable, nullptr);
+		const auto value = GetShaderVariable(shaderContext, variable);
 		
 		if (arrayIndex < 0xFFFFFFF0)
 		{
@@ -1798,6 +2167,199 @@ protected:
 	}
 };
 
+class PipelineComputeCompiledModuleBuilder final : public BasePipelineCompiledModuleBuilder
+{
+public:
+	PipelineComputeCompiledModuleBuilder(const SPIRV::SPIRVModule* computeShader,
+	                                     const SPIRV::SPIRVFunction* entryPoint,
+	                                     const VkSpecializationInfo* specializationInfo) :
+		BasePipelineCompiledModuleBuilder{computeShader, entryPoint, specializationInfo, nullptr}
+	{
+	}
+
+	~PipelineComputeCompiledModuleBuilder() override = default;
+
+protected:
+	LLVMValueRef CompileMainFunctionImpl() override
+	{
+		CompileShader(ExecutionModelGLCompute, SHADER_LANE_COUNT);
+
+		const auto localSize = GetLocalSize();
+		const auto numberInvocations = localSize[0] * localSize[1] * localSize[2];
+
+		// Shaders with barriers need a context for every invocation of the workgroup, as they are suspended part way through
+		const auto controlBarrier = shaderModuleBuilder->hasControlBarrier();
+		GlobalVariable(LLVMInt32TypeInContext(context), true, LLVMExternalLinkage, ConstU32(controlBarrier ? numberInvocations : 1), "@contextCount");
+
+		// void main(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ, uint32_t firstGroup, uint32_t lastGroup, _Context* contexts)
+		std::array<LLVMTypeRef, 6> parameters
+		{
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMPointerType(shaderModuleBuilder->getContextType(), 0),
+		};
+		const auto functionType = LLVMFunctionType(LLVMVoidType(), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
+		const auto function = LLVMAddFunction(module, "@main", functionType);
+		LLVMSetLinkage(function, LLVMExternalLinkage);
+
+		const auto basicBlock = LLVMAppendBasicBlockInContext(context, function, "");
+		LLVMPositionBuilderAtEnd(builder, basicBlock);
+
+		const auto groupCountX = LLVMGetParam(function, 0);
+		const auto groupCountY = LLVMGetParam(function, 1);
+		const auto firstGroup = LLVMGetParam(function, 3);
+		const auto lastGroup = LLVMGetParam(function, 4);
+		const auto shaderContexts = LLVMGetParam(function, 5);
+
+		const auto localSizeVector = CreateVector(ConstU32(localSize[0]), ConstU32(localSize[1]), ConstU32(localSize[2]));
+		const auto groupCountXY = CreateMul(groupCountX, groupCountY);
+
+		CreateFor(function, firstGroup, lastGroup, ConstU32(1), [&](LLVMValueRef group, LLVMBasicBlockRef, LLVMBasicBlockRef)
+		{
+			// Decode the flat group index into its x, y, z workgroup
+			const auto groupZ = CreateUDiv(group, groupCountXY);
+			const auto groupRemainder = CreateURem(group, groupCountXY);
+			const auto groupY = CreateUDiv(groupRemainder, groupCountX);
+			const auto groupX = CreateURem(groupRemainder, groupCountX);
+			const auto workgroupId = CreateVector(groupX, groupY, groupZ);
+			const auto groupOffset = CreateMul(workgroupId, localSizeVector);
+
+			const auto laneCount = shaderModuleBuilder->getLaneCount();
+			if (laneCount)
+			{
+				// Each call of the shader runs the next laneCount invocations of the workgroup
+				CreateFor(function, ConstU32(0), ConstU32(numberInvocations), ConstU32(laneCount), [&](LLVMValueRef first, LLVMBasicBlockRef, LLVMBasicBlockRef)
+				{
+					for (auto i = 0u; i < laneCount; i++)
+					{
+						// Inactive lanes past the end of the workgroup get ids too, the mask stops the shader using them
+						const auto invocation = CreateAdd(first, ConstU32(i));
+						const auto localX = CreateURem(invocation, ConstU32(localSize[0]));
+						const auto localY = CreateURem(CreateUDiv(invocation, ConstU32(localSize[0])), ConstU32(localSize[1]));
+						const auto localZ = CreateUDiv(invocation, ConstU32(localSize[0] * localSize[1]));
+						CompileSetBuiltins(shaderContexts, workgroupId, groupOffset, CreateVector(localX, localY, localZ), ConstU32(i));
+					}
+					CreateCall(shaderEntryPoint, {CreateLaneMask(first, ConstU32(numberInvocations), laneCount), shaderContexts});
+				});
+				return;
+			}
+
+			CreateFor(function, ConstU32(0), ConstU32(localSize[2]), ConstU32(1), [&](LLVMValueRef localZ, LLVMBasicBlockRef, LLVMBasicBlockRef)
+			{
+				CreateFor(function, ConstU32(0), ConstU32(localSize[1]), ConstU32(1), [&](LLVMValueRef localY, LLVMBasicBlockRef, LLVMBasicBlockRef)
+				{
+					if (controlBarrier)
+					{
+						CreateFor(function, ConstU32(0), ConstU32(localSize[0]), ConstU32(1), [&](LLVMValueRef localX, LLVMBasicBlockRef, LLVMBasicBlockRef)
+						{
+							const auto invocation = CreateAdd(CreateMul(CreateAdd(CreateMul(localZ, ConstU32(localSize[1])), localY), ConstU32(localSize[0])), localX);
+							const auto shaderContext = CreateGEP(shaderContexts, std::vector<LLVMValueRef>{invocation});
+							CompileSetBuiltins(shaderContext, workgroupId, groupOffset, CreateVector(localX, localY, localZ));
+						});
+						return;
+					}
+
+					CreateFor(function, ConstU32(0), ConstU32(localSize[0]), ConstU32(1), [&](LLVMValueRef localX, LLVMBasicBlockRef, LLVMBasicBlockRef)
+					{
+						CompileSetBuiltins(shaderContexts, workgroupId, groupOffset, CreateVector(localX, localY, localZ));
+						CreateCall(shaderEntryPoint, {shaderContexts});
+					});
+				});
+			});
+
+			if (controlBarrier)
+			{
+				CompileRunWorkgroup(shaderContexts, numberInvocations);
+			}
+		});
+
+		LLVMBuildRetVoid(builder);
+
+		return function;
+	}
+
+private:
+	void CompileSetBuiltins(LLVMValueRef shaderContext, LLVMValueRef workgroupId, LLVMValueRef groupOffset, LLVMValueRef localInvocationId, LLVMValueRef lane = nullptr)
+	{
+		auto builtinInputAddress = CreateGEP(shaderContext, 0, shaderModuleBuilder->getBuiltinInputIndex());
+		if (lane)
+		{
+			builtinInputAddress = CreateGEP(builtinInputAddress, std::vector<LLVMValueRef>{ConstU32(0), lane});
+		}
+		CreateStore(CreateAdd(groupOffset, localInvocationId), CreateGEP(builtinInputAddress, 0, 0));
+		CreateStore(localInvocationId, CreateGEP(builtinInputAddress, 0, 1));
+		CreateStore(workgroupId, CreateGEP(builtinInputAddress, 0, 2));
+	}
+
+	LLVMValueRef CreateVector(LLVMValueRef x, LLVMValueRef y, LLVMValueRef z)
+	{
+		auto vector = LLVMGetUndef(LLVMVectorType(LLVMInt32TypeInContext(context), 3));
+		vector = CreateInsertElement(vector, x, ConstU32(0));
+		vector = CreateInsertElement(vector, y, ConstU32(1));
+		return CreateInsertElement(vector, z, ConstU32(2));
+	}
+
+	std::array<uint32_t, 3> GetLocalSize()
+	{
+		// A WorkgroupSize builtin takes precedence over the LocalSize execution mode
+		const auto workgroupSize = LLVMGetNamedGlobal(module, "@WorkgroupSize");
+		if (workgroupSize)
+		{
+			const auto value = LLVMGetInitializer(workgroupSize);
+			return
+			{
+				static_cast<uint32_t>(LLVMConstIntGetZExtValue(LLVMConstExtractElement(value, ConstU32(0)))),
+				static_cast<uint32_t>(LLVMConstIntGetZExtValue(LLVMConstExtractElement(value, ConstU32(1)))),
+				static_cast<uint32_t>(LLVMConstIntGetZExtValue(LLVMConstExtractElement(value, ConstU32(2)))),
+			};
+		}
+
+		if (entryPoint->getExecutionMode(SPIRV::SPIRVExecutionModeKind::ExecutionModeLocalSizeId))
+		{
+			TODO_ERROR();
+		}
+
+		const auto localSize = entryPoint->getExecutionMode(SPIRV::SPIRVExecutionModeKind::ExecutionModeLocalSize);
+		if (!localSize)
+		{
+			FATAL_ERROR();
+		}
+
+		const auto& literals = localSize->getLiterals();
+		return {literals[0], literals[1], literals[2]};
+	}
+
+	void CompileRunWorkgroup(LLVMValueRef shaderContexts, uint32_t numberInvocations)
+	{
+		// The host runs each invocation until it finishes or reaches a barrier, resuming them in turn until all have finished
+		auto runWorkgroup = LLVMGetNamedFunction(module, "@runWorkgroup");
+		if (!runWorkgroup)
+		{
+			std::array<LLVMTypeRef, 4> parameters
+			{
+				LLVMPointerType(LLVMInt8TypeInContext(context), 0),
+				LLVMPointerType(LLVMInt8TypeInContext(context), 0),
+				LLVMInt32TypeInContext(context),
+				LLVMInt64TypeInContext(context),
+			};
+			const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
+			runWorkgroup = LLVMAddFunction(module, "@runWorkgroup", functionType);
+		}
+
+		std::vector<LLVMValueRef> arguments
+		{
+			CreateBitCast(shaderEntryPoint, LLVMPointerType(LLVMInt8TypeInContext(context), 0)),
+			CreateBitCast(shaderContexts, LLVMPointerType(LLVMInt8TypeInContext(context), 0)),
+			ConstU32(numberInvocations),
+			ConstU64(LLVMABISizeOfType(jit->getDataLayout(), shaderModuleBuilder->getContextType())),
+		};
+		CreateCall(runWorkgroup, arguments);
+	}
+};
+
 CompiledModule* CompileVertexPipeline(CPJit* jit,
                                       const GraphicsPipelineStateStorage* state,
                                       const SPIRV::SPIRVModule* vertexShader,
@@ -1829,4 +2391,17 @@ CompiledModule* CompileFragmentPipeline(CPJit* jit,
 		state
 	};
 	return Compile(&builder, jit);
-}
\ No newline at end of file
+}
+CompiledModule* CompileComputePipeline(CPJit* jit,
+                                       const SPIRV::SPIRVModule* computeShader,
+                                       const SPIRV::SPIRVFunction* entryPoint,
+                                       const VkSpecializationInfo* specializationInfo)
+{
+	PipelineComputeCompiledModuleBuilder builder
+	{
+		computeShader,
+		entryPoint,
+		specializationInfo,
+	};
+	return Compile(&builder, jit);
+}
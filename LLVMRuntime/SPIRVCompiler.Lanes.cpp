@@ -0,0 +1,1225 @@
+#include "SPIRVCompiler.h"
+
+#include "CompiledModuleBuilder.h"
+#include "Compilers.h"
+#include "Jit.h"
+
+#include <Base.h>
+#include <SPIRVInstruction.h>
+#include <SPIRVModule.h>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+
+#include <algorithm>
+
+// Lane widened functions run several invocations of a vertex or compute shader in one call, ISPC style. Values that are the same for every lane
+// stay scalar, the rest hold an element per lane. The blocks of the function are run in order, each with the mask of the lanes that reached it, and
+// lanes sent back to an earlier block, such as the header of a loop, run it again before anything after.
+
+bool SPIRVCompiledModuleBuilder::SupportsLanes() const
+{
+	if (executionModel != ExecutionModelVertex && executionModel != ExecutionModelGLCompute)
+	{
+		return false;
+	}
+
+	// TODO: Calls, which would need the mask passed down, and barriers, which would need each lane to be able to suspend on its own
+	if (spirvModule->getNumFunctions() != 1)
+	{
+		return false;
+	}
+
+	const auto spirvFunction = spirvModule->getFunction(0);
+	for (auto i = 0u; i < spirvFunction->getNumBasicBlock(); i++)
+	{
+		const auto spirvBasicBlock = spirvFunction->getBasicBlock(i);
+		for (auto j = 0u; j < spirvBasicBlock->getNumInst(); j++)
+		{
+			switch (spirvBasicBlock->getInst(j)->getOpCode())
+			{
+			case OpFunctionCall:
+			case OpControlBarrier:
+			case OpKill:
+			case OpReturnValue:
+			case OpPtrAccessChain:
+			case OpInBoundsPtrAccessChain:
+				return false;
+
+			default:
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+bool SPIRVCompiledModuleBuilder::IsLaneVariable(const SPIRV::SPIRVVariable* variable)
+{
+	switch (variable->getStorageClass())
+	{
+	case StorageClassInput:
+	case StorageClassOutput:
+	case StorageClassPrivate:
+	case StorageClassFunction:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+LLVMTypeRef SPIRVCompiledModuleBuilder::GetLaneType(LLVMTypeRef type)
+{
+	switch (LLVMGetTypeKind(type))
+	{
+	case LLVMVectorTypeKind:
+		// The components are kept apart, so component k of lane l is element k * laneCount + l
+		return LLVMVectorType(LLVMGetElementType(type), LLVMGetVectorSize(type) * laneCount);
+
+	case LLVMIntegerTypeKind:
+	case LLVMHalfTypeKind:
+	case LLVMFloatTypeKind:
+	case LLVMDoubleTypeKind:
+	case LLVMPointerTypeKind:
+		return LLVMVectorType(type, laneCount);
+
+	default:
+		return LLVMArrayType(type, laneCount);
+	}
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::GetLaneIndices()
+{
+	std::vector<LLVMValueRef> indices(laneCount);
+	for (auto lane = 0u; lane < laneCount; lane++)
+	{
+		indices[lane] = ConstU32(lane);
+	}
+	return LLVMConstVector(indices.data(), laneCount);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::CreateLaneAlloca(LLVMTypeRef type)
+{
+	// Cleared once per call, so lanes that never wrote an element read zero rather than undefined values
+	LLVMPositionBuilder(builder, lanePrologue, LLVMGetFirstInstruction(lanePrologue));
+	const auto alloca = CreateAlloca(type);
+	LLVMPositionBuilderAtEnd(builder, lanePrologue);
+	CreateStore(LLVMConstNull(type), alloca);
+	LLVMPositionBuilderAtEnd(builder, currentBlock);
+	return alloca;
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::ShuffleLanes(LLVMValueRef value1, LLVMValueRef value2, const std::vector<uint32_t>& indices)
+{
+	std::vector<LLVMValueRef> mask(indices.size());
+	for (auto i = 0u; i < indices.size(); i++)
+	{
+		mask[i] = ConstU32(indices[i]);
+	}
+	return CreateShuffleVector(value1, value2 ? value2 : LLVMGetUndef(LLVMTypeOf(value1)), LLVMConstVector(mask.data(), static_cast<uint32_t>(mask.size())));
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::WidenLanes(LLVMValueRef value)
+{
+	const auto type = LLVMTypeOf(value);
+	switch (LLVMGetTypeKind(type))
+	{
+	case LLVMVectorTypeKind:
+		{
+			std::vector<uint32_t> indices(LLVMGetVectorSize(type) * laneCount);
+			for (auto i = 0u; i < indices.size(); i++)
+			{
+				indices[i] = i / laneCount;
+			}
+			return ShuffleLanes(value, nullptr, indices);
+		}
+
+	case LLVMIntegerTypeKind:
+	case LLVMHalfTypeKind:
+	case LLVMFloatTypeKind:
+	case LLVMDoubleTypeKind:
+	case LLVMPointerTypeKind:
+		{
+			const auto vector = CreateInsertElement(LLVMGetUndef(LLVMVectorType(type, laneCount)), value, ConstU32(0));
+			return ShuffleLanes(vector, nullptr, std::vector<uint32_t>(laneCount));
+		}
+
+	default:
+		{
+			auto llvmValue = LLVMGetUndef(LLVMArrayType(type, laneCount));
+			for (auto lane = 0u; lane < laneCount; lane++)
+			{
+				llvmValue = CreateInsertValue(llvmValue, value, lane);
+			}
+			return llvmValue;
+		}
+	}
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::ExtractLane(LLVMValueRef value, uint32_t lane)
+{
+	const auto type = LLVMTypeOf(value);
+	if (LLVMGetTypeKind(type) == LLVMArrayTypeKind)
+	{
+		return CreateExtractValue(value, lane);
+	}
+
+	const auto components = LLVMGetVectorSize(type) / laneCount;
+	if (components == 1)
+	{
+		return CreateExtractElement(value, ConstU32(lane));
+	}
+
+	std::vector<uint32_t> indices(components);
+	for (auto i = 0u; i < components; i++)
+	{
+		indices[i] = i * laneCount + lane;
+	}
+	return ShuffleLanes(value, nullptr, indices);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::InsertLane(LLVMValueRef value, LLVMValueRef element, uint32_t lane)
+{
+	const auto type = LLVMTypeOf(value);
+	if (LLVMGetTypeKind(type) == LLVMArrayTypeKind)
+	{
+		return CreateInsertValue(value, element, lane);
+	}
+
+	const auto components = LLVMGetVectorSize(type) / laneCount;
+	if (components == 1)
+	{
+		return CreateInsertElement(value, element, ConstU32(lane));
+	}
+
+	for (auto i = 0u; i < components; i++)
+	{
+		value = CreateInsertElement(value, CreateExtractElement(element, ConstU32(i)), ConstU32(i * laneCount + lane));
+	}
+	return value;
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::ExtractLaneComponent(LLVMValueRef value, uint32_t component)
+{
+	if (LLVMGetVectorSize(LLVMTypeOf(value)) == laneCount)
+	{
+		assert(component == 0);
+		return value;
+	}
+
+	std::vector<uint32_t> indices(laneCount);
+	for (auto lane = 0u; lane < laneCount; lane++)
+	{
+		indices[lane] = component * laneCount + lane;
+	}
+	return ShuffleLanes(value, nullptr, indices);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::CombineLaneComponents(const std::vector<LLVMValueRef>& components)
+{
+	auto llvmValue = components[0];
+	for (auto i = 1u; i < components.size(); i++)
+	{
+		// Both sides of a shuffle must have the same type, so the next component is repeated out to the length of what is already combined
+		const auto length = i * laneCount;
+		std::vector<uint32_t> padding(length);
+		for (auto j = 0u; j < length; j++)
+		{
+			padding[j] = j % laneCount;
+		}
+		const auto component = i == 1 ? components[i] : ShuffleLanes(components[i], nullptr, padding);
+
+		std::vector<uint32_t> indices(length + laneCount);
+		for (auto j = 0u; j < indices.size(); j++)
+		{
+			indices[j] = j;
+		}
+		llvmValue = ShuffleLanes(llvmValue, component, indices);
+	}
+	return llvmValue;
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::RepeatLanes(LLVMValueRef value, uint32_t count)
+{
+	if (count == 1)
+	{
+		return value;
+	}
+
+	std::vector<uint32_t> indices(count * laneCount);
+	for (auto i = 0u; i < indices.size(); i++)
+	{
+		indices[i] = i % laneCount;
+	}
+	return ShuffleLanes(value, nullptr, indices);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::SelectLanes(LLVMValueRef mask, LLVMValueRef thenValue, LLVMValueRef elseValue)
+{
+	const auto type = LLVMTypeOf(thenValue);
+	if (LLVMGetTypeKind(type) == LLVMArrayTypeKind)
+	{
+		auto llvmValue = elseValue;
+		for (auto lane = 0u; lane < laneCount; lane++)
+		{
+			const auto element = CreateSelect(CreateExtractElement(mask, ConstU32(lane)), CreateExtractValue(thenValue, lane), CreateExtractValue(elseValue, lane));
+			llvmValue = CreateInsertValue(llvmValue, element, lane);
+		}
+		return llvmValue;
+	}
+
+	// A mask with one element per lane applies to every component
+	const auto maskSize = LLVMGetVectorSize(LLVMTypeOf(mask));
+	if (maskSize != LLVMGetVectorSize(type))
+	{
+		assert(maskSize == laneCount);
+		mask = RepeatLanes(mask, LLVMGetVectorSize(type) / laneCount);
+	}
+	return CreateSelect(mask, thenValue, elseValue);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::AnyLanes(LLVMValueRef mask)
+{
+	const auto maskBitsType = LLVMIntTypeInContext(context, laneCount);
+	return CreateICmpNE(CreateBitCast(mask, maskBitsType), LLVMConstNull(maskBitsType));
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::GatherLanes(LLVMValueRef pointers)
+{
+	const auto type = LLVMGetElementType(LLVMGetElementType(LLVMTypeOf(pointers)));
+	if (LLVMGetTypeKind(type) == LLVMVectorTypeKind)
+	{
+		std::vector<LLVMValueRef> components(LLVMGetVectorSize(type));
+		for (auto i = 0u; i < components.size(); i++)
+		{
+			components[i] = GatherLanes(CreateInBoundsGEP(pointers, std::vector<LLVMValueRef>{ConstU32(0), ConstU32(i)}));
+		}
+		return CombineLaneComponents(components);
+	}
+
+	const auto resultType = LLVMVectorType(type, laneCount);
+	std::array<LLVMTypeRef, 2> overloadTypes
+	{
+		resultType,
+		LLVMTypeOf(pointers),
+	};
+	const auto declaration = LLVMGetIntrinsicDeclaration(module, Intrinsics::masked_gather, overloadTypes.data(), overloadTypes.size());
+	std::array<LLVMValueRef, 4> arguments
+	{
+		pointers,
+		ConstU32(LLVMABIAlignmentOfType(jit->getDataLayout(), type)),
+		laneMask,
+		LLVMGetUndef(resultType),
+	};
+	return LLVMBuildCall(builder, declaration, arguments.data(), static_cast<uint32_t>(arguments.size()), "");
+}
+
+void SPIRVCompiledModuleBuilder::ScatterLanes(LLVMValueRef value, LLVMValueRef pointers)
+{
+	const auto type = LLVMGetElementType(LLVMGetElementType(LLVMTypeOf(pointers)));
+	if (LLVMGetTypeKind(type) == LLVMVectorTypeKind)
+	{
+		for (auto i = 0u; i < LLVMGetVectorSize(type); i++)
+		{
+			ScatterLanes(ExtractLaneComponent(value, i), CreateInBoundsGEP(pointers, std::vector<LLVMValueRef>{ConstU32(0), ConstU32(i)}));
+		}
+		return;
+	}
+
+	std::array<LLVMTypeRef, 2> overloadTypes
+	{
+		LLVMTypeOf(value),
+		LLVMTypeOf(pointers),
+	};
+	const auto declaration = LLVMGetIntrinsicDeclaration(module, Intrinsics::masked_scatter, overloadTypes.data(), overloadTypes.size());
+	std::array<LLVMValueRef, 4> arguments
+	{
+		value,
+		pointers,
+		ConstU32(LLVMABIAlignmentOfType(jit->getDataLayout(), type)),
+		laneMask,
+	};
+	LLVMBuildCall(builder, declaration, arguments.data(), static_cast<uint32_t>(arguments.size()), "");
+}
+
+bool SPIRVCompiledModuleBuilder::IsLaneVectorisable(LLVMTypeRef type)
+{
+	if (LLVMGetTypeKind(type) == LLVMVectorTypeKind)
+	{
+		type = LLVMGetElementType(type);
+	}
+
+	switch (LLVMGetTypeKind(type))
+	{
+	case LLVMIntegerTypeKind:
+	case LLVMHalfTypeKind:
+	case LLVMFloatTypeKind:
+	case LLVMDoubleTypeKind:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+SPIRVCompiledModuleBuilder::LaneValue SPIRVCompiledModuleBuilder::ConvertLaneVariable(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction)
+{
+	// Each lane's element of a lane variable is pointed to by the matching element of a vector of pointers
+	if (spirvValue->isVariable())
+	{
+		const auto variable = static_cast<const SPIRV::SPIRVVariable*>(spirvValue);
+		if (variable->hasDecorate(DecorationBuiltIn))
+		{
+			const auto builtin = static_cast<BuiltIn>(*variable->getDecorate(DecorationBuiltIn).begin());
+			for (const auto mapping : builtinInputMapping)
+			{
+				if (mapping.first == builtin)
+				{
+					return {CreateInBoundsGEP(GetContextMember(currentFunction, BUILTIN_INPUT_INDEX), {ConstU32(0), GetLaneIndices(), ConstU32(mapping.second)}), true};
+				}
+			}
+
+			for (const auto mapping : builtinOutputMapping)
+			{
+				if (mapping.first == builtin)
+				{
+					return {CreateInBoundsGEP(GetContextMember(currentFunction, BUILTIN_OUTPUT_INDEX), {ConstU32(0), GetLaneIndices(), ConstU32(mapping.second)}), true};
+				}
+			}
+
+			TODO_ERROR();
+		}
+
+		if (variable->getType()->getPointerElementType()->hasMemberDecorate(DecorationBuiltIn))
+		{
+			const auto index = variable->getStorageClass() == StorageClassInput ? BUILTIN_INPUT_INDEX : BUILTIN_OUTPUT_INDEX;
+			return {CreateInBoundsGEP(GetContextMember(currentFunction, index), {ConstU32(0), GetLaneIndices()}), true};
+		}
+
+		const auto contextMember = contextMapping.find(variable->getId());
+		if (contextMember != contextMapping.end() && IsLaneVariable(variable))
+		{
+			return {CreateInBoundsGEP(GetContextMember(currentFunction, contextMember->second), {ConstU32(0), GetLaneIndices()}), true};
+		}
+	}
+
+	return {ConvertValue(spirvValue, currentFunction), false};
+}
+
+SPIRVCompiledModuleBuilder::LaneValue SPIRVCompiledModuleBuilder::GetLaneValue(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction)
+{
+	const auto laneValue = laneValues.find(spirvValue->getId());
+	if (laneValue == laneValues.end())
+	{
+		// Anything not defined in the function is the same wherever it is used, so is converted once in the prologue
+		const auto insertBlock = currentBlock;
+		currentBlock = lanePrologue;
+		LLVMPositionBuilderAtEnd(builder, lanePrologue);
+		const auto llvmValue = ConvertLaneVariable(spirvValue, currentFunction);
+		currentBlock = insertBlock;
+		LLVMPositionBuilderAtEnd(builder, currentBlock);
+		return laneValues[spirvValue->getId()] = llvmValue;
+	}
+
+	// A block can be skipped when none of its lanes are active, so its values do not dominate later blocks. Each lane that ran the definition
+	// stores its element to a slot instead, which other blocks read. Values of the entry block need no slot, as it always runs.
+	const auto definition = laneValue->second;
+	const auto spirvBasicBlock = spirvValue->isInst() ? static_cast<const SPIRV::SPIRVInstruction*>(spirvValue)->getParent() : nullptr;
+	if (spirvBasicBlock == nullptr || spirvBasicBlock == laneBlock || laneBlockIndices.at(spirvBasicBlock) == 0 || !LLVMIsAInstruction(definition.value))
+	{
+		return definition;
+	}
+
+	auto slot = laneSlots.find(spirvValue->getId());
+	if (slot == laneSlots.end())
+	{
+		const auto alloca = CreateLaneAlloca(definition.varying ? LLVMTypeOf(definition.value) : GetLaneType(LLVMTypeOf(definition.value)));
+
+		auto next = LLVMGetNextInstruction(definition.value);
+		while (LLVMIsAPHINode(next))
+		{
+			next = LLVMGetNextInstruction(next);
+		}
+		LLVMPositionBuilderBefore(builder, next);
+		const auto llvmValue = definition.varying ? definition.value : WidenLanes(definition.value);
+		CreateStore(SelectLanes(laneActiveMasks.at(spirvBasicBlock), llvmValue, CreateLoad(alloca)), alloca);
+		LLVMPositionBuilderAtEnd(builder, currentBlock);
+
+		slot = laneSlots.emplace(spirvValue->getId(), alloca).first;
+	}
+	return {CreateLoad(slot->second), true};
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::GetWideValue(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction)
+{
+	const auto laneValue = GetLaneValue(spirvValue, currentFunction);
+	return laneValue.varying ? laneValue.value : WidenLanes(laneValue.value);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::ConvertLaneOperand(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction)
+{
+	// Operands are looked up as usual, then given the form the instruction being converted expects
+	const auto operands = laneOperands;
+	laneOperands = LaneOperands::None;
+	const auto laneValue = GetLaneValue(spirvValue, currentFunction);
+	laneOperands = operands;
+
+	switch (operands)
+	{
+	case LaneOperands::Uniform:
+		assert(!laneValue.varying);
+		return laneValue.value;
+
+	case LaneOperands::Widened:
+		return laneValue.varying ? laneValue.value : WidenLanes(laneValue.value);
+
+	case LaneOperands::Lane:
+		return laneValue.varying ? ExtractLane(laneValue.value, laneOperandIndex) : laneValue.value;
+
+	default:
+		TODO_ERROR();
+	}
+}
+
+bool SPIRVCompiledModuleBuilder::IsUniform(const std::vector<SPIRV::SPIRVValue*>& spirvValues, LLVMValueRef currentFunction)
+{
+	for (const auto spirvValue : spirvValues)
+	{
+		if (GetLaneValue(spirvValue, currentFunction).varying)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction, LaneOperands operands,
+                                                            uint32_t lane)
+{
+	laneOperands = operands;
+	laneOperandIndex = lane;
+	const auto llvmValue = ConvertInstruction(instruction, currentFunction);
+	laneOperands = LaneOperands::None;
+	return llvmValue;
+}
+
+SPIRVCompiledModuleBuilder::LaneValue SPIRVCompiledModuleBuilder::ScalariseLanes(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction, bool guarded)
+{
+	const auto hasResult = [](LLVMValueRef llvmValue)
+	{
+		return llvmValue && LLVMGetTypeKind(LLVMTypeOf(llvmValue)) != LLVMVoidTypeKind;
+	};
+
+	LLVMValueRef result = nullptr;
+	for (auto lane = 0u; lane < laneCount; lane++)
+	{
+		if (!guarded)
+		{
+			const auto llvmValue = ConvertInstruction(instruction, currentFunction, LaneOperands::Lane, lane);
+			if (hasResult(llvmValue))
+			{
+				result = InsertLane(result ? result : LLVMGetUndef(GetLaneType(LLVMTypeOf(llvmValue))), llvmValue, lane);
+			}
+			continue;
+		}
+
+		// Inactive lanes must not see any side effects, so each lane runs the instruction behind its own branch
+		const auto skipBlock = currentBlock;
+		const auto activeBlock = LLVMAppendBasicBlockInContext(context, currentFunction, "lane-active");
+		const auto nextBlock = LLVMAppendBasicBlockInContext(context, currentFunction, "lane-next");
+		CreateCondBr(CreateExtractElement(laneMask, ConstU32(lane)), activeBlock, nextBlock);
+
+		currentBlock = activeBlock;
+		LLVMPositionBuilderAtEnd(builder, activeBlock);
+		const auto llvmValue = ConvertInstruction(instruction, currentFunction, LaneOperands::Lane, lane);
+		LLVMValueRef previous = nullptr;
+		LLVMValueRef inserted = nullptr;
+		if (hasResult(llvmValue))
+		{
+			previous = result ? result : LLVMGetUndef(GetLaneType(LLVMTypeOf(llvmValue)));
+			inserted = InsertLane(previous, llvmValue, lane);
+		}
+		auto activeEndBlock = LLVMGetInsertBlock(builder);
+		CreateBr(nextBlock);
+
+		currentBlock = nextBlock;
+		LLVMPositionBuilderAtEnd(builder, nextBlock);
+		if (inserted)
+		{
+			auto skipBasicBlock = skipBlock;
+			result = CreatePhi(LLVMTypeOf(inserted));
+			LLVMAddIncoming(result, &inserted, &activeEndBlock, 1);
+			LLVMAddIncoming(result, &previous, &skipBasicBlock, 1);
+		}
+	}
+	return {result, true};
+}
+
+SPIRVCompiledModuleBuilder::LaneValue SPIRVCompiledModuleBuilder::ConvertLaneOperation(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction,
+                                                                                       const std::vector<SPIRV::SPIRVValue*>& operands, bool elementwise,
+                                                                                       bool guarded)
+{
+	if (IsUniform(operands, currentFunction))
+	{
+		return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+	}
+
+	if (elementwise)
+	{
+		return {ConvertInstruction(instruction, currentFunction, LaneOperands::Widened), true};
+	}
+
+	return ScalariseLanes(instruction, currentFunction, guarded);
+}
+
+SPIRVCompiledModuleBuilder::LaneValue SPIRVCompiledModuleBuilder::ConvertLaneInstruction(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction)
+{
+	switch (instruction->getOpCode())
+	{
+	case OpNop:
+	case OpLoopMerge:
+	case OpSelectionMerge:
+	case OpLabel:
+	case OpNoLine:
+		return {};
+
+	case OpVariable:
+		{
+			// Function variables get an element per lane, like the lane variables of the context
+			const auto variable = reinterpret_cast<SPIRV::SPIRVVariable*>(instruction);
+			const auto storage = CreateLaneAlloca(LLVMArrayType(GetVariableType(variable), laneCount));
+			if (variable->getInitializer())
+			{
+				const auto initialiser = GetLaneValue(variable->getInitializer(), currentFunction);
+				assert(!initialiser.varying);
+				for (auto lane = 0u; lane < laneCount; lane++)
+				{
+					CreateStore(initialiser.value, CreateInBoundsGEP(storage, 0, lane));
+				}
+			}
+			return {CreateInBoundsGEP(storage, {ConstU32(0), GetLaneIndices()}), true};
+		}
+
+	case OpPhi:
+		return {CreateLoad(lanePhiSlots.at(instruction->getId())), true};
+
+	case OpLoad:
+		{
+			const auto load = reinterpret_cast<SPIRV::SPIRVLoad*>(instruction);
+			const auto pointer = GetLaneValue(load->getSrc(), currentFunction);
+			if (!pointer.varying)
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			if (IsLaneVectorisable(LLVMGetElementType(LLVMGetElementType(LLVMTypeOf(pointer.value)))))
+			{
+				return {GatherLanes(pointer.value), true};
+			}
+			return ScalariseLanes(instruction, currentFunction, true);
+		}
+
+	case OpStore:
+		{
+			const auto store = reinterpret_cast<SPIRV::SPIRVStore*>(instruction);
+			const auto pointer = GetLaneValue(store->getDst(), currentFunction);
+			const auto value = GetLaneValue(store->getSrc(), currentFunction);
+			if (!pointer.varying && !value.varying)
+			{
+				ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform);
+			}
+			else if (pointer.varying && IsLaneVectorisable(LLVMGetElementType(LLVMGetElementType(LLVMTypeOf(pointer.value)))))
+			{
+				ScatterLanes(value.varying ? value.value : WidenLanes(value.value), pointer.value);
+			}
+			else
+			{
+				// Lanes store in order, so the last active lane wins when they share a pointer
+				ScalariseLanes(instruction, currentFunction, true);
+			}
+			return {};
+		}
+
+	case OpAccessChain:
+	case OpInBoundsAccessChain:
+		{
+			const auto accessChain = reinterpret_cast<SPIRV::SPIRVAccessChainBase*>(instruction);
+			auto operands = accessChain->getIndices();
+			operands.push_back(accessChain->getBase());
+			return ConvertLaneOperation(instruction, currentFunction, operands, false);
+		}
+
+	case OpCopyObject:
+		return GetLaneValue(reinterpret_cast<SPIRV::SPIRVCopyObject*>(instruction)->getOperand(), currentFunction);
+
+	case OpVectorExtractDynamic:
+		{
+			const auto vectorExtractDynamic = reinterpret_cast<SPIRV::SPIRVVectorExtractDynamic*>(instruction);
+			return ConvertLaneOperation(instruction, currentFunction, {vectorExtractDynamic->getVector(), vectorExtractDynamic->getIndex()}, false);
+		}
+
+	case OpVectorInsertDynamic:
+		{
+			const auto vectorInsertDynamic = reinterpret_cast<SPIRV::SPIRVVectorInsertDynamic*>(instruction);
+			return ConvertLaneOperation(instruction, currentFunction,
+			                            {vectorInsertDynamic->getVector(), vectorInsertDynamic->getComponent(), vectorInsertDynamic->getIndex()}, false);
+		}
+
+	case OpVectorShuffle:
+		{
+			const auto vectorShuffle = reinterpret_cast<SPIRV::SPIRVVectorShuffle*>(instruction);
+			if (IsUniform({vectorShuffle->getVector1(), vectorShuffle->getVector2()}, currentFunction))
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			const auto vector1 = GetWideValue(vectorShuffle->getVector1(), currentFunction);
+			const auto vector2 = GetWideValue(vectorShuffle->getVector2(), currentFunction);
+			const auto vector1Size = vectorShuffle->getVector1()->getType()->getVectorComponentCount();
+			std::vector<LLVMValueRef> components{};
+			for (const auto component : vectorShuffle->getComponents())
+			{
+				// Undefined components can take any value
+				if (component == 0xFFFFFFFF)
+				{
+					components.push_back(ExtractLaneComponent(vector1, 0));
+				}
+				else if (component < vector1Size)
+				{
+					components.push_back(ExtractLaneComponent(vector1, component));
+				}
+				else
+				{
+					components.push_back(ExtractLaneComponent(vector2, component - vector1Size));
+				}
+			}
+			return {CombineLaneComponents(components), true};
+		}
+
+	case OpCompositeConstruct:
+		{
+			const auto compositeConstruct = reinterpret_cast<SPIRV::SPIRVCompositeConstruct*>(instruction);
+			const auto constituents = compositeConstruct->getConstituents();
+			if (IsUniform(constituents, currentFunction))
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			if (!compositeConstruct->getType()->isTypeVector())
+			{
+				return ScalariseLanes(instruction, currentFunction, false);
+			}
+
+			std::vector<LLVMValueRef> components{};
+			for (const auto constituent : constituents)
+			{
+				const auto llvmValue = GetWideValue(constituent, currentFunction);
+				const auto count = constituent->getType()->isTypeVector() ? constituent->getType()->getVectorComponentCount() : 1;
+				for (auto i = 0u; i < count; i++)
+				{
+					components.push_back(ExtractLaneComponent(llvmValue, i));
+				}
+			}
+			return {CombineLaneComponents(components), true};
+		}
+
+	case OpCompositeExtract:
+		{
+			const auto compositeExtract = reinterpret_cast<SPIRV::SPIRVCompositeExtract*>(instruction);
+			const auto composite = GetLaneValue(compositeExtract->getComposite(), currentFunction);
+			if (!composite.varying)
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			if (compositeExtract->getComposite()->getType()->isTypeVector())
+			{
+				return {ExtractLaneComponent(composite.value, compositeExtract->getIndices()[0]), true};
+			}
+			return ScalariseLanes(instruction, currentFunction, false);
+		}
+
+	case OpCompositeInsert:
+		{
+			const auto compositeInsert = reinterpret_cast<SPIRV::SPIRVCompositeInsert*>(instruction);
+			if (IsUniform({compositeInsert->getObject(), compositeInsert->getComposite()}, currentFunction))
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			const auto compositeType = compositeInsert->getComposite()->getType();
+			if (!compositeType->isTypeVector())
+			{
+				return ScalariseLanes(instruction, currentFunction, false);
+			}
+
+			const auto composite = GetWideValue(compositeInsert->getComposite(), currentFunction);
+			std::vector<LLVMValueRef> components(compositeType->getVectorComponentCount());
+			for (auto i = 0u; i < components.size(); i++)
+			{
+				components[i] = i == compositeInsert->getIndices()[0]
+					                ? GetWideValue(compositeInsert->getObject(), currentFunction)
+					                : ExtractLaneComponent(composite, i);
+			}
+			return {CombineLaneComponents(components), true};
+		}
+
+	case OpConvertFToU:
+	case OpConvertFToS:
+	case OpConvertSToF:
+	case OpConvertUToF:
+	case OpUConvert:
+	case OpSConvert:
+	case OpFConvert:
+	case OpBitcast:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			const auto operand = GetLaneValue(op->getOperand(0), currentFunction);
+			if (!operand.varying)
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			const auto type = GetLaneType(GetType(op->getType()));
+			switch (instruction->getOpCode())
+			{
+			case OpConvertFToU:
+				return {CreateFPToUI(operand.value, type), true};
+
+			case OpConvertFToS:
+				return {CreateFPToSI(operand.value, type), true};
+
+			case OpConvertSToF:
+				return {CreateSIToFP(operand.value, type), true};
+
+			case OpConvertUToF:
+				return {CreateUIToFP(operand.value, type), true};
+
+			case OpUConvert:
+				return {CreateZExtOrTrunc(operand.value, type), true};
+
+			case OpSConvert:
+				return {CreateSExtOrTrunc(operand.value, type), true};
+
+			case OpFConvert:
+				return {CreateFPExtOrTrunc(operand.value, type), true};
+
+			default:
+				// Only a bitcast that keeps the number of components keeps each lane in its own elements
+				if (LLVMGetTypeKind(LLVMTypeOf(operand.value)) == LLVMVectorTypeKind && LLVMGetVectorSize(LLVMTypeOf(operand.value)) == LLVMGetVectorSize(type))
+				{
+					return {CreateBitCast(operand.value, type), true};
+				}
+				return ScalariseLanes(instruction, currentFunction, false);
+			}
+		}
+
+	case OpSNegate:
+	case OpFNegate:
+	case OpLogicalNot:
+	case OpNot:
+	case OpBitReverse:
+	case OpBitCount:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			return ConvertLaneOperation(instruction, currentFunction, {op->getOperand(0)}, true);
+		}
+
+	case OpIAdd:
+	case OpFAdd:
+	case OpISub:
+	case OpFSub:
+	case OpIMul:
+	case OpFMul:
+	case OpFDiv:
+	case OpFRem:
+	case OpFMod:
+	case OpLogicalOr:
+	case OpLogicalAnd:
+	case OpIEqual:
+	case OpLogicalEqual:
+	case OpINotEqual:
+	case OpLogicalNotEqual:
+	case OpUGreaterThan:
+	case OpSGreaterThan:
+	case OpUGreaterThanEqual:
+	case OpSGreaterThanEqual:
+	case OpULessThan:
+	case OpSLessThan:
+	case OpULessThanEqual:
+	case OpSLessThanEqual:
+	case OpFOrdEqual:
+	case OpFUnordEqual:
+	case OpFOrdNotEqual:
+	case OpFUnordNotEqual:
+	case OpFOrdLessThan:
+	case OpFUnordLessThan:
+	case OpFOrdGreaterThan:
+	case OpFUnordGreaterThan:
+	case OpFOrdLessThanEqual:
+	case OpFUnordLessThanEqual:
+	case OpFOrdGreaterThanEqual:
+	case OpFUnordGreaterThanEqual:
+	case OpShiftRightLogical:
+	case OpShiftRightArithmetic:
+	case OpShiftLeftLogical:
+	case OpBitwiseOr:
+	case OpBitwiseXor:
+	case OpBitwiseAnd:
+		{
+			const auto op = static_cast<SPIRV::SPIRVBinary*>(instruction);
+			return ConvertLaneOperation(instruction, currentFunction, {op->getOperand(0), op->getOperand(1)}, true);
+		}
+
+	case OpUDiv:
+	case OpSDiv:
+	case OpUMod:
+	case OpSRem:
+	case OpSMod:
+		{
+			const auto op = static_cast<SPIRV::SPIRVBinary*>(instruction);
+			if (IsUniform({op->getOperand(0), op->getOperand(1)}, currentFunction))
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			// Inactive lanes can hold anything, so they divide by one rather than risk dividing by zero
+			const auto left = GetWideValue(op->getOperand(0), currentFunction);
+			auto right = GetWideValue(op->getOperand(1), currentFunction);
+			const auto rightType = LLVMTypeOf(right);
+			std::vector<LLVMValueRef> ones(LLVMGetVectorSize(rightType), LLVMConstInt(LLVMGetElementType(rightType), 1, false));
+			right = SelectLanes(laneMask, right, LLVMConstVector(ones.data(), static_cast<uint32_t>(ones.size())));
+			switch (instruction->getOpCode())
+			{
+			case OpUDiv:
+				return {CreateUDiv(left, right), true};
+
+			case OpSDiv:
+				return {CreateSDiv(left, right), true};
+
+			case OpUMod:
+				return {CreateURem(left, right), true};
+
+			case OpSRem:
+				return {CreateSRem(left, right), true};
+
+			default:
+				return {CreateSub(left, CreateMul(right, CreateSDiv(left, right))), true};
+			}
+		}
+
+	case OpSelect:
+		{
+			const auto select = reinterpret_cast<SPIRV::SPIRVSelect*>(instruction);
+			if (IsUniform({select->getCondition(), select->getTrueValue(), select->getFalseValue()}, currentFunction))
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			return {
+				SelectLanes(GetWideValue(select->getCondition(), currentFunction),
+				            GetWideValue(select->getTrueValue(), currentFunction),
+				            GetWideValue(select->getFalseValue(), currentFunction)),
+				true
+			};
+		}
+
+	case OpVectorTimesScalar:
+		{
+			const auto vectorTimesScalar = reinterpret_cast<SPIRV::SPIRVVectorTimesScalar*>(instruction);
+			if (IsUniform({vectorTimesScalar->getVector(), vectorTimesScalar->getScalar()}, currentFunction))
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			const auto vector = GetWideValue(vectorTimesScalar->getVector(), currentFunction);
+			const auto scalar = GetWideValue(vectorTimesScalar->getScalar(), currentFunction);
+			return {CreateFMul(vector, RepeatLanes(scalar, LLVMGetVectorSize(LLVMTypeOf(vector)) / laneCount)), true};
+		}
+
+	case OpMatrixTimesVector:
+		{
+			const auto matrixTimesVector = reinterpret_cast<SPIRV::SPIRVMatrixTimesVector*>(instruction);
+			const auto matrix = GetLaneValue(matrixTimesVector->getMatrix(), currentFunction);
+			const auto vector = GetLaneValue(matrixTimesVector->getVector(), currentFunction);
+			if (!matrix.varying && !vector.varying)
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			if (matrix.varying)
+			{
+				return ScalariseLanes(instruction, currentFunction, false);
+			}
+
+			// Each column of the shared matrix is scaled by the matching component of every lane's vector
+			const auto matrixType = LLVMTypeOf(matrix.value);
+			const auto rows = LLVMGetVectorSize(LLVMStructGetTypeAtIndex(matrixType, 0));
+			LLVMValueRef llvmValue = nullptr;
+			for (auto column = 0u; column < LLVMCountStructElementTypes(matrixType); column++)
+			{
+				const auto product = CreateFMul(WidenLanes(CreateExtractValue(matrix.value, column)), RepeatLanes(ExtractLaneComponent(vector.value, column), rows));
+				llvmValue = llvmValue ? CreateFAdd(llvmValue, product) : product;
+			}
+			return {llvmValue, true};
+		}
+
+	case OpDot:
+		{
+			const auto dot = reinterpret_cast<SPIRV::SPIRVDot*>(instruction);
+			if (IsUniform({dot->getOperand(0), dot->getOperand(1)}, currentFunction))
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			const auto product = CreateFMul(GetWideValue(dot->getOperand(0), currentFunction), GetWideValue(dot->getOperand(1), currentFunction));
+			auto llvmValue = ExtractLaneComponent(product, 0);
+			for (auto i = 1u; i < LLVMGetVectorSize(LLVMTypeOf(product)) / laneCount; i++)
+			{
+				llvmValue = CreateFAdd(llvmValue, ExtractLaneComponent(product, i));
+			}
+			return {llvmValue, true};
+		}
+
+	case OpAny:
+	case OpAll:
+		{
+			const auto op = reinterpret_cast<SPIRV::SPIRVUnary*>(instruction);
+			const auto operand = GetLaneValue(op->getOperand(0), currentFunction);
+			if (!operand.varying)
+			{
+				return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+			}
+
+			auto llvmValue = ExtractLaneComponent(operand.value, 0);
+			for (auto i = 1u; i < LLVMGetVectorSize(LLVMTypeOf(operand.value)) / laneCount; i++)
+			{
+				const auto component = ExtractLaneComponent(operand.value, i);
+				llvmValue = instruction->getOpCode() == OpAny ? CreateOr(llvmValue, component) : CreateAnd(llvmValue, component);
+			}
+			return {llvmValue, true};
+		}
+
+	case OpExtInst:
+		{
+			// The GLSL functions are free of side effects, so can also run for inactive lanes
+			const auto extensionInstruction = reinterpret_cast<SPIRV::SPIRVExtInst*>(instruction);
+			return ConvertLaneOperation(instruction, currentFunction, extensionInstruction->getArgumentValues(), false,
+			                            extensionInstruction->getExtSetKind() != SPIRV::SPIRVEIS_OpenGL);
+		}
+
+	case OpSampledImage:
+	case OpImage:
+	case OpImageQuerySize:
+	case OpImageSampleExplicitLod:
+	case OpImageFetch:
+	case OpImageRead:
+	case OpImageWrite:
+		return ConvertLaneOperation(instruction, currentFunction, instruction->getOperands(), false, true);
+
+	case OpMemoryBarrier:
+		return {ConvertInstruction(instruction, currentFunction, LaneOperands::Uniform), false};
+
+	default:
+		// Anything else, atomics included, runs once for each active lane
+		return ScalariseLanes(instruction, currentFunction, true);
+	}
+}
+
+void SPIRVCompiledModuleBuilder::BranchLanes(const SPIRV::SPIRVBasicBlock* target, LLVMValueRef mask, LLVMValueRef currentFunction)
+{
+	const auto pendingMask = lanePendingMasks.at(target);
+	CreateStore(CreateOr(CreateLoad(pendingMask), mask), pendingMask);
+
+	// Lanes can reach a block from different predecessors, so each edge sets the phis of the target for its own lanes
+	for (auto i = 0u; i < target->getNumInst(); i++)
+	{
+		const auto instruction = target->getInst(i);
+		if (instruction->getOpCode() != OpPhi)
+		{
+			continue;
+		}
+
+		const auto slot = lanePhiSlots.at(instruction->getId());
+		static_cast<SPIRV::SPIRVPhi*>(instruction)->foreachPair([&](SPIRV::SPIRVValue* incomingValue, SPIRV::SPIRVBasicBlock* incomingBasicBlock, size_t)
+		{
+			if (incomingBasicBlock == laneBlock)
+			{
+				CreateStore(SelectLanes(mask, GetWideValue(incomingValue, currentFunction), CreateLoad(slot)), slot);
+			}
+		});
+	}
+}
+
+void SPIRVCompiledModuleBuilder::ConvertLaneTerminator(SPIRV::SPIRVInstruction* terminator, LLVMValueRef currentFunction)
+{
+	std::vector<const SPIRV::SPIRVBasicBlock*> targets{};
+	switch (terminator->getOpCode())
+	{
+	case OpBranch:
+		{
+			const auto branch = static_cast<SPIRV::SPIRVBranch*>(terminator);
+			BranchLanes(branch->getTargetLabel(), laneMask, currentFunction);
+			targets.push_back(branch->getTargetLabel());
+			break;
+		}
+
+	case OpBranchConditional:
+		{
+			const auto branch = static_cast<SPIRV::SPIRVBranchConditional*>(terminator);
+			const auto condition = GetWideValue(branch->getCondition(), currentFunction);
+			BranchLanes(branch->getTrueLabel(), CreateAnd(laneMask, condition), currentFunction);
+			BranchLanes(branch->getFalseLabel(), CreateAnd(laneMask, CreateNot(condition)), currentFunction);
+			targets.push_back(branch->getTrueLabel());
+			targets.push_back(branch->getFalseLabel());
+			break;
+		}
+
+	case OpSwitch:
+		{
+			const auto swtch = static_cast<SPIRV::SPIRVSwitch*>(terminator);
+			const auto select = GetWideValue(swtch->getSelect(), currentFunction);
+			auto remainingMask = laneMask;
+			swtch->foreachPair([&](SPIRV::SPIRVSwitch::LiteralTy literals, SPIRV::SPIRVBasicBlock* label)
+			{
+				assert(!literals.empty());
+				assert(literals.size() <= 2);
+				auto literal = static_cast<uint64_t>(literals.at(0));
+				if (literals.size() == 2)
+				{
+					literal += static_cast<uint64_t>(literals.at(1)) << 32;
+				}
+				const auto matches = CreateICmpEQ(select, WidenLanes(LLVMConstInt(LLVMGetElementType(LLVMTypeOf(select)), literal, false)));
+				BranchLanes(label, CreateAnd(remainingMask, matches), currentFunction);
+				remainingMask = CreateAnd(remainingMask, CreateNot(matches));
+				targets.push_back(label);
+			});
+			BranchLanes(swtch->getDefault(), remainingMask, currentFunction);
+			targets.push_back(swtch->getDefault());
+			break;
+		}
+
+	case OpReturn:
+	case OpUnreachable:
+		break;
+
+	default:
+		TODO_ERROR();
+	}
+
+	// Lanes sent back to an earlier block run it again straight away, the earliest first, otherwise the next block in order takes whichever lanes
+	// are waiting for it
+	std::sort(targets.begin(), targets.end(), [&](const SPIRV::SPIRVBasicBlock* left, const SPIRV::SPIRVBasicBlock* right)
+	{
+		return laneBlockIndices.at(left) < laneBlockIndices.at(right);
+	});
+	targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+	const auto index = laneBlockIndices.at(laneBlock);
+	for (const auto target : targets)
+	{
+		const auto targetIndex = laneBlockIndices.at(target);
+		if (targetIndex > index)
+		{
+			break;
+		}
+
+		const auto nextBlock = LLVMAppendBasicBlockInContext(context, currentFunction, "lane-next");
+		CreateCondBr(AnyLanes(CreateLoad(lanePendingMasks.at(target))), laneGuards[targetIndex], nextBlock);
+		currentBlock = nextBlock;
+		LLVMPositionBuilderAtEnd(builder, nextBlock);
+	}
+	CreateBr(index + 1 < laneGuards.size() ? laneGuards[index + 1] : laneExit);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::ConvertLaneFunction(const SPIRV::SPIRVFunction* spirvFunction)
+{
+	AddDebugInformation(spirvFunction);
+
+	const auto maskType = LLVMVectorType(LLVMInt1TypeInContext(context), laneCount);
+	std::array<LLVMTypeRef, 2> parameters
+	{
+		maskType,
+		LLVMPointerType(contextType, 0),
+	};
+
+	// TODO: Disable external linkage when no longer using directly
+	const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), parameters.data(), static_cast<uint32_t>(parameters.size()), false);
+	const auto llvmFunction = LLVMAddFunction(module, MangleName(spirvFunction).c_str(), functionType);
+	LLVMSetLinkage(llvmFunction, LLVMExternalLinkage);
+
+	// Everything set up once per call goes in the prologue: the allocas, the pointers to the context members and any value from outside the function
+	lanePrologue = LLVMAppendBasicBlockInContext(context, llvmFunction, "prologue");
+	currentBlock = lanePrologue;
+	LLVMPositionBuilderAtEnd(builder, lanePrologue);
+	AddFunctionMembers(llvmFunction);
+
+	const auto numberBasicBlocks = spirvFunction->getNumBasicBlock();
+	std::vector<LLVMBasicBlockRef> bodies(numberBasicBlocks);
+	laneGuards.resize(numberBasicBlocks);
+	for (auto i = 0u; i < numberBasicBlocks; i++)
+	{
+		const auto spirvBasicBlock = spirvFunction->getBasicBlock(i);
+		laneBlockIndices[spirvBasicBlock] = i;
+		if (i > 0)
+		{
+			laneGuards[i] = LLVMAppendBasicBlockInContext(context, llvmFunction, (spirvBasicBlock->getName() + ".guard").c_str());
+			lanePendingMasks[spirvBasicBlock] = CreateLaneAlloca(maskType);
+		}
+		bodies[i] = LLVMAppendBasicBlockInContext(context, llvmFunction, spirvBasicBlock->getName().c_str());
+
+		for (auto j = 0u; j < spirvBasicBlock->getNumInst(); j++)
+		{
+			const auto instruction = spirvBasicBlock->getInst(j);
+			if (instruction->getOpCode() == OpPhi)
+			{
+				lanePhiSlots[instruction->getId()] = CreateLaneAlloca(GetLaneType(GetType(instruction->getType())));
+			}
+		}
+	}
+	laneExit = LLVMAppendBasicBlockInContext(context, llvmFunction, "exit");
+
+	for (auto i = 0u; i < numberBasicBlocks; i++)
+	{
+		const auto spirvBasicBlock = spirvFunction->getBasicBlock(i);
+		if (i == 0)
+		{
+			laneMask = LLVMGetParam(llvmFunction, 0);
+		}
+		else
+		{
+			// Takes the lanes waiting for the block, skipping it when there are none
+			const auto pendingMask = lanePendingMasks.at(spirvBasicBlock);
+			LLVMPositionBuilderAtEnd(builder, laneGuards[i]);
+			laneMask = CreateLoad(pendingMask);
+			CreateStore(LLVMConstNull(maskType), pendingMask);
+			CreateCondBr(AnyLanes(laneMask), bodies[i], i + 1 < numberBasicBlocks ? laneGuards[i + 1] : laneExit);
+		}
+		laneActiveMasks[spirvBasicBlock] = laneMask;
+		laneBlock = spirvBasicBlock;
+
+		currentBlock = bodies[i];
+		LLVMPositionBuilderAtEnd(builder, bodies[i]);
+		for (auto j = 0u; j + 1 < spirvBasicBlock->getNumInst(); j++)
+		{
+			const auto instruction = spirvBasicBlock->getInst(j);
+			const auto laneValue = ConvertLaneInstruction(instruction, llvmFunction);
+			if (laneValue.value && instruction->hasId())
+			{
+				laneValues[instruction->getId()] = laneValue;
+			}
+		}
+		ConvertLaneTerminator(spirvBasicBlock->getInst(spirvBasicBlock->getNumInst() - 1), llvmFunction);
+	}
+
+	LLVMPositionBuilderAtEnd(builder, lanePrologue);
+	CreateBr(bodies[0]);
+	LLVMPositionBuilderAtEnd(builder, laneExit);
+	CreateRetVoid();
+
+	currentBlock = nullptr;
+	laneBlock = nullptr;
+	functionMapping[spirvFunction->getId()] = llvmFunction;
+	return llvmFunction;
+}
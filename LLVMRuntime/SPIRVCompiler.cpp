@@ -723,11 +723,13 @@ void SPIRVCompiledModuleBuilder::SetLLVMLoopMetadata(const LoopInstructionType*
 }
 
 SPIRVCompiledModuleBuilder::SPIRVCompiledModuleBuilder(const SPIRV::SPIRVModule* spirvModule, spv::ExecutionModel executionModel,
-                                                       const SPIRV::SPIRVFunction* entryPoint, const VkSpecializationInfo* specializationInfo):
+                                                       const SPIRV::SPIRVFunction* entryPoint, const VkSpecializationInfo* specializationInfo,
+                                                       uint32_t laneCount):
 	spirvModule{spirvModule},
 	executionModel{executionModel},
 	entryPoint{entryPoint},
-	specializationInfo{specializationInfo}
+	specializationInfo{specializationInfo},
+	laneCount{laneCount}
 {
 	if (spirvModule->getAddressingModel() != AddressingModelLogical && spirvModule->getAddressingModel() != AddressingModelPhysicalStorageBuffer64)
 	{
@@ -757,6 +759,11 @@ void SPIRVCompiledModuleBuilder::AddDebugInformation(const SPIRV::SPIRVEntry* sp
 
 LLVMValueRef SPIRVCompiledModuleBuilder::CompileMainFunctionImpl()
 {
+	if (laneCount && !SupportsLanes())
+	{
+		laneCount = 0;
+	}
+
 	AddBuiltin();
 
 #if EMIT_DEBUG
@@ -767,33 +774,78 @@ LLVMValueRef SPIRVCompiledModuleBuilder::CompileMainFunctionImpl()
 
 	userData = GlobalVariable(LLVMPointerType(LLVMInt8TypeInContext(context), 0), LLVMExternalLinkage, "@userData");
 
+	if (executionModel == ExecutionModelFragment && UsesDerivatives())
+	{
+		// Layout is {active, lane, helper, parity, depth, x, y, front, values}, see the QUAD_STATE_ indices. Each derivative stores its value in
+		// the lane's own context, alternating between two so a lane that gets ahead of its quad never overwrites a value still being read
+		std::vector<LLVMTypeRef> members
+		{
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMFloatTypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMInt32TypeInContext(context),
+			LLVMArrayType(LLVMVectorType(LLVMFloatTypeInContext(context), 4), 2),
+		};
+		const auto quadStateType = StructType(members, "_QuadState");
+		quadStateIndex = AddContextMember(quadStateType, LLVMConstNull(quadStateType), "_quadState");
+	}
+
+	controlBarrier = (executionModel == ExecutionModelGLCompute || executionModel == ExecutionModelKernel) && UsesControlBarrier();
+
 	// TODO: Only compile variables linked to entry point
 	for (auto i = 0u; i < spirvModule->getNumVariables(); i++)
 	{
-		ConvertValue(spirvModule->getVariable(i), nullptr);
+		const auto variable = spirvModule->getVariable(i);
+		if (IsContextVariable(variable))
+		{
+			AddContextVariable(variable);
+		}
+		else if (variable->getStorageClass() == StorageClassWorkgroup)
+		{
+			AddWorkgroupVariable(variable);
+		}
+		else
+		{
+			ConvertValue(variable, nullptr);
+		}
 	}
 
-	// TODO: Only compile functions linked to entry point
-	for (auto i = 0u; i < spirvModule->getNumFunctions(); i++)
+	FinaliseWorkgroup();
+	FinaliseContext();
+
+	if (laneCount)
 	{
-		const auto spirvFunction = spirvModule->getFunction(i);
-		const auto function = ConvertFunction(spirvFunction);
-		for (auto j = 0u; j < spirvModule->getFunction(i)->getNumBasicBlock(); j++)
+		// Phis of a lane widened function are stored to by their incoming edges, so need no fixing up afterwards
+		ConvertLaneFunction(entryPoint);
+	}
+	else
+	{
+		// TODO: Only compile functions linked to entry point
+		for (auto i = 0u; i < spirvModule->getNumFunctions(); i++)
 		{
-			const auto spirvBasicBlock = spirvModule->getFunction(i)->getBasicBlock(j);
-			for (auto k = 0u; k < spirvBasicBlock->getNumInst(); k++)
+			const auto spirvFunction = spirvModule->getFunction(i);
+			const auto function = ConvertFunction(spirvFunction);
+			for (auto j = 0u; j < spirvModule->getFunction(i)->getNumBasicBlock(); j++)
 			{
-				const auto instruction = spirvBasicBlock->getInst(k);
-				if (instruction->getOpCode() == OpPhi)
+				const auto spirvBasicBlock = spirvModule->getFunction(i)->getBasicBlock(j);
+				for (auto k = 0u; k < spirvBasicBlock->getNumInst(); k++)
 				{
-					auto phi = static_cast<SPIRV::SPIRVPhi*>(instruction);
-					auto llvmPhi = ConvertValue(phi, function);
-					phi->foreachPair([&](SPIRV::SPIRVValue* incomingValue, SPIRV::SPIRVBasicBlock* incomingBasicBlock, size_t)
+					const auto instruction = spirvBasicBlock->getInst(k);
+					if (instruction->getOpCode() == OpPhi)
 					{
-						auto phiBasicBlock = GetBasicBlock(incomingBasicBlock);
-						auto translated = ConvertValue(incomingValue, function);
-						LLVMAddIncoming(llvmPhi, &translated, &phiBasicBlock, 1);
-					});
+						auto phi = static_cast<SPIRV::SPIRVPhi*>(instruction);
+						auto llvmPhi = ConvertValue(phi, function);
+						phi->foreachPair([&](SPIRV::SPIRVValue* incomingValue, SPIRV::SPIRVBasicBlock* incomingBasicBlock, size_t)
+						{
+							auto phiBasicBlock = GetBasicBlock(incomingBasicBlock);
+							auto translated = ConvertValue(incomingValue, function);
+							LLVMAddIncoming(llvmPhi, &translated, &phiBasicBlock, 1);
+						});
+					}
 				}
 			}
 		}
@@ -1218,28 +1270,9 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertValueNoDecoration(const SPIRV::S
 	case OpVariable:
 		{
 			const auto variable = static_cast<const SPIRV::SPIRVVariable*>(spirvValue);
-			const auto isPointer = (variable->getStorageClass() == StorageClassUniform ||
-					variable->getStorageClass() == StorageClassUniformConstant || 
-					variable->getStorageClass() == StorageClassStorageBuffer) &&
-				!IsOpaqueType(variable->getType()->getPointerElementType());
-			auto llvmType = GetType(variable->getType()->getPointerElementType());
+			const auto llvmType = GetVariableType(variable);
 			const auto linkage = ConvertLinkage(variable);
 			const auto name = MangleName(variable);
-
-			if (isPointer)
-			{
-				if (LLVMGetTypeKind(llvmType) == LLVMArrayTypeKind)
-				{
-					const auto size = LLVMGetArrayLength(llvmType);
-					llvmType = LLVMArrayType(LLVMPointerType(LLVMGetElementType(llvmType), 0), size);
-				}
-				else
-				{
-					llvmType = LLVMPointerType(llvmType, 0);
-				}
-				
-				variablePointers.insert(variable->getId());
-			}
 			
 			LLVMValueRef initialiser = nullptr;
 			const auto spirvInitialiser = variable->getInitializer();
@@ -1302,13 +1335,13 @@ void SPIRVCompiledModuleBuilder::ConvertDecoration(LLVMValueRef llvmValue, const
 	}
 }
 
-LLVMValueRef SPIRVCompiledModuleBuilder::ConvertBuiltin(BuiltIn builtin)
+LLVMValueRef SPIRVCompiledModuleBuilder::ConvertBuiltin(BuiltIn builtin, LLVMValueRef currentFunction)
 {
 	for (const auto mapping : builtinInputMapping)
 	{
 		if (mapping.first == builtin)
 		{
-			return CreateInBoundsGEP(builtinInputVariable, 0, mapping.second);
+			return CreateInBoundsGEP(GetContextMember(currentFunction, BUILTIN_INPUT_INDEX), 0, mapping.second);
 		}
 	}
 
@@ -1316,7 +1349,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertBuiltin(BuiltIn builtin)
 	{
 		if (mapping.first == builtin)
 		{
-			return CreateInBoundsGEP(builtinOutputVariable, 0, mapping.second);
+			return CreateInBoundsGEP(GetContextMember(currentFunction, BUILTIN_OUTPUT_INDEX), 0, mapping.second);
 		}
 	}
 
@@ -1325,6 +1358,30 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertBuiltin(BuiltIn builtin)
 
 LLVMValueRef SPIRVCompiledModuleBuilder::ConvertValue(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction)
 {
+	if (laneOperands != LaneOperands::None)
+	{
+		return ConvertLaneOperand(spirvValue, currentFunction);
+	}
+
+	const auto contextMember = contextMapping.find(spirvValue->getId());
+	if (contextMember != contextMapping.end())
+	{
+		assert(currentFunction);
+		const auto pointer = GetContextMember(currentFunction, contextMember->second);
+		if (variablePointers.find(spirvValue->getId()) != variablePointers.end())
+		{
+			return CreateLoad(pointer);
+		}
+		return pointer;
+	}
+
+	const auto workgroupMember = workgroupMapping.find(spirvValue->getId());
+	if (workgroupMember != workgroupMapping.end())
+	{
+		assert(currentFunction);
+		return functionWorkgroupMembers.at(currentFunction)[workgroupMember->second];
+	}
+
 	const auto cachedType = valueMapping.find(spirvValue->getId());
 	if (cachedType != valueMapping.end())
 	{
@@ -1347,18 +1404,22 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertValue(const SPIRV::SPIRVValue* s
 			{
 				return nullptr;
 			}
-			return ConvertBuiltin(builtin);
+			return ConvertBuiltin(builtin, currentFunction);
 		}
 
 		if (spirvValue->getType()->getPointerElementType()->hasMemberDecorate(DecorationBuiltIn))
 		{
+			if (currentFunction == nullptr)
+			{
+				return nullptr;
+			}
 			if (static_cast<const SPIRV::SPIRVVariable*>(spirvValue)->getStorageClass() == StorageClassInput)
 			{
-				return valueMapping[spirvValue->getId()] = builtinInputVariable;
+				return GetContextMember(currentFunction, BUILTIN_INPUT_INDEX);
 			}
 			if (static_cast<const SPIRV::SPIRVVariable*>(spirvValue)->getStorageClass() == StorageClassOutput)
 			{
-				return valueMapping[spirvValue->getId()] = builtinOutputVariable;
+				return GetContextMember(currentFunction, BUILTIN_OUTPUT_INDEX);
 			}
 			TODO_ERROR();
 		}
@@ -1386,6 +1447,172 @@ std::vector<LLVMValueRef> SPIRVCompiledModuleBuilder::ConvertValue(std::vector<S
 	return results;
 }
 
+std::pair<LLVMValueRef, LLVMValueRef> SPIRVCompiledModuleBuilder::ConvertDerivatives(const SPIRV::SPIRVValue* spirvValue, bool coarse, LLVMValueRef currentFunction)
+{
+	const auto value = ConvertValue(spirvValue, currentFunction);
+	const auto type = LLVMTypeOf(value);
+	const auto isVector = LLVMGetTypeKind(type) == LLVMVectorTypeKind;
+	if (LLVMGetTypeKind(isVector ? LLVMGetElementType(type) : type) != LLVMFloatTypeKind)
+	{
+		TODO_ERROR();
+	}
+
+	// Only fragment invocations have neighbours to take differences against
+	if (executionModel != ExecutionModelFragment)
+	{
+		return std::make_pair(LLVMConstNull(type), LLVMConstNull(type));
+	}
+
+	assert(quadStateIndex != INVALID_CONTEXT_INDEX);
+	const auto slotType = LLVMVectorType(LLVMFloatTypeInContext(context), 4);
+	const auto quadState = GetContextMember(currentFunction, quadStateIndex);
+
+	const auto numberComponents = isVector ? LLVMGetVectorSize(type) : 1;
+	LLVMValueRef slotValue;
+	if (isVector)
+	{
+		std::array<LLVMValueRef, 4> mask{};
+		for (auto i = 0u; i < mask.size(); i++)
+		{
+			mask[i] = ConstI32(std::min(i, numberComponents));
+		}
+		slotValue = CreateShuffleVector(value, LLVMGetUndef(type), LLVMConstVector(mask.data(), static_cast<uint32_t>(mask.size())));
+	}
+	else
+	{
+		slotValue = CreateInsertElement(LLVMGetUndef(slotType), value, ConstI32(0));
+	}
+
+	const auto parityPointer = CreateGEP(quadState, 0, QUAD_STATE_PARITY);
+	const auto parity = CreateLoad(parityPointer);
+	CreateStore(CreateXor(parity, ConstU32(1)), parityPointer);
+	CreateStore(slotValue, CreateGEP(quadState, {ConstU32(0), ConstU32(QUAD_STATE_VALUES), parity}));
+
+	// Suspends until every lane of the quad has stored its value, outside of a quad it returns straight away
+	auto quadBarrier = LLVMGetNamedFunction(module, "@quadBarrier");
+	if (!quadBarrier)
+	{
+		const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), nullptr, 0, false);
+		quadBarrier = LLVMAddFunction(module, "@quadBarrier", functionType);
+	}
+	CreateCall(quadBarrier, {});
+
+	const auto lane = CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_LANE));
+
+	// Quad lanes are laid out as (0, 0), (1, 0), (0, 1), (1, 1)
+	LLVMValueRef x0, x1, y0, y1;
+	if (coarse)
+	{
+		x0 = ConstU32(0);
+		x1 = ConstU32(1);
+		y0 = ConstU32(0);
+		y1 = ConstU32(2);
+	}
+	else
+	{
+		x0 = CreateAnd(lane, ConstU32(2));
+		x1 = CreateOr(x0, ConstU32(1));
+		y0 = CreateAnd(lane, ConstU32(1));
+		y1 = CreateOr(y0, ConstU32(2));
+	}
+
+	const auto getSlotValue = [&](LLVMValueRef quadLane)
+	{
+		const auto laneContext = CreateGEP(GetContext(currentFunction), std::vector<LLVMValueRef>{CreateSub(quadLane, lane)});
+		return CreateLoad(CreateGEP(laneContext, {ConstU32(0), ConstU32(quadStateIndex), ConstU32(QUAD_STATE_VALUES), parity}));
+	};
+
+	// Outside of quad execution (points, lines) there are no neighbours, so the derivative is 0
+	const auto isActive = CreateICmpNE(CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_ACTIVE)), ConstU32(0));
+	auto dx = CreateSelect(isActive, CreateFSub(getSlotValue(x1), getSlotValue(x0)), LLVMConstNull(slotType));
+	auto dy = CreateSelect(isActive, CreateFSub(getSlotValue(y1), getSlotValue(y0)), LLVMConstNull(slotType));
+
+	if (isVector)
+	{
+		std::vector<LLVMValueRef> mask{};
+		for (auto i = 0u; i < numberComponents; i++)
+		{
+			mask.push_back(ConstI32(i));
+		}
+		dx = CreateShuffleVector(dx, LLVMGetUndef(slotType), LLVMConstVector(mask.data(), static_cast<uint32_t>(mask.size())));
+		dy = CreateShuffleVector(dy, LLVMGetUndef(slotType), LLVMConstVector(mask.data(), static_cast<uint32_t>(mask.size())));
+	}
+	else
+	{
+		dx = CreateExtractElement(dx, ConstI32(0));
+		dy = CreateExtractElement(dy, ConstI32(0));
+	}
+
+	return std::make_pair(dx, dy);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::IsHelperInvocation(LLVMValueRef currentFunction)
+{
+	const auto quadState = GetContextMember(currentFunction, quadStateIndex);
+	return CreateICmpNE(CreateLoad(CreateGEP(quadState, 0, QUAD_STATE_HELPER)), ConstU32(0));
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::MaskHelperPointer(const SPIRV::SPIRVValue* spirvPointer, LLVMValueRef pointer, LLVMValueRef currentFunction)
+{
+	// Helper invocations only run so their quad has neighbours to take derivatives against, so their writes to memory visible outside of the
+	// invocation go to a scratch variable instead
+	if (quadStateIndex == INVALID_CONTEXT_INDEX)
+	{
+		return pointer;
+	}
+
+	switch (spirvPointer->getType()->getPointerStorageClass())
+	{
+	case StorageClassUniform:
+	case StorageClassStorageBuffer:
+	case StorageClassPhysicalStorageBuffer:
+	case StorageClassImage:
+		break;
+
+	default:
+		return pointer;
+	}
+
+	const auto scratch = CreateEntryAlloca(currentFunction, LLVMGetElementType(LLVMTypeOf(pointer)));
+	return CreateSelect(IsHelperInvocation(currentFunction), scratch, pointer);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::MaskHelperFunction(LLVMValueRef function, LLVMValueRef currentFunction)
+{
+	// Helper invocations call an empty function in place of one that writes to memory, such as an image write
+	if (quadStateIndex == INVALID_CONTEXT_INDEX)
+	{
+		return function;
+	}
+
+	const auto name = std::string{LLVMGetValueName(function)} + ".helper";
+	auto emptyFunction = LLVMGetNamedFunction(module, name.c_str());
+	if (!emptyFunction)
+	{
+		const auto functionType = LLVMGetElementType(LLVMTypeOf(function));
+		assert(LLVMGetTypeKind(LLVMGetReturnType(functionType)) == LLVMVoidTypeKind);
+		emptyFunction = LLVMAddFunction(module, name.c_str(), functionType);
+		LLVMSetLinkage(emptyFunction, LLVMPrivateLinkage);
+
+		const auto emptyBuilder = LLVMCreateBuilderInContext(context);
+		LLVMPositionBuilderAtEnd(emptyBuilder, LLVMAppendBasicBlockInContext(context, emptyFunction, ""));
+		LLVMBuildRetVoid(emptyBuilder);
+		LLVMDisposeBuilder(emptyBuilder);
+	}
+
+	return CreateSelect(IsHelperInvocation(currentFunction), emptyFunction, function);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::CreateEntryAlloca(LLVMValueRef currentFunction, LLVMTypeRef type)
+{
+	// Allocas in the entry block are made once per call, rather than every time a loop reaches them
+	const auto entryBlock = LLVMGetEntryBasicBlock(currentFunction);
+	LLVMPositionBuilder(builder, entryBlock, LLVMGetFirstInstruction(entryBlock));
+	const auto alloca = CreateAlloca(type);
+	LLVMPositionBuilderAtEnd(builder, currentBlock);
+	return alloca;
+}
+
 bool SPIRVCompiledModuleBuilder::NeedsPointer(const SPIRV::SPIRVType* type)
 {
 	return type->isTypeMatrix() || type->isTypeVector() || type->isTypeStruct();
@@ -1592,11 +1819,18 @@ LLVMValueRef SPIRVCompiledModuleBuilder::CallInbuiltFunction(SPIRV::SPIRVImageSa
 	const auto function = GetInbuiltFunction("@Image.Sample.Implicit", imageSampleImplicitLod->getType(), {
 		                                         {nullptr, spirvImageType},
 		                                         {nullptr, coordinateType},
+		                                         {"Dx", coordinateType},
+		                                         {"Dy", coordinateType},
 	                                         }, true);
 
+	// The level of detail comes from the coarse derivatives of the coordinates across the quad
+	const auto derivatives = ConvertDerivatives(imageSampleImplicitLod->getOpValue(1), true, currentFunction);
+
 	return CallInbuiltFunction(function, imageSampleImplicitLod->getType(), {
 		                           {spirvImageType, ConvertValue(imageSampleImplicitLod->getOpValue(0), currentFunction)},
 		                           {coordinateType, ConvertValue(imageSampleImplicitLod->getOpValue(1), currentFunction)},
+		                           {coordinateType, derivatives.first},
+		                           {coordinateType, derivatives.second},
 	                           }, true);
 }
 
@@ -1662,6 +1896,21 @@ LLVMValueRef SPIRVCompiledModuleBuilder::CallInbuiltFunction(SPIRV::SPIRVImageRe
 		TODO_ERROR();
 	}
 
+	auto coordinate = ConvertValue(imageRead->getOpValue(1), currentFunction);
+
+	// Subpass data is addressed relative to the pixel being shaded
+	if (static_cast<const SPIRV::SPIRVTypeImage*>(spirvImageType)->getDescriptor().Dim == DimSubpassData)
+	{
+		const auto fragCoord = CreateLoad(ConvertBuiltin(BuiltInFragCoord, currentFunction));
+		LLVMValueRef mask[]
+		{
+			ConstI32(0),
+			ConstI32(1),
+		};
+		const auto pixel = CreateFPToSI(CreateShuffleVector(fragCoord, LLVMGetUndef(LLVMTypeOf(fragCoord)), LLVMConstVector(mask, 2)), LLVMTypeOf(coordinate));
+		coordinate = CreateAdd(coordinate, pixel);
+	}
+
 	const auto function = GetInbuiltFunction("@Image.Read", imageRead->getType(), {
 		                                         {nullptr, spirvImageType},
 		                                         {nullptr, coordinateType},
@@ -1669,7 +1918,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::CallInbuiltFunction(SPIRV::SPIRVImageRe
 
 	return CallInbuiltFunction(function, imageRead->getType(), {
 		                           {spirvImageType, ConvertValue(imageRead->getOpValue(0), currentFunction)},
-		                           {coordinateType, ConvertValue(imageRead->getOpValue(1), currentFunction)},
+		                           {coordinateType, coordinate},
 	                           }, true);
 }
 
@@ -1685,11 +1934,11 @@ LLVMValueRef SPIRVCompiledModuleBuilder::CallInbuiltFunction(SPIRV::SPIRVImageWr
 	}
 
 	SPIRV::SPIRVTypeVoid voidType{};
-	const auto function = GetInbuiltFunction("@Image.Write", &voidType, {
-		                                         {nullptr, spirvImageType},
-		                                         {nullptr, coordinateType},
-		                                         {nullptr, texelType},
-	                                         }, true);
+	const auto function = MaskHelperFunction(GetInbuiltFunction("@Image.Write", &voidType, {
+		                                                            {nullptr, spirvImageType},
+		                                                            {nullptr, coordinateType},
+		                                                            {nullptr, texelType},
+	                                                            }, true), currentFunction);
 
 	return CallInbuiltFunction(function, &voidType, {
 		                           {spirvImageType, ConvertValue(imageWrite->getOpValue(0), currentFunction)},
@@ -1971,7 +2220,9 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 			const auto llvmBasicBlock = currentBlock;
 			const auto llvmFunctionType = ConvertFunction(functionCall->getFunction());
 			MoveBuilder(llvmBasicBlock, instruction);
-			return CreateCall(llvmFunctionType, ConvertValue(functionCall->getArgumentValues(), currentFunction));
+			auto arguments = ConvertValue(functionCall->getArgumentValues(), currentFunction);
+			arguments.push_back(GetContext(currentFunction));
+			return CreateCall(llvmFunctionType, arguments);
 		}
 
 	case OpVariable:
@@ -1995,7 +2246,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 	case OpStore:
 		{
 			const auto store = reinterpret_cast<SPIRV::SPIRVStore*>(instruction);
-			const auto pointer = ConvertValue(store->getDst(), currentFunction);
+			const auto pointer = MaskHelperPointer(store->getDst(), ConvertValue(store->getDst(), currentFunction), currentFunction);
 			const auto value = ConvertValue(store->getSrc(), currentFunction);
 			const auto llvmValue = CreateStore(value, pointer, store->SPIRVMemoryAccess::isVolatile());
 			if (store->isNonTemporal())
@@ -2008,7 +2259,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 	case OpCopyMemory:
 		{
 			const auto copyMemory = reinterpret_cast<SPIRV::SPIRVCopyMemory*>(instruction);
-			const auto dst = ConvertValue(copyMemory->getTarget(), currentFunction);
+			const auto dst = MaskHelperPointer(copyMemory->getTarget(), ConvertValue(copyMemory->getTarget(), currentFunction), currentFunction);
 			const auto src = ConvertValue(copyMemory->getSource(), currentFunction);
 			const auto dstAlign = copyMemory->getTargetMemoryAccessMask() & MemoryAccessAlignedMask ? copyMemory->getTargetAlignment() : ALIGNMENT;
 			const auto srcAlign = copyMemory->getSourceMemoryAccessMask() & MemoryAccessAlignedMask ? copyMemory->getSourceAlignment() : ALIGNMENT;
@@ -2029,12 +2280,12 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 			auto base = ConvertValue(accessChain->getBase(), currentFunction);
 			auto indices = ConvertValue(accessChain->getIndices(), currentFunction);
 
-			if (LLVMTypeOf(base) == LLVMTypeOf(builtinInputVariable))
+			if (LLVMTypeOf(base) == LLVMPointerType(builtinInputType, 0))
 			{
 				indices = MapBuiltin(indices, accessChain->getBase()->getType(), builtinInputMapping);
 			}
 
-			if (LLVMTypeOf(base) == LLVMTypeOf(builtinOutputVariable))
+			if (LLVMTypeOf(base) == LLVMPointerType(builtinOutputType, 0))
 			{
 				indices = MapBuiltin(indices, accessChain->getBase()->getType(), builtinOutputMapping);
 			}
@@ -3154,15 +3405,47 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 			return CreateIntrinsic<1>(Intrinsics::ctpop, {ConvertValue(op->getOperand(0), currentFunction)});
 		}
 
-		// case OpDPdx: break;
-		// case OpDPdy: break;
-		// case OpFwidth: break;
-		// case OpDPdxFine: break;
-		// case OpDPdyFine: break;
-		// case OpFwidthFine: break;
-		// case OpDPdxCoarse: break;
-		// case OpDPdyCoarse: break;
-		// case OpFwidthCoarse: break;
+	case OpDPdx:
+	case OpDPdxFine:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			return ConvertDerivatives(op->getOperand(0), false, currentFunction).first;
+		}
+
+	case OpDPdy:
+	case OpDPdyFine:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			return ConvertDerivatives(op->getOperand(0), false, currentFunction).second;
+		}
+
+	case OpFwidth:
+	case OpFwidthFine:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			const auto derivatives = ConvertDerivatives(op->getOperand(0), false, currentFunction);
+			return CreateFAdd(CreateIntrinsic<1>(Intrinsics::fabs, {derivatives.first}), CreateIntrinsic<1>(Intrinsics::fabs, {derivatives.second}));
+		}
+
+	case OpDPdxCoarse:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			return ConvertDerivatives(op->getOperand(0), true, currentFunction).first;
+		}
+
+	case OpDPdyCoarse:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			return ConvertDerivatives(op->getOperand(0), true, currentFunction).second;
+		}
+
+	case OpFwidthCoarse:
+		{
+			const auto op = static_cast<SPIRV::SPIRVUnary*>(instruction);
+			const auto derivatives = ConvertDerivatives(op->getOperand(0), true, currentFunction);
+			return CreateFAdd(CreateIntrinsic<1>(Intrinsics::fabs, {derivatives.first}), CreateIntrinsic<1>(Intrinsics::fabs, {derivatives.second}));
+		}
+
 		// case OpEmitVertex: break;
 		// case OpEndPrimitive: break;
 		// case OpEmitStreamVertex: break;
@@ -3170,7 +3453,27 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 
 	case OpControlBarrier:
 		{
-			TODO_ERROR();
+			const auto op = static_cast<SPIRV::SPIRVControlBarrier*>(instruction);
+			const auto executionScope = static_cast<SPIRV::SPIRVConstant*>(op->getExecScope())->getInt32Value();
+			if (executionScope == ScopeSubgroup || executionScope == ScopeInvocation)
+			{
+				// Subgroups are a single invocation, so there is nothing to wait for
+				return nullptr;
+			}
+
+			if (executionScope != ScopeWorkgroup || !controlBarrier)
+			{
+				TODO_ERROR();
+			}
+
+			// Invocations of a workgroup all run on the same thread, so suspending the current one is enough to order memory between them
+			auto function = LLVMGetNamedFunction(module, "@controlBarrier");
+			if (!function)
+			{
+				const auto functionType = LLVMFunctionType(LLVMVoidTypeInContext(context), nullptr, 0, false);
+				function = LLVMAddFunction(module, "@controlBarrier", functionType);
+			}
+			return CreateCall(function, {});
 		}
 
 	case OpMemoryBarrier:
@@ -3194,7 +3497,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 	case OpAtomicStore:
 		{
 			const auto op = static_cast<SPIRV::SPIRVAtomicInstBase*>(instruction);
-			auto pointer = ConvertValue(op->getOpValue(0), currentFunction);
+			auto pointer = MaskHelperPointer(op->getOpValue(0), ConvertValue(op->getOpValue(0), currentFunction), currentFunction);
 			auto semantics = static_cast<SPIRV::SPIRVConstant*>(op->getOpValue(2))->getInt32Value();
 			auto value = ConvertValue(op->getOpValue(3), currentFunction);
 
@@ -3207,7 +3510,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 	case OpAtomicCompareExchangeWeak:
 		{
 			const auto op = static_cast<SPIRV::SPIRVAtomicInstBase*>(instruction);
-			auto pointer = ConvertValue(op->getOpValue(0), currentFunction);
+			auto pointer = MaskHelperPointer(op->getOpValue(0), ConvertValue(op->getOpValue(0), currentFunction), currentFunction);
 			auto equalSemantics = static_cast<SPIRV::SPIRVConstant*>(op->getOpValue(2))->getInt32Value();
 			auto unequalSemantics = static_cast<SPIRV::SPIRVConstant*>(op->getOpValue(3))->getInt32Value();
 			auto value = ConvertValue(op->getOpValue(4), currentFunction);
@@ -3222,7 +3525,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 	case OpAtomicIDecrement:
 		{
 			const auto op = static_cast<SPIRV::SPIRVAtomicInstBase*>(instruction);
-			auto pointer = ConvertValue(op->getOpValue(0), currentFunction);
+			auto pointer = MaskHelperPointer(op->getOpValue(0), ConvertValue(op->getOpValue(0), currentFunction), currentFunction);
 			auto semantics = static_cast<SPIRV::SPIRVConstant*>(op->getOpValue(2))->getInt32Value();
 
 			auto llvmValue = CreateAtomicRMW(op->getOpCode() == OpAtomicIIncrement ? LLVMAtomicRMWBinOpAdd : LLVMAtomicRMWBinOpSub,
@@ -3243,7 +3546,7 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertInstruction(SPIRV::SPIRVInstruct
 	case OpAtomicXor:
 		{
 			const auto op = static_cast<SPIRV::SPIRVAtomicInstBase*>(instruction);
-			auto pointer = ConvertValue(op->getOpValue(0), currentFunction);
+			auto pointer = MaskHelperPointer(op->getOpValue(0), ConvertValue(op->getOpValue(0), currentFunction), currentFunction);
 			auto semantics = static_cast<SPIRV::SPIRVConstant*>(op->getOpValue(2))->getInt32Value();
 			auto value = ConvertValue(op->getOpValue(3), currentFunction);
 
@@ -3616,12 +3919,13 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertFunction(const SPIRV::SPIRVFunct
 		returnType = LLVMInt1TypeInContext(context);
 	}
 
-	std::vector<LLVMTypeRef> parameters{spirvFunction->getNumArguments()};
+	std::vector<LLVMTypeRef> parameters{spirvFunction->getNumArguments() + 1};
 	for (auto i = 0u; i < spirvFunction->getNumArguments(); i++)
 	{
 		assert(spirvFunction->getArgument(i)->getArgNo() == i);
 		parameters[i] = GetType(spirvFunction->getArgument(i)->getType());
 	}
+	parameters[spirvFunction->getNumArguments()] = LLVMPointerType(contextType, 0);
 
 	// TODO: Disable external linkage when no longer using directly
 	const auto functionType = LLVMFunctionType(returnType, parameters.data(), static_cast<uint32_t>(parameters.size()), false);
@@ -3635,6 +3939,13 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertFunction(const SPIRV::SPIRVFunct
 		valueMapping[spirvBasicBlock->getId()] = LLVMBasicBlockAsValue(llvmBasicBlock);
 	}
 
+	if (spirvFunction->getNumBasicBlock() > 0)
+	{
+		// Pointers to the context members are taken in the entry block, so they dominate every use
+		LLVMPositionBuilderAtEnd(builder, GetBasicBlock(spirvFunction->getBasicBlock(0)));
+		AddFunctionMembers(llvmFunction);
+	}
+
 	for (auto i = 0u; i < spirvFunction->getNumBasicBlock(); i++)
 	{
 		const auto basicBlock = GetBasicBlock(spirvFunction->getBasicBlock(i));
@@ -3656,6 +3967,25 @@ LLVMValueRef SPIRVCompiledModuleBuilder::ConvertFunction(const SPIRV::SPIRVFunct
 	return llvmFunction;
 }
 
+void SPIRVCompiledModuleBuilder::AddFunctionMembers(LLVMValueRef llvmFunction)
+{
+	auto& members = functionContextMembers[llvmFunction];
+	for (auto i = 0u; i < contextMembers.size(); i++)
+	{
+		members.push_back(CreateInBoundsGEP(GetContext(llvmFunction), 0, i));
+	}
+
+	if (workgroupIndex != INVALID_CONTEXT_INDEX)
+	{
+		const auto workgroup = CreateLoad(members[workgroupIndex]);
+		auto& workgroupVariables = functionWorkgroupMembers[llvmFunction];
+		for (auto i = 0u; i < workgroupMembers.size(); i++)
+		{
+			workgroupVariables.push_back(CreateInBoundsGEP(workgroup, 0, i));
+		}
+	}
+}
+
 void SPIRVCompiledModuleBuilder::AddBuiltin()
 {
 	std::vector<LLVMTypeRef> inputMembers{};
@@ -3712,11 +4042,195 @@ void SPIRVCompiledModuleBuilder::AddBuiltin()
 		TODO_ERROR();
 	}
 
-	auto llvmType = StructType(inputMembers, "_BuiltinInput", true);
-	builtinInputVariable = GlobalVariable(llvmType, LLVMExternalLinkage, "_builtinInput");
+	// Each lane of a lane widened shader has its own builtins, while accesses still map through the single lane type
+	builtinInputType = StructType(inputMembers, "_BuiltinInput", true);
+	const auto builtinInputStorage = laneCount ? LLVMArrayType(builtinInputType, laneCount) : builtinInputType;
+	AddContextMember(builtinInputStorage, LLVMConstNull(builtinInputStorage), "_builtinInput");
+
+	builtinOutputType = StructType(outputMembers, "_BuiltinOutput", true);
+	const auto builtinOutputStorage = laneCount ? LLVMArrayType(builtinOutputType, laneCount) : builtinOutputType;
+	AddContextMember(builtinOutputStorage, LLVMConstNull(builtinOutputStorage), "_builtinOutput");
+}
+
+uint32_t SPIRVCompiledModuleBuilder::AddContextMember(LLVMTypeRef type, LLVMValueRef initialiser, const std::string& name)
+{
+	contextMembers.push_back(type);
+	contextInitialisers.push_back(initialiser);
+	contextNames.push_back(name);
+	return static_cast<uint32_t>(contextMembers.size() - 1);
+}
+
+void SPIRVCompiledModuleBuilder::AddContextVariable(const SPIRV::SPIRVVariable* variable)
+{
+	auto llvmType = GetVariableType(variable);
+	const auto spirvInitialiser = variable->getInitializer();
+	auto initialiser = spirvInitialiser ? ConvertValue(spirvInitialiser, nullptr) : LLVMConstNull(llvmType);
+	if (laneCount && IsLaneVariable(variable))
+	{
+		std::vector<LLVMValueRef> initialisers(laneCount, initialiser);
+		initialiser = LLVMConstArray(llvmType, initialisers.data(), laneCount);
+		llvmType = LLVMArrayType(llvmType, laneCount);
+	}
+	contextMapping[variable->getId()] = AddContextMember(llvmType, initialiser, MangleName(variable));
+}
+
+void SPIRVCompiledModuleBuilder::AddWorkgroupVariable(const SPIRV::SPIRVVariable* variable)
+{
+	if (variable->getInitializer())
+	{
+		TODO_ERROR();
+	}
+
+	workgroupMapping[variable->getId()] = static_cast<uint32_t>(workgroupMembers.size());
+	workgroupMembers.push_back(GetVariableType(variable));
+}
+
+void SPIRVCompiledModuleBuilder::FinaliseWorkgroup()
+{
+	if (workgroupMembers.empty())
+	{
+		return;
+	}
 
-	llvmType = StructType(outputMembers, "_BuiltinOutput", true);
-	builtinOutputVariable = GlobalVariable(llvmType, LLVMExternalLinkage, "_builtinOutput");
+	// The host allocates the storage for each worker, so only its size is exported
+	const auto workgroupType = StructType(workgroupMembers, "_Workgroup");
+	const auto workgroupPointerType = LLVMPointerType(workgroupType, 0);
+	workgroupIndex = AddContextMember(workgroupPointerType, LLVMConstNull(workgroupPointerType), "_workgroup");
+	GlobalVariable(LLVMInt64TypeInContext(context), true, LLVMExternalLinkage, ConstU64(LLVMABISizeOfType(jit->getDataLayout(), workgroupType)), "@workgroupStorageSize");
+}
+
+void SPIRVCompiledModuleBuilder::FinaliseContext()
+{
+	contextType = StructType(contextMembers, "_Context");
+
+	// The template holds the initial value of every member and is copied into each new context. Every member is also exported under its own
+	// name, so the host can find its offset from the start of the template.
+	const auto contextTemplate = GlobalVariable(contextType, true, LLVMExternalLinkage,
+	                                            LLVMConstNamedStruct(contextType, contextInitialisers.data(), static_cast<uint32_t>(contextInitialisers.size())),
+	                                            "@context");
+	for (auto i = 0u; i < contextMembers.size(); i++)
+	{
+		std::array<LLVMValueRef, 2> indices
+		{
+			ConstU32(0),
+			ConstU32(i),
+		};
+		LLVMAddAlias(module, LLVMPointerType(contextMembers[i], 0), LLVMConstInBoundsGEP(contextTemplate, indices.data(), static_cast<uint32_t>(indices.size())), contextNames[i].c_str());
+	}
+
+	GlobalVariable(LLVMInt64TypeInContext(context), true, LLVMExternalLinkage, ConstU64(LLVMABISizeOfType(jit->getDataLayout(), contextType)), "@contextSize");
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::GetContext(LLVMValueRef currentFunction)
+{
+	return LLVMGetParam(currentFunction, LLVMCountParams(currentFunction) - 1);
+}
+
+LLVMValueRef SPIRVCompiledModuleBuilder::GetContextMember(LLVMValueRef currentFunction, uint32_t index)
+{
+	assert(currentFunction);
+	return functionContextMembers.at(currentFunction)[index];
+}
+
+bool SPIRVCompiledModuleBuilder::IsContextVariable(const SPIRV::SPIRVVariable* variable)
+{
+	// Builtins are already part of the context through the builtin blocks, while constants can be shared between invocations
+	if (variable->isConstant() ||
+		variable->hasDecorate(DecorationBuiltIn) ||
+		variable->getType()->getPointerElementType()->hasMemberDecorate(DecorationBuiltIn))
+	{
+		return false;
+	}
+
+	switch (variable->getStorageClass())
+	{
+	case StorageClassWorkgroup:
+	case StorageClassCrossWorkgroup:
+	case StorageClassFunction:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+LLVMTypeRef SPIRVCompiledModuleBuilder::GetVariableType(const SPIRV::SPIRVVariable* variable)
+{
+	const auto isPointer = (variable->getStorageClass() == StorageClassUniform ||
+			variable->getStorageClass() == StorageClassUniformConstant || 
+			variable->getStorageClass() == StorageClassStorageBuffer) &&
+		!IsOpaqueType(variable->getType()->getPointerElementType());
+	auto llvmType = GetType(variable->getType()->getPointerElementType());
+
+	if (isPointer)
+	{
+		if (LLVMGetTypeKind(llvmType) == LLVMArrayTypeKind)
+		{
+			const auto size = LLVMGetArrayLength(llvmType);
+			llvmType = LLVMArrayType(LLVMPointerType(LLVMGetElementType(llvmType), 0), size);
+		}
+		else
+		{
+			llvmType = LLVMPointerType(llvmType, 0);
+		}
+		
+		variablePointers.insert(variable->getId());
+	}
+
+	return llvmType;
+}
+
+bool SPIRVCompiledModuleBuilder::UsesDerivatives() const
+{
+	for (auto i = 0u; i < spirvModule->getNumFunctions(); i++)
+	{
+		const auto spirvFunction = spirvModule->getFunction(i);
+		for (auto j = 0u; j < spirvFunction->getNumBasicBlock(); j++)
+		{
+			const auto spirvBasicBlock = spirvFunction->getBasicBlock(j);
+			for (auto k = 0u; k < spirvBasicBlock->getNumInst(); k++)
+			{
+				switch (spirvBasicBlock->getInst(k)->getOpCode())
+				{
+				case OpDPdx:
+				case OpDPdy:
+				case OpFwidth:
+				case OpDPdxFine:
+				case OpDPdyFine:
+				case OpFwidthFine:
+				case OpDPdxCoarse:
+				case OpDPdyCoarse:
+				case OpFwidthCoarse:
+				case OpImageSampleImplicitLod:
+					return true;
+
+				default:
+					break;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+bool SPIRVCompiledModuleBuilder::UsesControlBarrier() const
+{
+	for (auto i = 0u; i < spirvModule->getNumFunctions(); i++)
+	{
+		const auto spirvFunction = spirvModule->getFunction(i);
+		for (auto j = 0u; j < spirvFunction->getNumBasicBlock(); j++)
+		{
+			const auto spirvBasicBlock = spirvFunction->getBasicBlock(j);
+			for (auto k = 0u; k < spirvBasicBlock->getNumInst(); k++)
+			{
+				if (spirvBasicBlock->getInst(k)->getOpCode() == OpControlBarrier)
+				{
+					return true;
+				}
+			}
+		}
+	}
+	return false;
 }
 
 CompiledModule* CompileSPIRVModule(CPJit* jit, const SPIRV::SPIRVModule* spirvModule, spv::ExecutionModel executionModel, const SPIRV::SPIRVFunction* entryPoint, const VkSpecializationInfo* specializationInfo)
@@ -3803,6 +4317,8 @@ std::string MangleName(const SPIRV::SPIRVVariable* variable)
 		return "_output_" + name;
 
 	case StorageClassWorkgroup:
+		return "_workgroup_" + name;
+
 	case StorageClassCrossWorkgroup:
 		TODO_ERROR();
 		
@@ -10,24 +10,48 @@
 
 #include <unordered_set>
 
+constexpr auto INVALID_CONTEXT_INDEX = 0xFFFFFFFFu;
+
+// Members of _QuadState, the lane arguments are only read by the function each lane of a quad runs as
+constexpr auto QUAD_STATE_ACTIVE = 0u;
+constexpr auto QUAD_STATE_LANE = 1u;
+constexpr auto QUAD_STATE_HELPER = 2u;
+constexpr auto QUAD_STATE_PARITY = 3u;
+constexpr auto QUAD_STATE_DEPTH = 4u;
+constexpr auto QUAD_STATE_X = 5u;
+constexpr auto QUAD_STATE_Y = 6u;
+constexpr auto QUAD_STATE_FRONT = 7u;
+constexpr auto QUAD_STATE_VALUES = 8u;
+
 class SPIRVCompiledModuleBuilder final : public CompiledModuleBuilder
 {
 public:
 	SPIRVCompiledModuleBuilder(const SPIRV::SPIRVModule* spirvModule, spv::ExecutionModel executionModel, const SPIRV::SPIRVFunction* entryPoint,
-	                           const VkSpecializationInfo* specializationInfo);
+	                           const VkSpecializationInfo* specializationInfo, uint32_t laneCount = 0);
 
 	LLVMTypeRef GetType(const SPIRV::SPIRVType* spirvType);
 
 	LLVMValueRef ConvertValue(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction);
 
-	[[nodiscard]] LLVMValueRef getBuiltinInput() const
+	// Shader variables and builtins are members of a per-invocation context, passed as the last parameter of every shader function
+	[[nodiscard]] LLVMTypeRef getContextType() const
 	{
-		return builtinInputVariable;
+		return contextType;
 	}
-	
-	[[nodiscard]] LLVMValueRef getBuiltinOutput() const
+
+	[[nodiscard]] uint32_t getContextIndex(const SPIRV::SPIRVValue* variable) const
+	{
+		return contextMapping.at(variable->getId());
+	}
+
+	[[nodiscard]] uint32_t getBuiltinInputIndex() const
 	{
-		return builtinOutputVariable;
+		return BUILTIN_INPUT_INDEX;
+	}
+
+	[[nodiscard]] uint32_t getBuiltinOutputIndex() const
+	{
+		return BUILTIN_OUTPUT_INDEX;
 	}
 	
 	[[nodiscard]] LLVMValueRef getUserData() const
@@ -35,10 +59,55 @@ public:
 		return userData;
 	}
 
+	// Only present when the shader uses derivatives, in which case it must be executed as 2x2 quads. Each lane of a quad has its own context,
+	// laid out one after the other, and the lanes run in lockstep as fibers that suspend at @quadBarrier.
+	[[nodiscard]] uint32_t getQuadStateIndex() const
+	{
+		return quadStateIndex;
+	}
+
+	// Workgroup variables live in storage shared by every invocation of a workgroup, which the context points to
+	[[nodiscard]] uint32_t getWorkgroupIndex() const
+	{
+		return workgroupIndex;
+	}
+
+	// When set, the invocations of a workgroup must each have their own context and be able to suspend at @controlBarrier
+	[[nodiscard]] bool hasControlBarrier() const
+	{
+		return controlBarrier;
+	}
+
+	// When non-zero, the entry point runs this many invocations per call as void(<laneCount x i1> mask, _Context*). Input, output and private
+	// members of the context, including the builtins, are then arrays with an element for each lane. Zero when the shader could not be widened.
+	[[nodiscard]] uint32_t getLaneCount() const
+	{
+		return laneCount;
+	}
+
 protected:
 	LLVMValueRef CompileMainFunctionImpl() override;
 
 private:
+	static constexpr uint32_t BUILTIN_INPUT_INDEX = 0;
+	static constexpr uint32_t BUILTIN_OUTPUT_INDEX = 1;
+
+	// How ConvertValue treats operands while an instruction of a lane widened function is converted by ConvertInstruction
+	enum class LaneOperands
+	{
+		None,
+		Uniform,
+		Widened,
+		Lane,
+	};
+
+	// Uniform values are the same for every lane and keep their scalar type, varying values hold one element per lane, see GetLaneType
+	struct LaneValue
+	{
+		LLVMValueRef value;
+		bool varying;
+	};
+
 	LLVMBasicBlockRef currentBlock{};
 	LLVMDIBuilderRef diBuilder{};
 
@@ -50,11 +119,25 @@ private:
 	std::unordered_map<uint32_t, LLVMValueRef> functionMapping{};
 	std::unordered_map<std::string, LLVMValueRef> functionCache{};
 
-	LLVMValueRef builtinInputVariable{};
-	LLVMValueRef builtinOutputVariable{};
+	LLVMTypeRef builtinInputType{};
+	LLVMTypeRef builtinOutputType{};
 	std::vector<std::pair<spv::BuiltIn, uint32_t>> builtinInputMapping{};
 	std::vector<std::pair<spv::BuiltIn, uint32_t>> builtinOutputMapping{};
 	LLVMValueRef userData{};
+	uint32_t quadStateIndex{INVALID_CONTEXT_INDEX};
+	uint32_t workgroupIndex{INVALID_CONTEXT_INDEX};
+	bool controlBarrier{};
+
+	LLVMTypeRef contextType{};
+	std::vector<LLVMTypeRef> contextMembers{};
+	std::vector<LLVMValueRef> contextInitialisers{};
+	std::vector<std::string> contextNames{};
+	std::unordered_map<uint32_t, uint32_t> contextMapping{};
+	std::unordered_map<LLVMValueRef, std::vector<LLVMValueRef>> functionContextMembers{};
+
+	std::vector<LLVMTypeRef> workgroupMembers{};
+	std::unordered_map<uint32_t, uint32_t> workgroupMapping{};
+	std::unordered_map<LLVMValueRef, std::vector<LLVMValueRef>> functionWorkgroupMembers{};
 
 	const SPIRV::SPIRVModule* spirvModule;
 	spv::ExecutionModel executionModel;
@@ -63,6 +146,21 @@ private:
 
 	std::unordered_set<uint32_t> scannedIds{};
 
+	uint32_t laneCount;
+	LaneOperands laneOperands{LaneOperands::None};
+	uint32_t laneOperandIndex{};
+	LLVMBasicBlockRef lanePrologue{};
+	const SPIRV::SPIRVBasicBlock* laneBlock{};
+	LLVMValueRef laneMask{};
+	std::unordered_map<uint32_t, LaneValue> laneValues{};
+	std::unordered_map<uint32_t, LLVMValueRef> laneSlots{};
+	std::unordered_map<uint32_t, LLVMValueRef> lanePhiSlots{};
+	std::unordered_map<const SPIRV::SPIRVBasicBlock*, uint32_t> laneBlockIndices{};
+	std::unordered_map<const SPIRV::SPIRVBasicBlock*, LLVMValueRef> laneActiveMasks{};
+	std::unordered_map<const SPIRV::SPIRVBasicBlock*, LLVMValueRef> lanePendingMasks{};
+	std::vector<LLVMBasicBlockRef> laneGuards{};
+	LLVMBasicBlockRef laneExit{};
+
 	void CompileTypes();
 
 	void FinaliseStructs();
@@ -101,10 +199,20 @@ private:
 
 	void ConvertDecoration(LLVMValueRef llvmValue, const SPIRV::SPIRVValue* spirvValue);
 
-	LLVMValueRef ConvertBuiltin(spv::BuiltIn builtin);
+	LLVMValueRef ConvertBuiltin(spv::BuiltIn builtin, LLVMValueRef currentFunction);
 
 	std::vector<LLVMValueRef> ConvertValue(std::vector<SPIRV::SPIRVValue*> spirvValues, LLVMValueRef currentFunction);
 
+	std::pair<LLVMValueRef, LLVMValueRef> ConvertDerivatives(const SPIRV::SPIRVValue* spirvValue, bool coarse, LLVMValueRef currentFunction);
+
+	LLVMValueRef IsHelperInvocation(LLVMValueRef currentFunction);
+
+	LLVMValueRef MaskHelperPointer(const SPIRV::SPIRVValue* spirvPointer, LLVMValueRef pointer, LLVMValueRef currentFunction);
+
+	LLVMValueRef MaskHelperFunction(LLVMValueRef function, LLVMValueRef currentFunction);
+
+	LLVMValueRef CreateEntryAlloca(LLVMValueRef currentFunction, LLVMTypeRef type);
+
 	static bool NeedsPointer(const SPIRV::SPIRVType* type);
 
 	LLVMValueRef GetInbuiltFunction(const std::string& functionNamePrefix, SPIRV::SPIRVType* returnType,
@@ -163,5 +271,88 @@ private:
 
 	LLVMValueRef ConvertFunction(const SPIRV::SPIRVFunction* spirvFunction);
 
+	void AddFunctionMembers(LLVMValueRef llvmFunction);
+
+	bool SupportsLanes() const;
+
+	static bool IsLaneVariable(const SPIRV::SPIRVVariable* variable);
+
+	LLVMTypeRef GetLaneType(LLVMTypeRef type);
+
+	LLVMValueRef GetLaneIndices();
+
+	LLVMValueRef CreateLaneAlloca(LLVMTypeRef type);
+
+	LLVMValueRef ShuffleLanes(LLVMValueRef value1, LLVMValueRef value2, const std::vector<uint32_t>& indices);
+
+	LLVMValueRef WidenLanes(LLVMValueRef value);
+
+	LLVMValueRef ExtractLane(LLVMValueRef value, uint32_t lane);
+
+	LLVMValueRef InsertLane(LLVMValueRef value, LLVMValueRef element, uint32_t lane);
+
+	LLVMValueRef ExtractLaneComponent(LLVMValueRef value, uint32_t component);
+
+	LLVMValueRef CombineLaneComponents(const std::vector<LLVMValueRef>& components);
+
+	LLVMValueRef RepeatLanes(LLVMValueRef value, uint32_t count);
+
+	LLVMValueRef SelectLanes(LLVMValueRef mask, LLVMValueRef thenValue, LLVMValueRef elseValue);
+
+	LLVMValueRef AnyLanes(LLVMValueRef mask);
+
+	LLVMValueRef GatherLanes(LLVMValueRef pointers);
+
+	void ScatterLanes(LLVMValueRef value, LLVMValueRef pointers);
+
+	static bool IsLaneVectorisable(LLVMTypeRef type);
+
+	LaneValue ConvertLaneVariable(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction);
+
+	LaneValue GetLaneValue(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction);
+
+	LLVMValueRef GetWideValue(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction);
+
+	LLVMValueRef ConvertLaneOperand(const SPIRV::SPIRVValue* spirvValue, LLVMValueRef currentFunction);
+
+	bool IsUniform(const std::vector<SPIRV::SPIRVValue*>& spirvValues, LLVMValueRef currentFunction);
+
+	LLVMValueRef ConvertInstruction(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction, LaneOperands operands, uint32_t lane = 0);
+
+	LaneValue ScalariseLanes(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction, bool guarded);
+
+	LaneValue ConvertLaneOperation(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction, const std::vector<SPIRV::SPIRVValue*>& operands,
+	                               bool elementwise, bool guarded = false);
+
+	LaneValue ConvertLaneInstruction(SPIRV::SPIRVInstruction* instruction, LLVMValueRef currentFunction);
+
+	void BranchLanes(const SPIRV::SPIRVBasicBlock* target, LLVMValueRef mask, LLVMValueRef currentFunction);
+
+	void ConvertLaneTerminator(SPIRV::SPIRVInstruction* terminator, LLVMValueRef currentFunction);
+
+	LLVMValueRef ConvertLaneFunction(const SPIRV::SPIRVFunction* spirvFunction);
+
 	void AddBuiltin();
+
+	uint32_t AddContextMember(LLVMTypeRef type, LLVMValueRef initialiser, const std::string& name);
+
+	void AddContextVariable(const SPIRV::SPIRVVariable* variable);
+
+	void AddWorkgroupVariable(const SPIRV::SPIRVVariable* variable);
+
+	void FinaliseWorkgroup();
+
+	void FinaliseContext();
+
+	static LLVMValueRef GetContext(LLVMValueRef currentFunction);
+
+	LLVMValueRef GetContextMember(LLVMValueRef currentFunction, uint32_t index);
+
+	static bool IsContextVariable(const SPIRV::SPIRVVariable* variable);
+
+	LLVMTypeRef GetVariableType(const SPIRV::SPIRVVariable* variable);
+
+	bool UsesDerivatives() const;
+
+	bool UsesControlBarrier() const;
 };
@@ -835,15 +835,6 @@ namespace SPIRV
 	_SPIRV_OP(ISubBorrow)
 	_SPIRV_OP(SMulExtended)
 	_SPIRV_OP(UMulExtended)
-	_SPIRV_OP(DPdx)
-	_SPIRV_OP(DPdy)
-	_SPIRV_OP(Fwidth)
-	_SPIRV_OP(DPdxFine)
-	_SPIRV_OP(DPdyFine)
-	_SPIRV_OP(FwidthFine)
-	_SPIRV_OP(DPdxCoarse)
-	_SPIRV_OP(DPdyCoarse)
-	_SPIRV_OP(FwidthCoarse)
 	_SPIRV_OP(EmitVertex)
 	_SPIRV_OP(EndPrimitive)
 	_SPIRV_OP(EmitStreamVertex)
@@ -1596,6 +1596,15 @@ namespace SPIRV
 	_SPIRV_OP(All)
 	_SPIRV_OP(BitCount)
 	_SPIRV_OP(BitReverse)
+	_SPIRV_OP(DPdx)
+	_SPIRV_OP(DPdy)
+	_SPIRV_OP(Fwidth)
+	_SPIRV_OP(DPdxFine)
+	_SPIRV_OP(DPdyFine)
+	_SPIRV_OP(FwidthFine)
+	_SPIRV_OP(DPdxCoarse)
+	_SPIRV_OP(DPdyCoarse)
+	_SPIRV_OP(FwidthCoarse)
 #undef _SPIRV_OP
 
 	class SPIRVAccessChainBase : public SPIRVInstTemplateBase {
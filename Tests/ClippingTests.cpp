@@ -0,0 +1,56 @@
+#include "Tests.h"
+
+#include "Renderer.h"
+
+#include <cmath>
+
+TEST(Clipping, NoPerspective)
+{
+	constexpr auto SIZE = 16u;
+
+	// The third vertex is behind the near plane, so the triangle is clipped there. Each vertex outputs its own normalised x, which screen linear
+	// interpolation has to reproduce at every pixel, including along the new edges.
+	Renderer renderer{SIZE, SIZE};
+	const auto colour = renderer.Draw({
+		{
+			R"(
+#version 450
+layout(location = 0) noperspective out float x;
+void main()
+{
+	const vec4 positions[3] = vec4[3](vec4(-1.0, -1.0, 0.5, 1.0), vec4(1.0, -1.0, 0.5, 1.0), vec4(0.0, 2.0, -1.0, 2.0));
+	gl_Position = positions[gl_VertexIndex];
+	x = gl_Position.x / gl_Position.w;
+}
+)",
+			R"(
+#version 450
+layout(location = 0) noperspective in float x;
+layout(location = 0) out vec4 colour;
+void main()
+{
+	colour = vec4(x, 0.0, 0.0, 1.0);
+}
+)",
+			3, false, VK_COMPARE_OP_ALWAYS, false, 0,
+		},
+	});
+
+	auto covered = 0u;
+	for (auto y = 0u; y < SIZE; y++)
+	{
+		for (auto x = 0u; x < SIZE; x++)
+		{
+			const auto pixel = &colour[(y * SIZE + x) * 4];
+			if (pixel[3] == 0)
+			{
+				continue;
+			}
+
+			const auto expected = (x + 0.5f) / SIZE * 2.0f - 1.0f;
+			CHECK(std::abs(pixel[0] - expected) < 1.0e-3f);
+			covered++;
+		}
+	}
+	CHECK(covered > 0);
+}
@@ -0,0 +1,159 @@
+#include "Tests.h"
+
+#include "Renderer.h"
+
+#include <Config.h>
+
+#include <cstdlib>
+
+constexpr auto SIZE = 16u;
+
+static const char* FULLSCREEN_VERTEX = R"(
+#version 450
+void main()
+{
+	vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.5, 1.0);
+}
+)";
+
+static const char* FULLSCREEN_VERTEX_BEHIND = R"(
+#version 450
+void main()
+{
+	vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.75, 1.0);
+}
+)";
+
+static const char* RED_FRAGMENT = R"(
+#version 450
+layout(location = 0) out vec4 colour;
+void main()
+{
+	colour = vec4(1.0, 0.0, 0.0, 1.0);
+}
+)";
+
+static const char* GREEN_FRAGMENT = R"(
+#version 450
+layout(location = 0) out vec4 colour;
+void main()
+{
+	colour = vec4(0.0, 1.0, 0.0, 1.0);
+}
+)";
+
+TEST(Depth, BiasedDecal)
+{
+	// The decal is coplanar with the surface under it and only passes through its bias, which hierarchical depth has to account for
+	Renderer renderer{SIZE, SIZE};
+	const auto colour = renderer.Draw({
+		{FULLSCREEN_VERTEX, RED_FRAGMENT, 3, true, VK_COMPARE_OP_LESS, false, 0},
+		{FULLSCREEN_VERTEX, GREEN_FRAGMENT, 3, true, VK_COMPARE_OP_LESS, true, -16},
+	});
+
+	for (auto i = 0u; i < SIZE * SIZE; i++)
+	{
+		CHECK(colour[i * 4 + 0] == 0);
+		CHECK(colour[i * 4 + 1] == 1);
+	}
+}
+
+TEST(Depth, EarlyTestsDiscard)
+{
+	// With early fragment tests a discarded fragment still writes depth, but never colour
+	Renderer renderer{SIZE, SIZE};
+	const auto colour = renderer.Draw({
+		{
+			FULLSCREEN_VERTEX,
+			R"(
+#version 450
+layout(early_fragment_tests) in;
+layout(location = 0) out vec4 colour;
+void main()
+{
+	colour = vec4(1.0, 0.0, 0.0, 1.0);
+	discard;
+}
+)",
+			3, true, VK_COMPARE_OP_LESS, false, 0,
+		},
+		{FULLSCREEN_VERTEX_BEHIND, GREEN_FRAGMENT, 3, true, VK_COMPARE_OP_LESS, false, 0},
+	});
+
+	for (auto i = 0u; i < SIZE * SIZE * 4; i++)
+	{
+		CHECK(colour[i] == 0);
+	}
+}
+
+static void SetDeferredShading(bool enable)
+{
+#if defined(_WIN32)
+	_putenv_s(RASTERISER_DEFERRED_SHADING_VARIABLE, enable ? "1" : "0");
+#else
+	setenv(RASTERISER_DEFERRED_SHADING_VARIABLE, enable ? "1" : "0", 1);
+#endif
+}
+
+TEST(Depth, DeferredShadingOverdraw)
+{
+	// A sloped surface cuts through a flat one in front of the background, resolving visibility first has to leave the same pixels as shading every fragment
+	const std::vector<Renderer::PipelineOptions> pipelines
+	{
+		{FULLSCREEN_VERTEX_BEHIND, RED_FRAGMENT, 3, true, VK_COMPARE_OP_LESS, false, 0},
+		{
+			R"(
+#version 450
+layout(location = 0) out float x;
+void main()
+{
+	vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0;
+	gl_Position = vec4(position, 0.5 + position.x * 0.125, 1.0);
+	x = position.x;
+}
+)",
+			R"(
+#version 450
+layout(location = 0) in float x;
+layout(location = 0) out vec4 colour;
+void main()
+{
+	colour = vec4(0.0, 1.0, x, 1.0);
+}
+)",
+			3, true, VK_COMPARE_OP_LESS, false, 0,
+		},
+		{FULLSCREEN_VERTEX, GREEN_FRAGMENT, 3, true, VK_COMPARE_OP_LESS_OR_EQUAL, false, 0},
+	};
+
+	SetDeferredShading(false);
+	std::vector<float> immediate;
+	{
+		Renderer renderer{SIZE, SIZE};
+		immediate = renderer.Draw(pipelines);
+	}
+
+	SetDeferredShading(true);
+	std::vector<float> deferred;
+	{
+		Renderer renderer{SIZE, SIZE};
+		deferred = renderer.Draw(pipelines);
+	}
+	SetDeferredShading(false);
+
+	CHECK(immediate == deferred);
+
+	// The left half is the sloped surface and the right half the flat one, the background never shows
+	for (auto y = 0u; y < SIZE; y++)
+	{
+		for (auto x = 0u; x < SIZE; x++)
+		{
+			const auto pixel = &deferred[(y * SIZE + x) * 4];
+			CHECK(pixel[0] == 0);
+			CHECK(pixel[1] == 1);
+			CHECK((pixel[2] < 0) == (x < SIZE / 2));
+		}
+	}
+}
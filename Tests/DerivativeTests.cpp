@@ -0,0 +1,76 @@
+#include "Tests.h"
+
+#include "Renderer.h"
+
+constexpr auto SIZE = 16u;
+
+// Covers the whole framebuffer with one triangle
+static const char* FULLSCREEN_VERTEX = R"(
+#version 450
+void main()
+{
+	vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.5, 1.0);
+}
+)";
+
+static std::vector<float> DrawFullscreen(const char* fragmentShader)
+{
+	Renderer renderer{SIZE, SIZE};
+	return renderer.Draw({{FULLSCREEN_VERTEX, fragmentShader, 3, false, VK_COMPARE_OP_ALWAYS, false, 0}});
+}
+
+TEST(Derivatives, InLoop)
+{
+	// More derivatives than a quad used to have slots for, each iteration has to see its own neighbours
+	const auto colour = DrawFullscreen(R"(
+#version 450
+layout(location = 0) out vec4 colour;
+void main()
+{
+	float x = 0.0;
+	float y = 0.0;
+	for (int i = 0; i < 100; i++)
+	{
+		x += dFdx(gl_FragCoord.x * float(i));
+		y += dFdy(gl_FragCoord.y * float(i));
+	}
+	colour = vec4(x, y, 0.0, 1.0);
+}
+)");
+
+	for (auto i = 0u; i < SIZE * SIZE; i++)
+	{
+		CHECK(colour[i * 4 + 0] == 4950);
+		CHECK(colour[i * 4 + 1] == 4950);
+	}
+}
+
+TEST(Derivatives, Chained)
+{
+	// The second derivative takes the first as its operand, so every lane has to have finished the first before it is read
+	const auto colour = DrawFullscreen(R"(
+#version 450
+layout(location = 0) out vec4 colour;
+void main()
+{
+	float first = dFdxFine(gl_FragCoord.x * gl_FragCoord.x);
+	float second = dFdyFine(first * gl_FragCoord.y);
+	float third = dFdxFine(dFdxFine(gl_FragCoord.x * gl_FragCoord.x * 0.5));
+	colour = vec4(first, second, third, 1.0);
+}
+)");
+
+	for (auto y = 0u; y < SIZE; y++)
+	{
+		for (auto x = 0u; x < SIZE; x++)
+		{
+			// (left + 1)^2 - left^2, with left the centre of the quad's left column
+			const auto expected = 2.0f * ((x & ~1u) + 0.5f) + 1.0f;
+			const auto pixel = &colour[(y * SIZE + x) * 4];
+			CHECK(pixel[0] == expected);
+			CHECK(pixel[1] == expected);
+			CHECK(pixel[2] == 0);
+		}
+	}
+}
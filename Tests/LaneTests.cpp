@@ -0,0 +1,58 @@
+#include "Tests.h"
+
+#include "Renderer.h"
+
+#include <cmath>
+
+TEST(Lanes, DivergentVertex)
+{
+	constexpr auto SIZE = 16u;
+
+	// Two triangles cover the framebuffer, with every vertex leaving the loop after a different number of iterations and fewer vertices than
+	// a call has lanes, so the masks have to keep each vertex's position its own. Each vertex outputs its own normalised x, as in the clipping test.
+	Renderer renderer{SIZE, SIZE};
+	const auto colour = renderer.Draw({
+		{
+			R"(
+#version 450
+layout(location = 0) noperspective out float x;
+void main()
+{
+	const int corners[6] = int[6](0, 1, 2, 1, 3, 2);
+	int corner = corners[gl_VertexIndex];
+	vec2 position = vec2(0.0);
+	for (int i = 0; i < corner; i++)
+	{
+		if (i == corner - 1)
+		{
+			position = vec2(corner & 1, corner >> 1);
+		}
+	}
+	gl_Position = vec4(position * 2.0 - 1.0, 0.5, 1.0);
+	x = gl_Position.x;
+}
+)",
+			R"(
+#version 450
+layout(location = 0) noperspective in float x;
+layout(location = 0) out vec4 colour;
+void main()
+{
+	colour = vec4(x, 1.0, 0.0, 1.0);
+}
+)",
+			6, false, VK_COMPARE_OP_ALWAYS, false, 0,
+		},
+	});
+
+	for (auto y = 0u; y < SIZE; y++)
+	{
+		for (auto x = 0u; x < SIZE; x++)
+		{
+			const auto pixel = &colour[(y * SIZE + x) * 4];
+			const auto expected = (x + 0.5f) / SIZE * 2.0f - 1.0f;
+			CHECK(pixel[1] == 1);
+			CHECK(std::abs(pixel[0] - expected) < 1.0e-3f);
+		}
+	}
+}
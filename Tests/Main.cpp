@@ -0,0 +1,33 @@
+#include "Tests.h"
+
+#include <cstring>
+
+std::vector<TestCase>& GetTests()
+{
+	static std::vector<TestCase> tests{};
+	return tests;
+}
+
+int main(int argc, char** argv)
+{
+	auto found = false;
+	for (const auto& test : GetTests())
+	{
+		if (argc > 1 && strcmp(argv[1], test.name) != 0)
+		{
+			continue;
+		}
+
+		printf("%s\n", test.name);
+		test.function();
+		found = true;
+	}
+
+	if (!found)
+	{
+		fprintf(stderr, "No test named %s\n", argc > 1 ? argv[1] : "");
+		return 1;
+	}
+
+	return 0;
+}
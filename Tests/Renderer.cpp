@@ -0,0 +1,483 @@
+#include "Renderer.h"
+
+#include "Tests.h"
+
+#include <SPIRV/GlslangToSpv.h>
+
+#include <cstring>
+
+extern "C" VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetInstanceProcAddr(VkInstance instance, const char* pName);
+
+constexpr auto COLOUR_FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT;
+constexpr auto DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+
+#define CHECK_RESULT(call) CHECK((call) == VK_SUCCESS)
+
+static void InitialiseResources(TBuiltInResource& resources)
+{
+	resources.maxLights = 32;
+	resources.maxClipPlanes = 6;
+	resources.maxTextureUnits = 32;
+	resources.maxTextureCoords = 32;
+	resources.maxVertexAttribs = 64;
+	resources.maxVertexUniformComponents = 4096;
+	resources.maxVaryingFloats = 64;
+	resources.maxVertexTextureImageUnits = 32;
+	resources.maxCombinedTextureImageUnits = 80;
+	resources.maxTextureImageUnits = 32;
+	resources.maxFragmentUniformComponents = 4096;
+	resources.maxDrawBuffers = 32;
+	resources.maxVertexUniformVectors = 128;
+	resources.maxVaryingVectors = 8;
+	resources.maxFragmentUniformVectors = 16;
+	resources.maxVertexOutputVectors = 16;
+	resources.maxFragmentInputVectors = 15;
+	resources.minProgramTexelOffset = -8;
+	resources.maxProgramTexelOffset = 7;
+	resources.maxClipDistances = 8;
+	resources.maxVaryingComponents = 60;
+	resources.maxVertexOutputComponents = 64;
+	resources.maxFragmentInputComponents = 128;
+	resources.maxImageUnits = 8;
+	resources.maxCombinedImageUnitsAndFragmentOutputs = 8;
+	resources.maxCombinedShaderOutputResources = 8;
+	resources.maxFragmentImageUniforms = 8;
+	resources.maxCombinedImageUniforms = 8;
+	resources.maxViewports = 16;
+	resources.maxCullDistances = 8;
+	resources.maxCombinedClipAndCullDistances = 8;
+	resources.maxSamples = 4;
+	resources.limits.nonInductiveForLoops = true;
+	resources.limits.whileLoops = true;
+	resources.limits.doWhileLoops = true;
+	resources.limits.generalUniformIndexing = true;
+	resources.limits.generalAttributeMatrixVectorIndexing = true;
+	resources.limits.generalVaryingIndexing = true;
+	resources.limits.generalSamplerIndexing = true;
+	resources.limits.generalVariableIndexing = true;
+	resources.limits.generalConstantMatrixVectorIndexing = true;
+}
+
+static std::vector<uint32_t> CompileGLSL(EShLanguage stage, const char* source)
+{
+	static auto initialised = glslang::InitializeProcess();
+	(void)initialised;
+
+	TBuiltInResource resources{};
+	InitialiseResources(resources);
+	const auto messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+
+	glslang::TShader shader{stage};
+	shader.setStrings(&source, 1);
+	if (!shader.parse(&resources, 450, false, messages))
+	{
+		fprintf(stderr, "%s\n%s\n", shader.getInfoLog(), shader.getInfoDebugLog());
+		CHECK(false);
+	}
+
+	glslang::TProgram program{};
+	program.addShader(&shader);
+	if (!program.link(messages))
+	{
+		fprintf(stderr, "%s\n%s\n", program.getInfoLog(), program.getInfoDebugLog());
+		CHECK(false);
+	}
+
+	std::vector<uint32_t> spirv{};
+	glslang::GlslangToSpv(*program.getIntermediate(stage), spirv);
+	return spirv;
+}
+
+Renderer::Renderer(uint32_t width, uint32_t height) :
+	width{width},
+	height{height}
+{
+	const auto vkCreateInstance = reinterpret_cast<PFN_vkCreateInstance>(vk_icdGetInstanceProcAddr(nullptr, "vkCreateInstance"));
+
+	VkApplicationInfo applicationInfo{};
+	applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	applicationInfo.pApplicationName = "CPVulkanTests";
+	applicationInfo.apiVersion = VK_API_VERSION_1_1;
+
+	VkInstanceCreateInfo instanceCreateInfo{};
+	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceCreateInfo.pApplicationInfo = &applicationInfo;
+	CHECK_RESULT(vkCreateInstance(&instanceCreateInfo, nullptr, &instance));
+
+#define FUNCTION(name) name = reinterpret_cast<PFN_##name>(vk_icdGetInstanceProcAddr(instance, #name)); CHECK(name)
+	FUNCTION(vkDestroyInstance);
+	FUNCTION(vkEnumeratePhysicalDevices);
+	FUNCTION(vkGetPhysicalDeviceMemoryProperties);
+	FUNCTION(vkCreateDevice);
+	FUNCTION(vkGetDeviceProcAddr);
+#undef FUNCTION
+
+	auto physicalDeviceCount = 1u;
+	const auto result = vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, &physicalDevice);
+	CHECK((result == VK_SUCCESS || result == VK_INCOMPLETE) && physicalDeviceCount == 1);
+
+	const auto priority = 1.0f;
+	VkDeviceQueueCreateInfo queueCreateInfo{};
+	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueCreateInfo.queueFamilyIndex = 0;
+	queueCreateInfo.queueCount = 1;
+	queueCreateInfo.pQueuePriorities = &priority;
+
+	VkDeviceCreateInfo deviceCreateInfo{};
+	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.queueCreateInfoCount = 1;
+	deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+	CHECK_RESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device));
+
+#define FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name)); CHECK(name)
+	FUNCTION(vkDestroyDevice);
+	FUNCTION(vkGetDeviceQueue);
+	FUNCTION(vkQueueSubmit);
+	FUNCTION(vkQueueWaitIdle);
+	FUNCTION(vkAllocateMemory);
+	FUNCTION(vkFreeMemory);
+	FUNCTION(vkMapMemory);
+	FUNCTION(vkUnmapMemory);
+	FUNCTION(vkCreateImage);
+	FUNCTION(vkDestroyImage);
+	FUNCTION(vkGetImageMemoryRequirements);
+	FUNCTION(vkBindImageMemory);
+	FUNCTION(vkCreateImageView);
+	FUNCTION(vkDestroyImageView);
+	FUNCTION(vkCreateBuffer);
+	FUNCTION(vkDestroyBuffer);
+	FUNCTION(vkGetBufferMemoryRequirements);
+	FUNCTION(vkBindBufferMemory);
+	FUNCTION(vkCreateRenderPass);
+	FUNCTION(vkDestroyRenderPass);
+	FUNCTION(vkCreateFramebuffer);
+	FUNCTION(vkDestroyFramebuffer);
+	FUNCTION(vkCreateShaderModule);
+	FUNCTION(vkDestroyShaderModule);
+	FUNCTION(vkCreatePipelineLayout);
+	FUNCTION(vkDestroyPipelineLayout);
+	FUNCTION(vkCreateGraphicsPipelines);
+	FUNCTION(vkDestroyPipeline);
+	FUNCTION(vkCreateCommandPool);
+	FUNCTION(vkDestroyCommandPool);
+	FUNCTION(vkAllocateCommandBuffers);
+	FUNCTION(vkBeginCommandBuffer);
+	FUNCTION(vkEndCommandBuffer);
+	FUNCTION(vkCmdBeginRenderPass);
+	FUNCTION(vkCmdEndRenderPass);
+	FUNCTION(vkCmdBindPipeline);
+	FUNCTION(vkCmdDraw);
+	FUNCTION(vkCmdCopyImageToBuffer);
+#undef FUNCTION
+
+	vkGetDeviceQueue(device, 0, 0, &queue);
+
+	const auto createAttachment = [&](VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage& image, VkImageView& view)
+	{
+		VkImageCreateInfo imageCreateInfo{};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.format = format;
+		imageCreateInfo.extent = {width, height, 1};
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.usage = usage;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &image));
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(device, image, &requirements);
+		CHECK_RESULT(vkBindImageMemory(device, image, Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT), 0));
+
+		VkImageViewCreateInfo viewCreateInfo{};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+		CHECK_RESULT(vkCreateImageView(device, &viewCreateInfo, nullptr, &view));
+	};
+
+	createAttachment(COLOUR_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT, colourImage, colourView);
+	createAttachment(DEPTH_FORMAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, depthImage, depthView);
+
+	VkBufferCreateInfo bufferCreateInfo{};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.size = width * height * 4 * sizeof(float);
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &readbackBuffer));
+
+	VkMemoryRequirements bufferRequirements;
+	vkGetBufferMemoryRequirements(device, readbackBuffer, &bufferRequirements);
+	readbackMemory = Allocate(bufferRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_RESULT(vkBindBufferMemory(device, readbackBuffer, readbackMemory, 0));
+
+	VkAttachmentDescription attachments[2]{};
+	attachments[0].format = COLOUR_FORMAT;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	attachments[1].format = DEPTH_FORMAT;
+	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colourReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+	VkAttachmentReference depthReference{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colourReference;
+	subpass.pDepthStencilAttachment = &depthReference;
+
+	VkRenderPassCreateInfo renderPassCreateInfo{};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.attachmentCount = 2;
+	renderPassCreateInfo.pAttachments = attachments;
+	renderPassCreateInfo.subpassCount = 1;
+	renderPassCreateInfo.pSubpasses = &subpass;
+	CHECK_RESULT(vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass));
+
+	VkImageView views[2]{colourView, depthView};
+	VkFramebufferCreateInfo framebufferCreateInfo{};
+	framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferCreateInfo.renderPass = renderPass;
+	framebufferCreateInfo.attachmentCount = 2;
+	framebufferCreateInfo.pAttachments = views;
+	framebufferCreateInfo.width = width;
+	framebufferCreateInfo.height = height;
+	framebufferCreateInfo.layers = 1;
+	CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer));
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo{};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.queueFamilyIndex = 0;
+	CHECK_RESULT(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool));
+}
+
+Renderer::~Renderer()
+{
+	vkDestroyCommandPool(device, commandPool, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyFramebuffer(device, framebuffer, nullptr);
+	vkDestroyRenderPass(device, renderPass, nullptr);
+	vkDestroyBuffer(device, readbackBuffer, nullptr);
+	vkDestroyImageView(device, depthView, nullptr);
+	vkDestroyImage(device, depthImage, nullptr);
+	vkDestroyImageView(device, colourView, nullptr);
+	vkDestroyImage(device, colourImage, nullptr);
+	for (auto memory : memories)
+	{
+		vkFreeMemory(device, memory, nullptr);
+	}
+	vkDestroyDevice(device, nullptr);
+	vkDestroyInstance(instance, nullptr);
+}
+
+std::vector<float> Renderer::Draw(const std::vector<PipelineOptions>& pipelines)
+{
+	std::vector<VkPipeline> compiledPipelines{};
+	for (const auto& options : pipelines)
+	{
+		compiledPipelines.push_back(CreatePipeline(options));
+	}
+
+	VkCommandBuffer commandBuffer;
+	VkCommandBufferAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+	CHECK_RESULT(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	VkClearValue clearValues[2]{};
+	clearValues[1].depthStencil = {1.0f, 0};
+
+	VkRenderPassBeginInfo renderPassBeginInfo{};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.renderPass = renderPass;
+	renderPassBeginInfo.framebuffer = framebuffer;
+	renderPassBeginInfo.renderArea = {{0, 0}, {width, height}};
+	renderPassBeginInfo.clearValueCount = 2;
+	renderPassBeginInfo.pClearValues = clearValues;
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	for (auto i = 0u; i < pipelines.size(); i++)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compiledPipelines[i]);
+		vkCmdDraw(commandBuffer, pipelines[i].vertexCount, 1, 0, 0);
+	}
+
+	vkCmdEndRenderPass(commandBuffer);
+
+	VkBufferImageCopy region{};
+	region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+	region.imageExtent = {width, height, 1};
+	vkCmdCopyImageToBuffer(commandBuffer, colourImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+	CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	CHECK_RESULT(vkQueueWaitIdle(queue));
+
+	for (auto pipeline : compiledPipelines)
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+
+	std::vector<float> colour(width * height * 4);
+	void* data;
+	CHECK_RESULT(vkMapMemory(device, readbackMemory, 0, VK_WHOLE_SIZE, 0, &data));
+	memcpy(colour.data(), data, colour.size() * sizeof(float));
+	vkUnmapMemory(device, readbackMemory);
+	return colour;
+}
+
+VkDeviceMemory Renderer::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags flags)
+{
+	VkPhysicalDeviceMemoryProperties properties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+
+	auto memoryType = properties.memoryTypeCount;
+	for (auto i = 0u; i < properties.memoryTypeCount; i++)
+	{
+		if ((requirements.memoryTypeBits & (1u << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags)
+		{
+			memoryType = i;
+			break;
+		}
+	}
+	CHECK(memoryType < properties.memoryTypeCount);
+
+	VkMemoryAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.allocationSize = requirements.size;
+	allocateInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	CHECK_RESULT(vkAllocateMemory(device, &allocateInfo, nullptr, &memory));
+	memories.push_back(memory);
+	return memory;
+}
+
+VkShaderModule Renderer::CreateShader(VkShaderStageFlagBits stage, const char* source)
+{
+	const auto spirv = CompileGLSL(stage == VK_SHADER_STAGE_VERTEX_BIT ? EShLangVertex : EShLangFragment, source);
+
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = spirv.size() * sizeof(uint32_t);
+	createInfo.pCode = spirv.data();
+
+	VkShaderModule shaderModule;
+	CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
+	return shaderModule;
+}
+
+VkPipeline Renderer::CreatePipeline(const PipelineOptions& options)
+{
+	VkPipelineShaderStageCreateInfo stages[2]{};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = CreateShader(VK_SHADER_STAGE_VERTEX_BIT, options.vertexShader);
+	stages[0].pName = "main";
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = CreateShader(VK_SHADER_STAGE_FRAGMENT_BIT, options.fragmentShader);
+	stages[1].pName = "main";
+
+	VkPipelineVertexInputStateCreateInfo vertexInputState{};
+	vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+	inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	auto viewport = options.viewport;
+	if (viewport.width == 0)
+	{
+		viewport = VkViewport{0, 0, static_cast<float>(width), static_cast<float>(height), 0, 1};
+	}
+	auto scissor = options.scissor;
+	if (scissor.extent.width == 0)
+	{
+		scissor = VkRect2D{{0, 0}, {width, height}};
+	}
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = &viewport;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizationState{};
+	rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationState.cullMode = VK_CULL_MODE_NONE;
+	rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationState.depthBiasEnable = options.depthBias;
+	rasterizationState.depthBiasConstantFactor = options.depthBiasConstant;
+	rasterizationState.lineWidth = 1;
+
+	VkPipelineMultisampleStateCreateInfo multisampleState{};
+	multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+	depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilState.depthTestEnable = options.depthTest;
+	depthStencilState.depthWriteEnable = options.depthTest;
+	depthStencilState.depthCompareOp = options.depthCompareOp;
+
+	VkPipelineColorBlendAttachmentState blendAttachment{};
+	blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	VkPipelineColorBlendStateCreateInfo colourBlendState{};
+	colourBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colourBlendState.attachmentCount = 1;
+	colourBlendState.pAttachments = &blendAttachment;
+
+	VkGraphicsPipelineCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	createInfo.stageCount = 2;
+	createInfo.pStages = stages;
+	createInfo.pVertexInputState = &vertexInputState;
+	createInfo.pInputAssemblyState = &inputAssemblyState;
+	createInfo.pViewportState = &viewportState;
+	createInfo.pRasterizationState = &rasterizationState;
+	createInfo.pMultisampleState = &multisampleState;
+	createInfo.pDepthStencilState = &depthStencilState;
+	createInfo.pColorBlendState = &colourBlendState;
+	createInfo.layout = pipelineLayout;
+	createInfo.renderPass = renderPass;
+
+	VkPipeline pipeline;
+	CHECK_RESULT(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline));
+
+	vkDestroyShaderModule(device, stages[0].module, nullptr);
+	vkDestroyShaderModule(device, stages[1].module, nullptr);
+	return pipeline;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Renders offscreen through the driver's own entry point, no loader or window needed
+class Renderer
+{
+public:
+	struct PipelineOptions
+	{
+		const char* vertexShader;
+		const char* fragmentShader;
+		uint32_t vertexCount;
+		bool depthTest;
+		VkCompareOp depthCompareOp;
+		bool depthBias;
+		float depthBiasConstant;
+		// Both cover the whole framebuffer when left empty
+		VkViewport viewport;
+		VkRect2D scissor;
+	};
+
+	Renderer(uint32_t width, uint32_t height);
+	~Renderer();
+
+	Renderer(const Renderer&) = delete;
+	Renderer(Renderer&&) = delete;
+
+	Renderer& operator=(const Renderer&) = delete;
+	Renderer& operator=(Renderer&&) = delete;
+
+	// Draws each pipeline in order into a single render pass, cleared to zero colour and far depth, and returns the RGBA32F colour
+	std::vector<float> Draw(const std::vector<PipelineOptions>& pipelines);
+
+	[[nodiscard]] uint32_t getWidth() const { return width; }
+	[[nodiscard]] uint32_t getHeight() const { return height; }
+
+private:
+	uint32_t width;
+	uint32_t height;
+
+	VkInstance instance{};
+	VkPhysicalDevice physicalDevice{};
+	VkDevice device{};
+	VkQueue queue{};
+
+	VkImage colourImage{};
+	VkImageView colourView{};
+	VkImage depthImage{};
+	VkImageView depthView{};
+	VkBuffer readbackBuffer{};
+	VkDeviceMemory readbackMemory{};
+	std::vector<VkDeviceMemory> memories{};
+
+	VkRenderPass renderPass{};
+	VkFramebuffer framebuffer{};
+	VkPipelineLayout pipelineLayout{};
+	VkCommandPool commandPool{};
+
+#define FUNCTION(name) PFN_##name name{}
+	FUNCTION(vkDestroyInstance);
+	FUNCTION(vkEnumeratePhysicalDevices);
+	FUNCTION(vkGetPhysicalDeviceMemoryProperties);
+	FUNCTION(vkCreateDevice);
+	FUNCTION(vkGetDeviceProcAddr);
+	FUNCTION(vkDestroyDevice);
+	FUNCTION(vkGetDeviceQueue);
+	FUNCTION(vkQueueSubmit);
+	FUNCTION(vkQueueWaitIdle);
+	FUNCTION(vkAllocateMemory);
+	FUNCTION(vkFreeMemory);
+	FUNCTION(vkMapMemory);
+	FUNCTION(vkUnmapMemory);
+	FUNCTION(vkCreateImage);
+	FUNCTION(vkDestroyImage);
+	FUNCTION(vkGetImageMemoryRequirements);
+	FUNCTION(vkBindImageMemory);
+	FUNCTION(vkCreateImageView);
+	FUNCTION(vkDestroyImageView);
+	FUNCTION(vkCreateBuffer);
+	FUNCTION(vkDestroyBuffer);
+	FUNCTION(vkGetBufferMemoryRequirements);
+	FUNCTION(vkBindBufferMemory);
+	FUNCTION(vkCreateRenderPass);
+	FUNCTION(vkDestroyRenderPass);
+	FUNCTION(vkCreateFramebuffer);
+	FUNCTION(vkDestroyFramebuffer);
+	FUNCTION(vkCreateShaderModule);
+	FUNCTION(vkDestroyShaderModule);
+	FUNCTION(vkCreatePipelineLayout);
+	FUNCTION(vkDestroyPipelineLayout);
+	FUNCTION(vkCreateGraphicsPipelines);
+	FUNCTION(vkDestroyPipeline);
+	FUNCTION(vkCreateCommandPool);
+	FUNCTION(vkDestroyCommandPool);
+	FUNCTION(vkAllocateCommandBuffers);
+	FUNCTION(vkBeginCommandBuffer);
+	FUNCTION(vkEndCommandBuffer);
+	FUNCTION(vkCmdBeginRenderPass);
+	FUNCTION(vkCmdEndRenderPass);
+	FUNCTION(vkCmdBindPipeline);
+	FUNCTION(vkCmdDraw);
+	FUNCTION(vkCmdCopyImageToBuffer);
+#undef FUNCTION
+
+	VkDeviceMemory Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags flags);
+	VkShaderModule CreateShader(VkShaderStageFlagBits stage, const char* source);
+	VkPipeline CreatePipeline(const PipelineOptions& options);
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct TestCase
+{
+	const char* name;
+	void (*function)();
+};
+
+std::vector<TestCase>& GetTests();
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*function)())
+	{
+		GetTests().push_back(TestCase{name, function});
+	}
+};
+
+#define TEST(group, name) \
+	static void group##_##name(); \
+	static TestRegistration group##_##name##_registration{#group "." #name, group##_##name}; \
+	static void group##_##name()
+
+#define CHECK(condition) if (!(condition)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); abort(); } else (void)0
@@ -0,0 +1,53 @@
+#include "Tests.h"
+
+#include "ThreadPool.h"
+
+#include <atomic>
+
+TEST(ThreadPool, ParallelFor)
+{
+	ThreadPool threadPool{4};
+	std::vector<std::atomic_uint32_t> visits(100);
+
+	threadPool.ParallelFor(static_cast<uint32_t>(visits.size()), [&](uint32_t index, uint32_t worker)
+	{
+		CHECK(worker < threadPool.getNumberWorkers());
+		visits[index]++;
+	});
+
+	for (const auto& visit : visits)
+	{
+		CHECK(visit == 1);
+	}
+}
+
+TEST(ThreadPool, NestedParallelFor)
+{
+	ThreadPool threadPool{4};
+	std::atomic_uint32_t total{};
+	std::atomic_bool sameWorker{true};
+
+	// Used to deadlock on the dispatch mutex, nested dispatches now run inline on the worker that made them
+	threadPool.ParallelFor(16, [&](uint32_t, uint32_t worker)
+	{
+		threadPool.ParallelFor(8, [&](uint32_t, uint32_t nestedWorker)
+		{
+			if (nestedWorker != worker)
+			{
+				sameWorker = false;
+			}
+			total++;
+		});
+	});
+
+	CHECK(total == 16 * 8);
+	CHECK(sameWorker);
+
+	// The pool still dispatches across every worker afterwards
+	std::atomic_uint32_t after{};
+	threadPool.ParallelFor(64, [&](uint32_t, uint32_t)
+	{
+		after++;
+	});
+	CHECK(after == 64);
+}
@@ -0,0 +1,55 @@
+#include "Tests.h"
+
+#include "Renderer.h"
+
+#include <cmath>
+
+TEST(Viewport, OffsetScissor)
+{
+	constexpr auto SIZE = 32u;
+
+	// The viewport only covers the right half of the framebuffer and the scissor a square across its left edge, so only where both overlap
+	// is drawn. Each vertex outputs its own normalised x, which has to be reproduced relative to the viewport's origin, not the framebuffer's.
+	Renderer renderer{SIZE, SIZE};
+	const auto colour = renderer.Draw({
+		{
+			R"(
+#version 450
+layout(location = 0) noperspective out float x;
+void main()
+{
+	vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.5, 1.0);
+	x = gl_Position.x;
+}
+)",
+			R"(
+#version 450
+layout(location = 0) noperspective in float x;
+layout(location = 0) out vec4 colour;
+void main()
+{
+	colour = vec4(x, 1.0, 0.0, 1.0);
+}
+)",
+			3, false, VK_COMPARE_OP_ALWAYS, false, 0,
+			{SIZE / 2, 0, SIZE / 2, SIZE, 0, 1},
+			{{SIZE / 4, SIZE / 4}, {SIZE / 2, SIZE / 2}},
+		},
+	});
+
+	for (auto y = 0u; y < SIZE; y++)
+	{
+		for (auto x = 0u; x < SIZE; x++)
+		{
+			const auto pixel = &colour[(y * SIZE + x) * 4];
+			const auto inside = x >= SIZE / 2 && x < SIZE * 3 / 4 && y >= SIZE / 4 && y < SIZE * 3 / 4;
+			CHECK((pixel[1] == 1) == inside);
+			if (inside)
+			{
+				const auto expected = (x - SIZE / 2 + 0.5f) / (SIZE / 2) * 2.0f - 1.0f;
+				CHECK(std::abs(pixel[0] - expected) < 1.0e-3f);
+			}
+		}
+	}
+}